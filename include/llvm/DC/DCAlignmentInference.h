@@ -0,0 +1,37 @@
+//===-- llvm/DC/DCAlignmentInference.h - Infer access alignment -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Inference of the alignment of translated memory accesses.
+//
+// Guest memory accesses are translated with the alignment implied by the
+// instruction (e.g., 16 for movaps), or 1, because the address is usually
+// computed from register values that are only loaded from the allocas.
+//
+// This pass runs on translated functions, after their registers were promoted
+// by mem2reg.  It raises the alignment of each load and store to the
+// strongest one provable from the address computation, e.g., from the masking
+// of a pointer, or from an offset from a known-aligned base register.  This
+// includes the incoming stack pointer, when DCFunction assumes its ABI
+// alignment (with -dc-assume-abi-stack-alignment).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCALIGNMENTINFERENCE_H
+#define LLVM_DC_DCALIGNMENTINFERENCE_H
+
+namespace llvm {
+class FunctionPass;
+
+/// Create a pass raising the alignment of the memory accesses of the
+/// translated functions to the strongest provable one.
+FunctionPass *createDCAlignmentInferencePass();
+
+} // end namespace llvm
+
+#endif
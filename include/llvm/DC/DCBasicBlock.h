@@ -53,6 +53,7 @@ public:
   Module *getModule() { return DCF.getModule(); }
   Function *getFunction() { return DCF.getFunction(); }
   BasicBlock *getBasicBlock() { return &TheBB; }
+  const MCBasicBlock &getMCBasicBlock() const { return TheMCBB; }
 
   DCFunction &getParent() { return DCF; }
   DCModule &getParentModule() { return getParent().getParent(); }
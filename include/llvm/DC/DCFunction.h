@@ -62,11 +62,17 @@ class DCFunction {
 
   /// Copy all of the largest super-registers that have ever been accessed in
   /// the function from their function-level alloca to the register set struct.
-  void saveLocalRegs(BasicBlock *BB, BasicBlock::iterator IP);
+  /// If \p AroundCall, the stores are marked with !dc.regset.save metadata,
+  /// for DCRegSetSaveElision.
+  void saveLocalRegs(BasicBlock *BB, BasicBlock::iterator IP,
+                     bool AroundCall = false);
 
   /// Copy all of the largest super-registers that have ever been accessed in
   /// the function from the register set struct to their function-level alloca.
-  void restoreLocalRegs(BasicBlock *BB, BasicBlock::iterator IP);
+  /// If \p AroundCall, the loads are marked with !dc.regset.restore metadata,
+  /// for DCRegSetSaveElision.
+  void restoreLocalRegs(BasicBlock *BB, BasicBlock::iterator IP,
+                        bool AroundCall = false);
 
 public:
   DCFunction(DCModule &DCM, const MCFunction &MCF);
@@ -34,6 +34,10 @@
 namespace llvm {
 
 class DCInstruction {
+public:
+  /// A function translating the semantics of an opcode, generated by TableGen.
+  typedef bool (*CompiledSemaFn)(DCInstruction &DCI);
+
 protected:
   DCBasicBlock &DCB;
   const MCDecodedInst &TheMCInst;
@@ -75,10 +79,14 @@ private:
   /// The constants array, referenced by MOV_CONSTANT operations.
   const uint64_t *ConstantArray;
 
+  /// The map between MC inst opcode and compiled semantics function, if any.
+  const CompiledSemaFn *CompiledSemantics;
+
 public:
   DCInstruction(DCBasicBlock &DCB, const MCDecodedInst &MCI,
                 const unsigned *OpcodeToSemaIdx, const uint16_t *SemanticsArray,
-                const uint64_t *ConstantArray);
+                const uint64_t *ConstantArray,
+                const CompiledSemaFn *CompiledSemantics = nullptr);
   virtual ~DCInstruction();
 
   bool translate();
@@ -92,6 +100,31 @@ public:
   DCModule &getParentModule() { return getParentFunction().getParent(); }
   DCTranslator &getTranslator() { return getParentModule().getTranslator(); }
 
+  /// \name Compiled semantics
+  /// The semantics of each opcode can also be compiled by TableGen to a
+  /// CompiledSemaFn (see SemanticsEmitter), which translates its operations
+  /// in order, using these.  Each does what the interpreter does for the
+  /// same operation, with the same result types \p ResVTs.  Operands are
+  /// referenced by their index \p OpIdx in the list of values defined since
+  /// the start of the instruction.  Each returns false if translation failed.
+  /// @{
+  bool semaGetRC(MVT::SimpleValueType VT, unsigned MIOperandNo);
+  bool semaPutRC(unsigned MIOperandNo, unsigned ValIdx);
+  bool semaGetReg(MVT::SimpleValueType VT, unsigned RegNo);
+  bool semaPutReg(unsigned RegNo, unsigned ValIdx);
+  bool semaCustomOp(MVT::SimpleValueType VT, unsigned OperandKind,
+                    unsigned MIOperandNo);
+  bool semaGetImmediate(MVT::SimpleValueType VT, unsigned MIOperandNo);
+  bool semaGetConstant(MVT::SimpleValueType VT, uint64_t Val);
+  bool semaImplicit(unsigned RegNo);
+  bool semaComplexPattern(ArrayRef<MVT::SimpleValueType> ResVTs,
+                          unsigned PatternKind, ArrayRef<uint16_t> OpIdx);
+  bool semaPredicate(ArrayRef<MVT::SimpleValueType> ResVTs,
+                     unsigned PredicateKind, ArrayRef<uint16_t> OpIdx);
+  bool semaOperation(unsigned Opcode, ArrayRef<MVT::SimpleValueType> ResVTs,
+                     ArrayRef<uint16_t> OpIdx);
+  /// @}
+
 protected:
 
   /// MC operand accessors
@@ -179,23 +212,62 @@ private:
   /// constructs such as custom operands aren't supported by the target).
   bool translateDCOp(uint16_t Opcode);
 
+  /// Translate the operations, with the result types already in ResTys, and,
+  /// for those taking values, the operands in Ops, at indices \p OpIdx.
+  /// @{
+  void translateGetRC(unsigned MIOperandNo);
+  void translatePutRC(unsigned MIOperandNo, unsigned ValIdx);
+  void translateGetReg(unsigned RegNo);
+  void translatePutReg(unsigned RegNo, unsigned ValIdx);
+  bool translateCustomOp(unsigned OperandKind, unsigned MIOperandNo);
+  void translateGetImmediate(unsigned MIOperandNo);
+  void translateGetConstant(uint64_t Val);
+  bool translateImplicitOp(unsigned RegNo);
+  bool translateComplexPatternOp(unsigned PatternKind,
+                                 ArrayRef<uint16_t> OpIdx);
+  bool translatePredicateOp(unsigned PredicateKind, ArrayRef<uint16_t> OpIdx);
+  bool translateOperation(unsigned Opcode, ArrayRef<uint16_t> OpIdx);
+  /// @}
+
+  /// Check that the last operation defined as many values as it has result
+  /// types, given there were \p OldNumVals before it, and return \p Success.
+  bool checkNumResults(bool Success, unsigned OldNumVals);
+
   void translateBinOp(Instruction::BinaryOps Opc);
   void translateCastOp(Instruction::CastOps Opc);
 
+  /// Translate a load of the result type, or a store of the first operand,
+  /// from/to the address operand, known to be aligned to at least
+  /// \p MinAlign bytes.
+  void translateLoad(unsigned MinAlign = 1);
+  void translateStore(unsigned MinAlign = 1, bool isNonTemporal = false);
   bool translateExtLoad(Type *MemTy, bool isSExt = false);
 
+  /// Get the strongest alignment provable for an access through \p Ptr, at
+  /// least \p MinAlign.
+  unsigned getAccessAlignment(Value *Ptr, unsigned MinAlign);
+
+  /// Get the IR type for the value type \p VT.
+  Type *getTypeForVT(MVT::SimpleValueType VT);
+
   /// Get the next result type value in the semantics array.
-  Type *NextTy();
+  Type *NextTy() { return getTypeForVT((MVT::SimpleValueType)Next()); }
+
+  /// Fill the ResTys array with the types of \p ResVTs.
+  void setResultTypes(ArrayRef<MVT::SimpleValueType> ResVTs);
+
+  /// Fill the Ops array with the Values at \p OpIdx in the Vals array.
+  void setOperands(ArrayRef<uint16_t> OpIdx);
 
   /// Fill the Ops array with the proper Values, copied from the Vals array,
-  /// indexed with the elements in the semantics array.
-  void prepareOperands();
+  /// indexed with the elements in the semantics array.  Returns the indices.
+  ArrayRef<uint16_t> prepareOperands();
 
   /// Dump to dbgs(), an operation \p Opcode, producing \p ResultTypes, and
-  /// taking \p Operands, defined in SemanticsArray starting at \p SemaStartIdx.
+  /// taking \p Operands, at indices \p OpIdx in the Vals array.
   void dumpOperation(StringRef Opcode, ArrayRef<Type *> ResultTypes,
                      ArrayRef<Value *> Operands,
-                     unsigned SemaStartIdx) LLVM_DUMP_METHOD;
+                     ArrayRef<uint16_t> OpIdx) LLVM_DUMP_METHOD;
 
 
 protected:
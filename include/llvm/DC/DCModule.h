@@ -16,6 +16,8 @@
 #define LLVM_DC_DCMODULE_H
 
 #include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/DC/DCTranslator.h"
 #include "llvm/IR/DIBuilder.h"
@@ -34,9 +36,33 @@ public:
   DCModule(DCTranslator &DCT, Module &M);
   virtual ~DCModule();
 
-  Function *createExternalWrapperFunction(uint64_t Addr, Value *ExtFn);
+  /// Create the translated function at \p Addr, calling the native external
+  /// function \p ExtFn.  If its prototype \p ExtFnTy is known, the target
+  /// can pass it only the arguments it expects, with a direct call, instead
+  /// of switching to the whole register set, see insertExternalWrapperCall.
+  Function *createExternalWrapperFunction(uint64_t Addr, Value *ExtFn,
+                                          FunctionType *ExtFnTy = nullptr);
+  /// Create the wrapper calling the external function \p Name, typed using
+  /// the translator's signature database, if it knows \p Name.
   Function *createExternalWrapperFunction(uint64_t Addr, StringRef Name);
-  Function *createExternalWrapperFunction(uint64_t Addr);
+  /// Create the wrapper calling the native function at address \p Addr.
+  Function *createExternalWrapperFunction(uint64_t Addr,
+                                          FunctionType *ExtFnTy = nullptr);
+
+  /// Returns true if \p F was created by createExternalWrapperFunction, and
+  /// switches to the whole register set to call the external function.
+  bool isExternalWrapperFunction(const Function *F) const {
+    return ExternalWrappers.count(F);
+  }
+
+  /// Get the registers read and written by the external function wrappers,
+  /// as defined by the platform ABI and insertExternalWrapperAsm.
+  /// Returns false if they aren't known, in which case the wrappers should be
+  /// assumed to access the entire register set.
+  virtual bool getExternalWrapperRegs(SmallVectorImpl<unsigned> &ReadRegs,
+                                      SmallVectorImpl<unsigned> &WrittenRegs) {
+    return false;
+  }
 
   Function *getOrCreateMainFunction(Function *EntryFn);
   Function *getOrCreateInitRegSetFunction();
@@ -108,11 +134,30 @@ protected:
   virtual void insertExternalWrapperAsm(BasicBlock *InsertAtEnd,
                                         Value *ExternalFunc, Value *RegSet) = 0;
 
+  /// Insert, at the end of basic block \p InsertAtEnd, a direct call to the
+  /// native external function \p ExternalFunc, of type \p ExternalFuncTy,
+  /// with the arguments extracted from the register set \p RegSet as defined
+  /// by the platform ABI, and write back its return value to \p RegSet.
+  /// Returns false, without inserting anything, if the target can't pass
+  /// arguments or return values of this type, in which case
+  /// insertExternalWrapperAsm is used instead.
+  virtual bool insertExternalWrapperCall(BasicBlock *InsertAtEnd,
+                                         Value *ExternalFunc,
+                                         FunctionType *ExternalFuncTy,
+                                         Value *RegSet) {
+    return false;
+  }
+
 private:
   DCTranslator &DCT;
   Module &TheModule;
   FunctionType &FuncTy;
 
+  /// The functions created by createExternalWrapperFunction that use
+  /// insertExternalWrapperAsm.  The typed wrappers are regular functions that
+  /// only access the registers they need.
+  SmallPtrSet<const Function *, 8> ExternalWrappers;
+
   /// Debug Info State.
   /// @}
   /// The output stream for the emitted debug source file.
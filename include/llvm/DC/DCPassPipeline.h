@@ -0,0 +1,77 @@
+//===-- llvm/DC/DCPassPipeline.h - DC Optimization Pipeline -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the DCPassPipeline class, which runs the optimizations of
+// the translated IR, described as textual new pass manager pipelines (see
+// -dc-passes and -dc-module-passes).
+//
+// The function pipeline is run on each function as soon as it is translated,
+// after the DC-specific passes that need to run first (e.g., stack frame
+// recovery).  The module pipeline is run on each translation module when it
+// is finalized, after the interprocedural DC passes (e.g., register set
+// promotion).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCPASSPIPELINE_H
+#define LLVM_DC_DCPASSPIPELINE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include <string>
+
+namespace llvm {
+class Function;
+class Module;
+
+class DCPassPipeline {
+public:
+  /// Create the pipelines described by \p FunctionPipeline and
+  /// \p ModulePipeline, either of which can be empty.
+  /// Reports a fatal error if they can't be parsed.
+  DCPassPipeline(StringRef FunctionPipeline, StringRef ModulePipeline);
+
+  /// Get the function pipeline used at \p OptLevel when there is no
+  /// -dc-passes option.
+  static StringRef getDefaultFunctionPipeline(unsigned OptLevel);
+
+  /// Get the module pipeline used at \p OptLevel when there is no
+  /// -dc-module-passes option.  \p PromotesRegSet is whether the register set
+  /// promotion is run before it.
+  static StringRef getDefaultModulePipeline(unsigned OptLevel,
+                                            bool PromotesRegSet);
+
+  StringRef getFunctionPipeline() const { return FunctionPipeline; }
+  StringRef getModulePipeline() const { return ModulePipeline; }
+
+  /// Run the function pipeline on \p F, and drop the analyses it computed.
+  void runOnFunction(Function &F);
+
+  /// Run the module pipeline on \p M, and drop the analyses it computed.
+  void runOnModule(Module &M);
+
+private:
+  const std::string FunctionPipeline, ModulePipeline;
+
+  PassBuilder PB;
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+
+  FunctionPassManager FPM;
+  ModulePassManager MPM;
+};
+
+} // end namespace llvm
+
+#endif
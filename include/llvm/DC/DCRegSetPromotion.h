@@ -0,0 +1,43 @@
+//===-- llvm/DC/DCRegSetPromotion.h - Promote regset accesses ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Interprocedural promotion of the register set to SSA values.
+//
+// Translated functions all have the type "void(%regset*)", and communicate
+// through the register set in memory: they save the registers they use to it
+// before every call and at exit, and reload them after every call.
+//
+// This pass computes the registers each translated function reads and writes,
+// including through its callees.  Functions that only call (directly) other
+// such functions don't need the in-memory regset: their body is moved to an
+// internal "<name>_promoted" function, taking the registers it reads or writes
+// as arguments, and returning the ones it writes.  Their regset is replaced
+// with a local copy, which SROA can then promote.  Calls between promoted
+// functions pass the registers directly.
+//
+// The original function is kept, with the "void(%regset*)" signature, as a
+// wrapper around the promoted function, for callers outside the module, and
+// for indirect calls.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCREGSETPROMOTION_H
+#define LLVM_DC_DCREGSETPROMOTION_H
+
+namespace llvm {
+class FunctionType;
+class ModulePass;
+
+/// Create a pass promoting the regset of the translated functions, of type
+/// \p FuncTy.
+ModulePass *createDCRegSetPromotionPass(FunctionType *FuncTy);
+
+} // end namespace llvm
+
+#endif
@@ -0,0 +1,42 @@
+//===-- llvm/DC/DCRegSetSaveElision.h - Elide call regset saves -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Elision of the register saves and restores around calls.
+//
+// Around each call, DCFunction stores every register it accessed to the
+// regset, and reloads them all after the call.  Most callees only access a
+// few registers, so most of these are useless.
+//
+// This pass computes a summary of the regset fields each translated function
+// accesses and modifies, including through its callees, and uses the
+// external function wrappers' ABI summary, provided by the DCModule.
+// Then, at each call marked by DCFunction (with !dc.regset.save and
+// !dc.regset.restore metadata), it removes the saves of the fields the callee
+// doesn't access, and replaces the restores of the fields it doesn't modify
+// with the saved value.
+//
+// Calls to unknown functions (outside the module, or indirect) still save and
+// restore everything.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCREGSETSAVEELISION_H
+#define LLVM_DC_DCREGSETSAVEELISION_H
+
+namespace llvm {
+class DCModule;
+class ModulePass;
+
+/// Create a pass eliding the useless register saves and restores around the
+/// calls between the functions translated by \p DCM.
+ModulePass *createDCRegSetSaveElisionPass(DCModule &DCM);
+
+} // end namespace llvm
+
+#endif
@@ -0,0 +1,40 @@
+//===-- llvm/DC/DCStackFrameRecovery.h - Recover stack frames ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Recovery of the stack frame of translated functions.
+//
+// All guest memory accesses are inttoptr loads and stores, so spills and
+// other stack slots are never promoted to SSA values.
+//
+// This pass runs on translated functions, after their registers were promoted
+// by mem2reg.  It tracks the constant offsets from the incoming stack pointer
+// of all the values derived from it, including the frame pointer, and the
+// memory accesses through them.  When the frame address doesn't escape,
+// the accesses below the incoming stack pointer (the function's own frame)
+// are rewritten to use a local alloca, which SROA can then promote.
+//
+// Functions where the stack pointer escapes (stored to memory or to another
+// register, passed to a call, or to a callee through the regset), or where
+// the stack is accessed at non-constant offsets, keep using the guest stack.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCSTACKFRAMERECOVERY_H
+#define LLVM_DC_DCSTACKFRAMERECOVERY_H
+
+namespace llvm {
+class FunctionPass;
+
+/// Create a pass recovering the stack frame of the translated functions,
+/// where the stack pointer is at index \p SPField in the regset.
+FunctionPass *createDCStackFrameRecoveryPass(unsigned SPField);
+
+} // end namespace llvm
+
+#endif
@@ -0,0 +1,67 @@
+//===-- llvm/DC/DCTranslationCache.h - DC Translation Cache -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the DCTranslationCache class, a persistent on-disk cache
+// of translated functions.
+//
+// Entries are content-addressed: the key of a function is a hash of everything
+// its translation depends on (its decoded instructions and CFG, its callees,
+// the target triple, the optimization level and pipeline, and the semantics
+// tables).
+// Each entry is a bitcode module, containing the translated function and the
+// support functions and globals it references.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCTRANSLATIONCACHE_H
+#define LLVM_DC_DCTRANSLATIONCACHE_H
+
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+#include <string>
+
+namespace llvm {
+class DCTranslator;
+class Function;
+class LLVMContext;
+class MCFunction;
+class Module;
+
+class DCTranslationCache {
+public:
+  /// The version of the cache entries.  Bump this when the translation
+  /// changes in a way that isn't captured by the semantics tables.
+  static const unsigned Version = 2;
+
+  /// Create a cache storing its entries in the directory \p CacheDir.
+  explicit DCTranslationCache(StringRef CacheDir);
+
+  /// Compute the key identifying the translation of \p MCFN by \p DCT.
+  std::string computeKey(const DCTranslator &DCT,
+                         const MCFunction &MCFN) const;
+
+  /// Load the module stored for \p Key in \p Ctx.
+  /// \returns nullptr if there is no (valid) entry for \p Key.
+  std::unique_ptr<Module> lookup(StringRef Key, LLVMContext &Ctx) const;
+
+  /// Store the translated function \p F under \p Key.
+  /// Other translated functions referenced by \p F are only declared in the
+  /// entry; support functions and globals are copied along, with linkonce_odr
+  /// linkage so that they can be linked in several times.
+  void insert(StringRef Key, const Function &F) const;
+
+private:
+  std::string getEntryPath(StringRef Key) const;
+
+  std::string CacheDir;
+};
+
+} // end namespace llvm
+
+#endif
@@ -0,0 +1,133 @@
+//===-- llvm/DC/DCTranslationStats.h - DC Translation Statistics -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the DCTranslationStats class, which collects the time
+// spent in each stage of the translation of a binary, from loading the object
+// to printing or JITting the IR, as well as counts for every translated
+// function, and writes them as JSON (see -dc-stats).  Clients can also record
+// their own counters, e.g., the runtime counters of a dynamic translator.
+//
+// Stages can be timed on several threads at once (e.g., when translating in
+// parallel); their wall times are then the sum of the time spent on each
+// thread.  CPU times are measured for the whole process, so they overlap
+// between concurrent regions.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DC_DCTRANSLATIONSTATS_H
+#define LLVM_DC_DCTRANSLATIONSTATS_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Timer.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class Function;
+class MCFunction;
+class raw_ostream;
+
+class DCTranslationStats {
+public:
+  enum Stage {
+    ObjectLoad,
+    Symbolizer,
+    CFGRecovery,
+    Translation,
+    Optimization,
+    CodeGen,
+    Printing,
+    NumStages
+  };
+
+  /// The counts recorded for a translated function.
+  struct FunctionStats {
+    uint64_t StartAddr;
+    std::string Name;
+    /// The number of machine instructions and basic blocks.
+    unsigned NumInsts, NumBlocks;
+    /// The number of IR instructions, allocas and (non-intrinsic) calls, once
+    /// the function was optimized.
+    unsigned NumIRInsts, NumAllocas, NumCalls;
+    /// Whether the function was loaded from the translation cache.
+    bool Cached;
+    /// The wall time spent translating the function (or loading it from the
+    /// cache), and optimizing it, in seconds.
+    double TranslationTime, OptimizationTime;
+  };
+
+  /// Accumulate the time spent between its construction and destruction (or
+  /// a call to stop()) in a stage.  Does nothing if the stats are null.
+  class StageRegion {
+    DCTranslationStats *Stats;
+    Stage S;
+    TimeRecord StartTime;
+
+  public:
+    StageRegion(DCTranslationStats *Stats, Stage S);
+    ~StageRegion() { stop(); }
+
+    StageRegion(const StageRegion &) = delete;
+    StageRegion &operator=(const StageRegion &) = delete;
+
+    /// End the region early.
+    /// \returns the wall time spent in the region, or 0 if it was already
+    /// stopped, or if the stats are null.
+    double stop();
+  };
+
+  /// Create stats written to \p OutputFilename, listing the \p NumSlowest
+  /// slowest functions.
+  DCTranslationStats(StringRef OutputFilename, unsigned NumSlowest);
+
+  /// Create the stats requested on the command line with -dc-stats, or null
+  /// if there were none.
+  static std::unique_ptr<DCTranslationStats> createFromCommandLine();
+
+  /// Get the name of \p S, as used in the JSON output.
+  static StringRef getStageName(Stage S);
+
+  StringRef getOutputFilename() const { return OutputFilename; }
+
+  void addStageTime(Stage S, const TimeRecord &Time);
+
+  /// Record the translation of \p MCFN to \p F, which took
+  /// \p TranslationTime and \p OptimizationTime seconds.
+  void addFunction(const MCFunction &MCFN, const Function &F, bool Cached,
+                   double TranslationTime, double OptimizationTime);
+
+  /// Record the value of the client-specific counter \p Name, overwriting
+  /// its previous value, if any.
+  void setCounter(StringRef Name, uint64_t Value);
+
+  void printJSON(raw_ostream &OS) const;
+
+  /// Print the stats as JSON to the output file.
+  std::error_code writeJSON() const;
+
+private:
+  const std::string OutputFilename;
+  const unsigned NumSlowest;
+
+  // Stages and functions are recorded by all translation threads.
+  mutable std::mutex StatsMutex;
+  TimeRecord StageTimes[NumStages];
+  std::vector<FunctionStats> Functions;
+  /// The counters, in the order they were first set.
+  std::vector<std::pair<std::string, uint64_t>> Counters;
+};
+
+} // end namespace llvm
+
+#endif
@@ -33,6 +33,9 @@ class DCBasicBlock;
 class DCFunction;
 class DCInstruction;
 class DCModule;
+class DCPassPipeline;
+class DCTranslationCache;
+class DCTranslationStats;
 class MCBasicBlock;
 class MCDecodedInst;
 class MCFunction;
@@ -56,10 +59,26 @@ class DCTranslator {
   Module *CurrentModule;
   std::unique_ptr<legacy::FunctionPassManager> CurrentFPM;
 
+  /// The optimization pipelines, run after CurrentFPM on each function, and
+  /// on each module when it's finalized.
+  std::unique_ptr<DCPassPipeline> Pipeline;
+
   unsigned OptLevel;
 
   std::unique_ptr<DCModule> DCM;
 
+  /// The persistent cache of translated functions, if enabled.
+  std::unique_ptr<DCTranslationCache> Cache;
+
+  /// The declarations of the known external functions, if any.
+  std::unique_ptr<Module> ExternalSignatures;
+
+  /// The MD5 digest of the external signatures file, or empty if none.
+  std::string ExternalSignaturesDigest;
+
+  /// The statistics to record the translation in, if any.
+  DCTranslationStats *Stats;
+
 public:
   /// Construct a DCTranslator for a target.
   /// \param Ctx  The LLVMContext to emit the IR with.
@@ -77,9 +96,50 @@ public:
   const MCSubtargetInfo &getSubtargetInfo() const { return STI; }
   const DCRegisterSetDesc &getRegSetDesc() const { return RegSetDesc; }
   const DataLayout &getDataLayout() const { return DL; }
+  unsigned getOptLevel() const { return OptLevel; }
+  const DCPassPipeline &getPassPipeline() const { return *Pipeline; }
+
+  /// Get a value identifying the semantics tables used by the translator.
+  /// It changes whenever the tables do, and is used to version the
+  /// translation cache.
+  virtual uint64_t getSemanticsVersion() const { return 0; }
+
+  /// Get the stack pointer register, or 0 if the target doesn't have one.
+  virtual unsigned getStackPointerRegister() const { return 0; }
+
+  /// Get the alignment the ABI guarantees for the stack pointer at function
+  /// entry, or 0 if there is none.  The stack pointer is then congruent to
+  /// \p Offset modulo the alignment.
+  virtual unsigned getEntryStackAlignment(unsigned &Offset) const {
+    return 0;
+  }
+
+  /// Whether the stack frames of the translated functions are recovered, see
+  /// DCStackFrameRecovery.
+  bool recoversStackFrames() const;
+
+  /// Get the prototype of the external function \p Name, as declared in the
+  /// signature database (see -dc-external-signatures), or null if unknown.
+  FunctionType *getExternalFunctionType(StringRef Name) const;
+
+  /// Get a digest of the signature database, or an empty string if there is
+  /// none.  It is used to key the translation cache.
+  StringRef getExternalSignaturesDigest() const {
+    return ExternalSignaturesDigest;
+  }
+
+  /// Whether the translated functions assume their incoming stack pointer is
+  /// aligned as required by the ABI, see getEntryStackAlignment.
+  bool assumesEntryStackAlignment() const;
 
   DCModule *getDCModule() { return DCM.get(); }
 
+  /// Record the time spent translating and optimizing, and the translated
+  /// functions, in \p S.  It isn't owned by the translator, and can be shared
+  /// with other translators (e.g., running on other threads).
+  void setStats(DCTranslationStats *S) { Stats = S; }
+  DCTranslationStats *getStats() const { return Stats; }
+
   // Finalize the current translation module for usage. This does a number of
   // things, including running optimizations.
   // The DCTranslator retains ownership of the module, but it will not be used
@@ -89,6 +149,13 @@ public:
 
   Function *translateFunction(const MCFunction &MCFN);
 
+  /// Link \p M, produced by another translator or loaded from the translation
+  /// cache, into the current translation module.
+  /// Definitions with linkonce_odr linkage in \p M are support functions or
+  /// globals that might already be present; they are given external linkage
+  /// once linked.
+  void linkInModule(std::unique_ptr<Module> M);
+
   Function *getFunction(StringRef Name);
 
 protected:
@@ -16,11 +16,14 @@
 
 #include "llvm/ADT/ArrayRef.h"
 #include <cstdint>
+#include <functional>
+#include <memory>
 
 namespace llvm {
 
 class Function;
 class DCTranslator;
+class LLVMContext;
 class MCModule;
 class MCObjectDisassembler;
 class MCObjectSymbolizer;
@@ -29,6 +32,38 @@ void translateRecursivelyAt(ArrayRef<uint64_t> EntryAddrs, DCTranslator &DCT,
                             MCModule &MCM, MCObjectDisassembler *MCOD = nullptr,
                             MCObjectSymbolizer *MOS = nullptr);
 
+/// Translate the functions at \p EntryAddrs, like translateRecursivelyAt, but
+/// without translating their callees, which are left as declarations in the
+/// translation module.
+void translateAt(ArrayRef<uint64_t> EntryAddrs, DCTranslator &DCT,
+                 MCModule &MCM, MCObjectDisassembler *MCOD = nullptr,
+                 MCObjectSymbolizer *MOS = nullptr);
+
+/// Create a DCTranslator emitting IR in the context \p Ctx.
+/// Used by translateRecursivelyAtInParallel to create one translator per
+/// worker thread, each with its own LLVMContext.  It can be called from
+/// several threads at once.  The translators run concurrently, so they can
+/// only share thread-safe objects (like the MCInstrInfo): in particular, each
+/// needs its own MCInstPrinter.
+typedef std::function<std::unique_ptr<DCTranslator>(LLVMContext &Ctx)>
+    DCTranslatorFactory;
+
+/// Translate the functions reachable from \p EntryAddrs, like
+/// translateRecursivelyAt, but spread the translation over \p NumThreads
+/// worker threads.
+///
+/// The call graph is first discovered serially, creating the MCFunctions
+/// missing from \p MCM and the external wrappers in \p DCT.  The functions
+/// are then partitioned over the workers, each of which owns an LLVMContext,
+/// and a translator (with its own DCModule and function pass manager) created
+/// by \p CreateWorkerTranslator.  The worker modules are finally linked back
+/// into the current translation module of \p DCT, in a deterministic order
+/// that doesn't depend on \p NumThreads.
+void translateRecursivelyAtInParallel(
+    ArrayRef<uint64_t> EntryAddrs, DCTranslator &DCT, MCModule &MCM,
+    const DCTranslatorFactory &CreateWorkerTranslator, unsigned NumThreads,
+    MCObjectDisassembler *MCOD = nullptr, MCObjectSymbolizer *MOS = nullptr);
+
 } // end namespace llvm
 
 #endif
@@ -14,6 +14,16 @@
 //
 // This can, for instance, involve falling back to a dynamic translator runtime.
 //
+// The runtime can also provide a direct-mapped cache from raw target addresses
+// to translated function pointers, which is then probed inline before calling
+// the callback; the callback is only used on a miss, and is responsible for
+// filling the cache.
+//
+// Additionally, each indirect call site can get its own polymorphic inline
+// cache of the last few targets it called, probed before the shared cache.
+// On a miss, a second callback is responsible for updating the inline cache,
+// until the call site is deemed megamorphic.
+//
 // FIXME: This can also be used, for instance, to emit a switch containing all
 // known function targets.
 //===----------------------------------------------------------------------===//
@@ -21,11 +31,62 @@
 #ifndef LLVM_DC_LOWERDCTRANSLATEAT_H
 #define LLVM_DC_LOWERDCTRANSLATEAT_H
 
+#include "llvm/Support/DataTypes.h"
+
 namespace llvm {
 class Pass;
 class Value;
 
-Pass *createLowerDCTranslateAtPass(Value *DynTranslateAtCallback);
+/// An entry in the direct-mapped translate.at cache, as laid out in memory.
+/// The lowered code compares \p GuestAddr to the raw target address, and, if
+/// they match, calls \p HostAddr without going through the callback.
+struct DCTranslateAtCacheEntry {
+  /// The key of entries that were never filled, which can't be a valid
+  /// target address.
+  static const uint64_t EmptyKey = ~0ULL;
+
+  uint64_t GuestAddr;
+  uint64_t HostAddr;
+};
+
+/// A polymorphic inline cache, private to an indirect call site, as laid out
+/// in memory.  The lowered code compares the raw target address to the
+/// GuestAddr of the first entries, and calls the HostAddr of the one that
+/// matches.  The entries are in most recently used order.
+struct DCInlineCache {
+  /// The maximum number of entries probed inline.
+  static const unsigned MaxEntries = 4;
+  /// The number of misses after which a call site is considered megamorphic:
+  /// its inline cache isn't updated anymore, and misses go directly through
+  /// the shared cache and the translate.at callback.
+  static const uint64_t MegamorphicMisses = 64;
+
+  uint64_t Misses;
+  DCTranslateAtCacheEntry Entries[MaxEntries];
+};
+
+/// Get the index of the entry caching \p GuestAddr, in a cache of
+/// 2^\p CacheBits entries.
+inline uint64_t getDCTranslateAtCacheIndex(uint64_t GuestAddr,
+                                           unsigned CacheBits) {
+  // Mix in the high bits, so that functions aligned on large boundaries don't
+  // all map to the same entries.
+  return (GuestAddr ^ (GuestAddr >> CacheBits)) & ((1ULL << CacheBits) - 1);
+}
+
+/// Create a pass lowering dc.translate.at calls to calls to
+/// \p DynTranslateAtCallback.
+/// If \p Cache is non-null, it is the address of an array of 2^\p CacheBits
+/// DCTranslateAtCacheEntry, probed inline before calling the callback.
+/// If \p InlineCacheSize is non-zero, each call with a non-constant target
+/// first probes that many entries of its own DCInlineCache.  On a miss,
+/// \p InlineCacheMissCallback is called with the target and the inline cache,
+/// and returns the translated function pointer.
+Pass *createLowerDCTranslateAtPass(Value *DynTranslateAtCallback,
+                                   Value *Cache = nullptr,
+                                   unsigned CacheBits = 0,
+                                   Value *InlineCacheMissCallback = nullptr,
+                                   unsigned InlineCacheSize = 0);
 
 } // end namespace llvm
 
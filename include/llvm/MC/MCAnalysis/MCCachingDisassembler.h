@@ -6,13 +6,14 @@
 // License. See LICENSE.TXT for details.
 //
 //===----------------------------------------------------------------------===//
-#ifndef LLVM_MC_MCANALYSIS_MCDISASSEMBLER_H
-#define LLVM_MC_MCANALYSIS_MCDISASSEMBLER_H
+#ifndef LLVM_MC_MCANALYSIS_MCCACHINGDISASSEMBLER_H
+#define LLVM_MC_MCANALYSIS_MCCACHINGDISASSEMBLER_H
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/MC/MCDisassembler/MCDisassembler.h"
 #include "llvm/MC/MCInst.h"
-#include <algorithm>
+#include <mutex>
 #include <vector>
 
 namespace llvm {
@@ -25,13 +26,23 @@ namespace llvm {
 
 /// MCCachingDisassembler - Provide a transparent caching layer around
 /// an arbitrary MCDisassembler.
+///
+/// Decoded instructions are kept in a hash table keyed on their encoding, of
+/// at most MaxKeyBytes bytes.  The table holds at most a fixed number of
+/// instructions: past that, one is evicted, using the CLOCK approximation of
+/// LRU.  The cache can be shared by several threads disassembling in
+/// parallel, as long as the underlying MCDisassembler can.
 class MCCachingDisassembler : public MCDisassembler {
 public:
+  /// The longest encoding of a cached instruction.  Longer ones are always
+  /// decoded.  This is the longest X86 instruction.
+  static const unsigned MaxKeyBytes = 15;
+
+  static const unsigned DefaultMaxEntries = 1 << 16;
+
   MCCachingDisassembler(const MCDisassembler &Disassembler,
-                        const MCSubtargetInfo &STI)
-      : MCDisassembler(STI, Disassembler.getContext()),
-        Impl(Disassembler), TempInstKeys(), TempInstValues(), CachedInsts(),
-        LongestCachedRawBytes(0) {}
+                        const MCSubtargetInfo &STI,
+                        unsigned MaxEntries = DefaultMaxEntries);
 
   virtual ~MCCachingDisassembler();
 
@@ -41,42 +52,34 @@ public:
                               raw_ostream &CStream) const override;
 private:
   const MCDisassembler &Impl;
-
-  struct TempInstKey {
-    ArrayRef<uint8_t> Bytes;
-    unsigned ValueIdx;
-    bool operator<(const TempInstKey &RHS) const {
-      return std::lexicographical_compare(Bytes.begin(), Bytes.end(),
-                                          RHS.Bytes.begin(), RHS.Bytes.end());
-    }
-  };
+  const unsigned MaxEntries;
 
   struct CachedInstEntry {
-    ArrayRef<uint8_t> Bytes;
+    uint64_t Hash;
+    uint8_t Bytes[MaxKeyBytes];
+    uint8_t Size;
+    /// Whether the entry was used since the clock hand last went past it.
+    bool Referenced;
     MCInst Inst;
-    // < really is a >, because we want to use lower_bound with LHS being a
-    // prefix of RHS.
-    bool operator<(const CachedInstEntry &RHS) const {
-      return *this < RHS.Bytes;
-    }
-    bool operator<(const ArrayRef<uint8_t> &RHS) const {
-      return std::lexicographical_compare(RHS.begin(), RHS.end(),
-                                          Bytes.begin(), Bytes.end());
-    }
   };
 
   // All of our data is marked mutable, because getInstruction is const in
-  // MCDisassembler.
-  mutable std::vector<TempInstKey> TempInstKeys;
-  mutable std::vector<MCInst> TempInstValues;
+  // MCDisassembler.  It is all guarded by CacheMutex.
+  mutable std::mutex CacheMutex;
 
   mutable std::vector<CachedInstEntry> CachedInsts;
-  mutable size_t LongestCachedRawBytes;
+  /// Map the hash of an encoding to the index of its entry in CachedInsts.
+  mutable DenseMap<uint64_t, unsigned> CacheIndex;
+  /// The clock hand: the next entry to consider for eviction.
+  mutable unsigned ClockHand;
+  /// Bit N is set if instructions of size N were cached.  They might have
+  /// been evicted since.
+  mutable uint32_t CachedSizes;
 
   bool findCachedInstruction(MCInst &Inst, uint64_t &InstSize,
                              ArrayRef<uint8_t> Bytes) const;
-  void addTempInstruction(const MCInst &Inst, ArrayRef<uint8_t> Bytes) const;
-  void uniqueTempInstructions() const;
+  void addCachedInstruction(const MCInst &Inst, ArrayRef<uint8_t> Bytes) const;
+  unsigned evictCachedInstruction() const;
 };
 
 } // namespace llvm
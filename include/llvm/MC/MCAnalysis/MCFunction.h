@@ -15,8 +15,10 @@
 #ifndef LLVM_MC_MCANALYSIS_MCFUNCTION_H
 #define LLVM_MC_MCANALYSIS_MCFUNCTION_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/MC/MCInst.h"
+#include <iterator>
 #include <list>
 #include <string>
 #include <vector>
@@ -26,28 +28,29 @@ namespace llvm {
 class MCFunction;
 class MCModule;
 
-// FIXME: Both the Address and Size field are actually redundant when taken in
-// the context of the basic block, and may better be exposed in an iterator
-// instead of stored in the basic block, which would replace this class.
 /// \brief An entry in an MCBasicBlock: a disassembled instruction.
+/// MCFunctions store their instructions in a compact form: iterating over an
+/// MCBasicBlock unpacks them to MCDecodedInsts.
 class MCDecodedInst {
 public:
   MCInst Inst;
   uint64_t Address;
   uint64_t Size;
+  MCDecodedInst() : Address(0), Size(0) {}
   MCDecodedInst(const MCInst &Inst, uint64_t Address, uint64_t Size)
     : Inst(Inst), Address(Address), Size(Size) {}
 };
 
 /// \brief Basic block containing a sequence of disassembled instructions.
 /// Create a basic block using MCFunction::createBlock.
+/// The instructions are owned by the parent MCFunction: the block references
+/// a contiguous range of them, so that splitting a block never copies them.
 class MCBasicBlock {
-  typedef std::vector<MCDecodedInst> InstListTy;
-  InstListTy Insts;
-
   std::string Name;
   uint64_t StartAddr, SizeInBytes;
-  uint64_t InstCount;
+
+  /// \brief The range of the block instructions in the parent function's.
+  uint32_t InstBegin, InstEnd;
 
   /// \brief The address of the next appended instruction, i.e., the
   /// address immediately after the last instruction in the block.
@@ -70,7 +73,8 @@ class MCBasicBlock {
   BasicBlockListTy Predecessors;
   /// @}
 public:
-  /// Append an instruction.
+  /// Append an instruction.  Only the last block created in a function can
+  /// have instructions appended.
   void addInst(const MCInst &Inst, uint64_t InstSize);
 
   /// \brief Get the start address of the block.
@@ -82,12 +86,59 @@ public:
 
   /// \name Instruction list access
   /// @{
-  typedef InstListTy::const_iterator const_iterator;
-  const_iterator begin() const { return Insts.begin(); }
-  const_iterator end()   const { return Insts.end(); }
 
-  const MCDecodedInst &back() const { return Insts.back(); }
-  size_t size() const { return InstCount; }
+  /// \brief Iterator over the instructions of a block, unpacking each as it
+  /// is dereferenced.  The reference it returns is only valid until the
+  /// iterator is moved or destroyed.
+  class const_iterator {
+    const MCFunction *Parent;
+    uint32_t Idx;
+    mutable MCDecodedInst Cur;
+    mutable bool CurValid;
+
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef MCDecodedInst value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const MCDecodedInst *pointer;
+    typedef const MCDecodedInst &reference;
+
+    const_iterator(const MCFunction *Parent, uint32_t Idx)
+        : Parent(Parent), Idx(Idx), CurValid(false) {}
+
+    inline const MCDecodedInst &operator*() const;
+    const MCDecodedInst *operator->() const { return &**this; }
+
+    const_iterator &operator++() {
+      ++Idx;
+      CurValid = false;
+      return *this;
+    }
+    const_iterator &operator--() {
+      --Idx;
+      CurValid = false;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator Tmp = *this;
+      ++*this;
+      return Tmp;
+    }
+    const_iterator operator--(int) {
+      const_iterator Tmp = *this;
+      --*this;
+      return Tmp;
+    }
+
+    bool operator==(const const_iterator &RHS) const { return Idx == RHS.Idx; }
+    bool operator!=(const const_iterator &RHS) const { return Idx != RHS.Idx; }
+  };
+
+  const_iterator begin() const { return const_iterator(Parent, InstBegin); }
+  const_iterator end() const { return const_iterator(Parent, InstEnd); }
+
+  MCDecodedInst back() const { return *std::prev(end()); }
+  size_t size() const { return InstEnd - InstBegin; }
   /// @}
 
   /// \name Get the owning MCFunction.
@@ -126,6 +177,38 @@ class MCFunction {
   typedef std::vector<MCBasicBlock *> BasicBlockListTy;
   BasicBlockListTy Blocks;
 
+  /// \brief An instruction in the compact form stored in the function.
+  /// The address is an offset from the function start, and the operands are
+  /// tagged words in OperandWords, starting at FirstWord (see MCFunction.cpp).
+  struct PackedInst {
+    int32_t AddrOffset;
+    uint8_t Size;
+    uint8_t NumOperands;
+    uint16_t Opcode;
+    uint32_t FirstWord;
+  };
+
+  /// \brief The instructions of all the blocks, each being a contiguous range,
+  /// and their operands.  Both are allocated in the parent module's arena.
+  PackedInst *Insts = nullptr;
+  uint32_t NumInsts = 0, InstCapacity = 0;
+  uint64_t *OperandWords = nullptr;
+  uint32_t NumOperandWords = 0, OperandWordCapacity = 0;
+  friend class MCBasicBlock;
+
+  /// \brief Make room for at least \p NewInsts more instructions, with
+  /// \p NewWords more operand words, reallocating the arrays if needed.
+  void reserveInsts(size_t NewInsts, size_t NewWords);
+
+  /// \brief Append an instruction, after making room for it.
+  void appendInst(const MCInst &Inst, uint64_t Address, uint64_t Size);
+
+  /// \brief Set the instructions of the function, in the order in which the
+  /// blocks reference them.
+  void setInsts(ArrayRef<MCDecodedInst> Insts);
+
+  void unpackInst(uint32_t Idx, MCDecodedInst &DI) const;
+
   typedef std::vector<uint64_t> CalleeListTy;
   CalleeListTy Callees;
   CalleeListTy TailCallees;
@@ -221,6 +304,14 @@ public:
   /// @}
 };
 
+const MCDecodedInst &MCBasicBlock::const_iterator::operator*() const {
+  if (!CurValid) {
+    Parent->unpackInst(Idx, Cur);
+    CurValid = true;
+  }
+  return Cur;
+}
+
 }
 
 #endif
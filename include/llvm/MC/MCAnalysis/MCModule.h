@@ -18,9 +18,11 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/DataTypes.h"
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace llvm {
@@ -39,12 +41,25 @@ class MCModule {
   DenseMap<uint64_t, MCFunction *> FunctionsByAddr;
   /// @}
 
+  /// \brief The arena holding the instructions of all the functions.
+  /// Functions can be disassembled concurrently, so it is guarded by
+  /// InstAllocatorMutex.
+  BumpPtrAllocator InstAllocator;
+  std::mutex InstAllocatorMutex;
+
+  // MCFunction allocates its instructions in the arena.
+  friend class MCFunction;
+  void *allocateInstStorage(size_t Size, size_t Alignment);
+
   MCModule           (const MCModule &) = delete;
   MCModule& operator=(const MCModule &) = delete;
 
   // MCObjectDisassembler creates MCModules.
   friend class MCObjectDisassembler;
 
+  /// \brief Take ownership of \p MCF, created outside of the module.
+  MCFunction *addFunction(std::unique_ptr<MCFunction> MCF);
+
 public:
   MCModule();
   ~MCModule();
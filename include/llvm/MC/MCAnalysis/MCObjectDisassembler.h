@@ -16,6 +16,7 @@
 #define LLVM_MC_MCANALYSIS_MCOBJECTDISASSEMBLER_H
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/MC/MCInst.h"
@@ -68,6 +69,22 @@ public:
     FallbackRegion = { BeginAddr, Region };
   }
 
+  /// \brief Set the number of threads used to disassemble functions when
+  /// building the module CFG.  The resulting MCModule is the same for any
+  /// number of threads.
+  /// When using more than one thread, the MCDisassembler, MCInstrAnalysis,
+  /// and MCObjectSymbolizer need to be safe for concurrent use.  An
+  /// MCCachingDisassembler is, as long as the disassembler it wraps is.
+  void setNumThreads(unsigned N) { NumThreads = N; }
+
+  /// \brief Set the maximum number of bytes of already disassembled section
+  /// contents to keep resident.  Past that, their pages are released with
+  /// madvise, and are read back from the file if they are accessed again.
+  /// This is only meaningful when the object is backed by a read-only file
+  /// mapping, as otherwise the released pages would be zero-filled.
+  /// 0 (the default) never releases anything.
+  void setMaxResidentBytes(uint64_t N) { MaxResidentBytes = N; }
+
 protected:
   const object::ObjectFile &Obj;
   const MCDisassembler &Dis;
@@ -87,6 +104,22 @@ protected:
 
   std::vector<MemoryRegion> SectionRegions;
 
+  /// \brief The regions of the object that are never written to, sorted by
+  /// address.  This includes the text regions, and read-only data, and is
+  /// where jump tables are looked for.
+  std::vector<MemoryRegion> ReadOnlyRegions;
+
+  /// \brief The number of threads to use in buildCFG.
+  unsigned NumThreads = 1;
+
+  /// \brief The number of disassembled bytes to keep resident, or 0.
+  uint64_t MaxResidentBytes = 0;
+
+  /// \brief The section contents disassembled since the last release, as
+  /// [begin, end) pointers, and their total size.
+  std::vector<std::pair<const uint8_t *, const uint8_t *>> DisassembledRanges;
+  uint64_t DisassembledBytes = 0;
+
   /// \brief Return a memory region suitable for reading starting at \p Addr.
   /// In most cases, this returns an ArrayRef backed by the
   /// containing section. When no section was found, this returns the
@@ -102,8 +135,27 @@ private:
   /// single MCTextAtom will be split in multiple basic block atoms.
   void buildCFG(MCModule &Module);
 
+  /// \brief Build the CFG like buildCFG, disassembling functions on
+  /// NumThreads threads.
+  void buildCFGInParallel(MCModule &Module,
+                          SmallSetVector<uint64_t, 16> &WorkList);
+
   void disassembleFunctionAt(MCModule *Module, MCFunction *MCFN,
                              uint64_t BeginAddr);
+
+  /// \brief Record the section contents backing the blocks of \p MCFN, and
+  /// release them if there are more than MaxResidentBytes pending.
+  void noteDisassembled(const MCFunction &MCFN);
+
+  /// \brief Release the pages of all the recorded section contents.
+  void releaseDisassembledRanges();
+
+  /// \brief Look for the jump table used by the indirect branch ending
+  /// \p Insts, the instructions executed before it, at addresses \p Addrs
+  /// (followed by the end address of the branch).
+  /// \returns true if one was found, with its targets in \p Targets.
+  bool findJumpTableTargets(ArrayRef<MCInst> Insts, ArrayRef<uint64_t> Addrs,
+                            AddressSetTy &Targets);
 };
 
 }
@@ -47,6 +47,9 @@ protected:
   const object::RelocationRef *findRelocationAt(uint64_t Addr) const;
   const object::SectionRef *findSectionContaining(uint64_t Addr) const;
 
+  /// \brief Find the relocation that applies exactly at \p Addr, if any.
+  const object::RelocationRef *findRelocationStartingAt(uint64_t Addr) const;
+
 public:
   MCObjectSymbolizer(
       MCContext &Ctx, std::unique_ptr<MCRelocationInfo> RelInfo,
@@ -74,6 +77,13 @@ public:
   /// \returns The function's name, or the empty string if not found.
   virtual StringRef findExternalFunctionAt(uint64_t Addr);
 
+  /// \brief Compute the value of the data at \p Addr, whose contents in the
+  /// object are \p Contents, once the relocation there, if any, is applied.
+  /// \returns false if there is a relocation at \p Addr that can't be
+  /// resolved statically, in which case the contents can't be trusted.
+  virtual bool getRelocatedValueAt(uint64_t Addr, uint64_t Contents,
+                                   uint64_t &Value);
+
   /// Get the original address of the main entrypoint, if there is one.
   Optional<uint64_t> getMainEntrypoint();
 
@@ -96,6 +106,16 @@ public:
   virtual uint64_t getOriginalLoadAddr(uint64_t EffectiveAddr);
   /// @}
 
+  /// \name Get the addresses of static constructors/destructors in the object.
+  /// The caller is expected to know how to interpret the addresses;
+  /// On Mach-O, init functions expect 5 arguments.
+  /// The addresses are original object file load addresses, not effective.
+  /// In the default impl., there are none.
+  /// @{
+  virtual ArrayRef<uint64_t> getStaticInitFunctions();
+  virtual ArrayRef<uint64_t> getStaticExitFunctions();
+  /// @}
+
 protected:
   struct FunctionSymbol {
     uint64_t Addr;
@@ -162,20 +182,17 @@ public:
 
   StringRef findExternalFunctionAt(uint64_t Addr) override;
 
+  bool getRelocatedValueAt(uint64_t Addr, uint64_t Contents,
+                           uint64_t &Value) override;
+
   void tryAddingPcLoadReferenceComment(raw_ostream &cStream, int64_t Value,
                                        uint64_t Address) override;
 
   uint64_t getEffectiveLoadAddr(uint64_t Addr) override;
   uint64_t getOriginalLoadAddr(uint64_t EffectiveAddr) override;
 
-  /// \name Get the addresses of static constructors/destructors in the object.
-  /// The caller is expected to know how to interpret the addresses;
-  /// On Mach-O, init functions expect 5 arguments.
-  /// The addresses are original object file load addresses, not effective.
-  /// @{
-  ArrayRef<uint64_t> getStaticInitFunctions();
-  ArrayRef<uint64_t> getStaticExitFunctions();
-  /// @}
+  ArrayRef<uint64_t> getStaticInitFunctions() override;
+  ArrayRef<uint64_t> getStaticExitFunctions() override;
 
 private:
   void gatherEntrypoints();
@@ -184,12 +201,30 @@ private:
 class MCELFObjectSymbolizer final : public MCObjectSymbolizer {
   const object::ELFObjectFileBase &OF;
 
+  uint64_t LoadBias;
+
+  // .preinit_array/.init_array and .fini_array support, in execution order.
+  std::vector<uint64_t> StaticInitFunctions;
+  std::vector<uint64_t> StaticExitFunctions;
+
 public:
-  /// \brief Construct a Mach-O specific object symbolizer.
-  /// \param VMAddrSlide The virtual address slide applied by dyld.
+  /// \brief Construct an ELF specific object symbolizer.
+  /// \param LoadBias The difference between the effective load address and
+  /// the object file virtual address, as applied by the dynamic loader (for
+  /// PIEs, this is the base address the executable was loaded at).
   MCELFObjectSymbolizer(MCContext &Ctx,
                         std::unique_ptr<MCRelocationInfo> RelInfo,
-                        const object::ELFObjectFileBase &OF);
+                        const object::ELFObjectFileBase &OF,
+                        uint64_t LoadBias = 0);
+
+  uint64_t getEffectiveLoadAddr(uint64_t Addr) override;
+  uint64_t getOriginalLoadAddr(uint64_t EffectiveAddr) override;
+
+  ArrayRef<uint64_t> getStaticInitFunctions() override;
+  ArrayRef<uint64_t> getStaticExitFunctions() override;
+
+private:
+  void gatherStaticInitExitFunctions();
 };
 
 }
@@ -15,6 +15,7 @@
 #ifndef LLVM_MC_MCINSTRANALYSIS_H
 #define LLVM_MC_MCINSTRANALYSIS_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCInstrDesc.h"
 #include "llvm/MC/MCInstrInfo.h"
@@ -65,6 +66,30 @@ public:
   virtual bool
   evaluateBranch(const MCInst &Inst, uint64_t Addr, uint64_t Size,
                  uint64_t &Target) const;
+
+  /// \brief A jump table, as used by an indirect branch.
+  struct JumpTable {
+    /// The address of the first entry.
+    uint64_t Addr;
+    /// The number of entries, as bounded by the index check.
+    uint64_t NumEntries;
+    /// The size of each entry, in bytes.
+    unsigned EntrySize;
+    /// Whether the entries are (signed) offsets from the table address, rather
+    /// than absolute target addresses.
+    bool IsRelative;
+  };
+
+  /// \brief Given an indirect branch, the last instruction in \p Insts, and the
+  /// instructions that precede it, try to find the jump table it uses.
+  /// \p Addrs contains the address of each instruction in \p Insts, followed
+  /// by the address right after the indirect branch.
+  /// Return true on success, and the table in \p JT.
+  virtual bool evaluateJumpTable(ArrayRef<MCInst> Insts,
+                                 ArrayRef<uint64_t> Addrs,
+                                 JumpTable &JT) const {
+    return false;
+  }
 };
 
 } // end namespace llvm
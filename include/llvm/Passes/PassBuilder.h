@@ -333,6 +333,15 @@ public:
   bool parsePassPipeline(ModulePassManager &MPM, StringRef PipelineText,
                          bool VerifyEachPass = true, bool DebugLogging = false);
 
+  /// \brief Parse a textual pass pipeline description into a
+  /// \c FunctionPassManager.
+  ///
+  /// The pipeline must only consist of function passes, or nested function
+  /// pass managers, such as 'loop(...)'.  As with the module overload, a
+  /// pipeline of loop passes is automatically wrapped up in 'loop(...)'.
+  bool parsePassPipeline(FunctionPassManager &FPM, StringRef PipelineText,
+                         bool VerifyEachPass = true, bool DebugLogging = false);
+
   /// Parse a textual alias analysis pipeline into the provided AA manager.
   ///
   /// The format of the textual AA pipeline is a comma separated list of AA
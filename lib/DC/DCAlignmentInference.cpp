@@ -0,0 +1,100 @@
+//===-- lib/DC/DCAlignmentInference.cpp - Infer access alignment -*- C++ -*-=//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCAlignmentInference.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "dc-alignment-inference"
+
+STATISTIC(NumAlignedLoads, "Number of loads with an increased alignment");
+STATISTIC(NumAlignedStores, "Number of stores with an increased alignment");
+
+namespace llvm {
+void initializeDCAlignmentInferencePass(PassRegistry &);
+}
+
+namespace {
+class DCAlignmentInference : public FunctionPass {
+public:
+  static char ID;
+
+  DCAlignmentInference() : FunctionPass(ID) {
+    initializeDCAlignmentInferencePass(*PassRegistry::getPassRegistry());
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<AssumptionCacheTracker>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+} // end anonymous namespace
+
+bool DCAlignmentInference::runOnFunction(Function &F) {
+  AssumptionCache &AC =
+      getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+  const DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  const DataLayout &DL = F.getParent()->getDataLayout();
+
+  bool Changed = false;
+  for (Instruction &I : instructions(F)) {
+    // The registers and the recovered stack frame are already properly
+    // aligned allocas: only look at the guest memory accesses.
+    if (auto *LI = dyn_cast<LoadInst>(&I)) {
+      if (!isa<IntToPtrInst>(LI->getPointerOperand()->stripPointerCasts()))
+        continue;
+      unsigned Align = getKnownAlignment(LI->getPointerOperand(), DL, LI, &AC,
+                                         &DT);
+      if (Align > LI->getAlignment()) {
+        LI->setAlignment(Align);
+        ++NumAlignedLoads;
+        Changed = true;
+      }
+    } else if (auto *SI = dyn_cast<StoreInst>(&I)) {
+      if (!isa<IntToPtrInst>(SI->getPointerOperand()->stripPointerCasts()))
+        continue;
+      unsigned Align = getKnownAlignment(SI->getPointerOperand(), DL, SI, &AC,
+                                         &DT);
+      if (Align > SI->getAlignment()) {
+        SI->setAlignment(Align);
+        ++NumAlignedStores;
+        Changed = true;
+      }
+    }
+  }
+  return Changed;
+}
+
+char DCAlignmentInference::ID = 0;
+INITIALIZE_PASS_BEGIN(DCAlignmentInference, "dc-alignment-inference",
+                      "Infer the Alignment of DC Translated Accesses", false,
+                      false)
+INITIALIZE_PASS_DEPENDENCY(AssumptionCacheTracker)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_END(DCAlignmentInference, "dc-alignment-inference",
+                    "Infer the Alignment of DC Translated Accesses", false,
+                    false)
+
+FunctionPass *llvm::createDCAlignmentInferencePass() {
+  return new DCAlignmentInference();
+}
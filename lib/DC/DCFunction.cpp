@@ -21,6 +21,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/MC/MCAnalysis/MCFunction.h"
@@ -33,6 +34,13 @@ using namespace llvm;
 static cl::opt<bool> EnableRegSetDiff("enable-dc-regset-diff", cl::desc(""),
                                       cl::init(false));
 
+namespace llvm {
+cl::opt<bool> EnableRegSetSaveElision(
+    "dc-elide-regset-saves",
+    cl::desc("Only save and restore, around each call, the registers the "
+             "callee can access."));
+}
+
 DCFunction::DCFunction(DCModule &DCM, const MCFunction &MCF)
     : DCM(DCM), TheFunction(*DCM.getOrCreateFunction(MCF.getStartAddr())),
       TheMCFunction(MCF), BBByAddr(), ExitBB(nullptr), Calls() {
@@ -120,8 +128,8 @@ DCFunction::DCFunction(DCModule &DCM, const MCFunction &MCF)
 
 DCFunction::~DCFunction() {
   for (auto CallI : Calls) {
-    saveLocalRegs(CallI->getParent(), CallI);
-    restoreLocalRegs(CallI->getParent(), ++CallI);
+    saveLocalRegs(CallI->getParent(), CallI, /*AroundCall=*/true);
+    restoreLocalRegs(CallI->getParent(), ++CallI, /*AroundCall=*/true);
   }
   saveLocalRegs(ExitBB, ExitBB->getTerminator()->getIterator());
 }
@@ -158,31 +166,45 @@ void DCFunction::addCallForRegSetSaveRestore(CallInst *CI) {
   Calls.push_back(CI->getIterator());
 }
 
-void DCFunction::saveLocalRegs(BasicBlock *BB, BasicBlock::iterator IP) {
+void DCFunction::saveLocalRegs(BasicBlock *BB, BasicBlock::iterator IP,
+                               bool AroundCall) {
   IRBuilder<> LocalBuilder(BB, IP);
   auto &RSD = getTranslator().getRegSetDesc();
+  MDNode *SaveMD = nullptr;
+  if (AroundCall && EnableRegSetSaveElision)
+    SaveMD = MDNode::get(getContext(), None);
 
   for (unsigned RI = 1, RE = RegAllocas.size(); RI != RE; ++RI) {
     if (!RegAllocas[RI])
       continue;
     int OffsetInSet = RSD.RegOffsetsInSet[RI];
-    if (OffsetInSet != -1)
-      LocalBuilder.CreateStore(LocalBuilder.CreateLoad(RegAllocas[RI]),
-                               RegPtrs[RI]);
+    if (OffsetInSet == -1)
+      continue;
+    StoreInst *SI = LocalBuilder.CreateStore(
+        LocalBuilder.CreateLoad(RegAllocas[RI]), RegPtrs[RI]);
+    if (SaveMD)
+      SI->setMetadata("dc.regset.save", SaveMD);
   }
 }
 
-void DCFunction::restoreLocalRegs(BasicBlock *BB, BasicBlock::iterator IP) {
+void DCFunction::restoreLocalRegs(BasicBlock *BB, BasicBlock::iterator IP,
+                                  bool AroundCall) {
   IRBuilder<> LocalBuilder(BB, IP);
   auto &RSD = getTranslator().getRegSetDesc();
+  MDNode *RestoreMD = nullptr;
+  if (AroundCall && EnableRegSetSaveElision)
+    RestoreMD = MDNode::get(getContext(), None);
 
   for (unsigned RI = 1, RE = RegAllocas.size(); RI != RE; ++RI) {
     if (!RegAllocas[RI])
       continue;
     int OffsetInSet = RSD.RegOffsetsInSet[RI];
-    if (OffsetInSet != -1)
-      LocalBuilder.CreateStore(LocalBuilder.CreateLoad(RegPtrs[RI]),
-                               RegAllocas[RI]);
+    if (OffsetInSet == -1)
+      continue;
+    LoadInst *LI = LocalBuilder.CreateLoad(RegPtrs[RI]);
+    if (RestoreMD)
+      LI->setMetadata("dc.regset.restore", RestoreMD);
+    LocalBuilder.CreateStore(LI, RegAllocas[RI]);
   }
 }
 
@@ -247,6 +269,16 @@ AllocaInst *DCFunction::getOrCreateRegAlloca(unsigned RegNo) {
 
     // Finally, extract the register's value from the incoming regset.
     RI = Builder.CreateLoad(RegTy, RP);
+
+    // Let the optimizers know about the ABI stack alignment, if requested.
+    if (RegNo == getTranslator().getStackPointerRegister() &&
+        getTranslator().assumesEntryStackAlignment()) {
+      unsigned Offset;
+      unsigned Align = getTranslator().getEntryStackAlignment(Offset);
+      Builder.CreateAssumption(
+          Builder.CreateICmpEQ(Builder.CreateAnd(RI, Align - 1),
+                               ConstantInt::get(RegIntTy, Offset)));
+    }
   }
 
   // At this point, we have an initial (entry-block) value for our register.
@@ -30,6 +30,8 @@
 #include "llvm/MC/MCRegisterInfo.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include <algorithm>
 using namespace llvm;
 
 #define DEBUG_TYPE "dc-sema"
@@ -51,16 +53,23 @@ static cl::opt<bool> TranslateUnknownToUndef(
 static cl::opt<bool> EnableInstAddrSave("enable-dc-pc-save", cl::desc(""),
                                         cl::init(false));
 
+static cl::opt<bool> InterpretSemantics(
+    "dc-interpret-semantics",
+    cl::desc("Always interpret the semantics tables, even for instructions "
+             "with compiled semantics"),
+    cl::init(false));
+
 extern "C" uintptr_t __llvm_dc_current_instr = 0;
 
 DCInstruction::DCInstruction(DCBasicBlock &DCB, const MCDecodedInst &MCI,
                              const unsigned *OpcodeToSemaIdx,
                              const uint16_t *SemanticsArray,
-                             const uint64_t *ConstantArray)
+                             const uint64_t *ConstantArray,
+                             const CompiledSemaFn *CompiledSemantics)
     : DCB(DCB), TheMCInst(MCI), Builder(DCB.getBasicBlock()->getTerminator()),
       SemaIdx(OpcodeToSemaIdx[MCI.Inst.getOpcode()]), ResTys(), Vals(),
       OpcodeToSemaIdx(OpcodeToSemaIdx), SemanticsArray(SemanticsArray),
-      ConstantArray(ConstantArray) {
+      ConstantArray(ConstantArray), CompiledSemantics(CompiledSemantics) {
 
   if (auto *DebugStream = getParentModule().getDebugStream()) {
     auto &MIP = getTranslator().getInstPrinter();
@@ -113,9 +122,8 @@ bool DCInstruction::translate() {
   return Success;
 }
 
-Type *DCInstruction::NextTy() {
-  auto NextVT = (MVT::SimpleValueType)Next();
-  switch (NextVT) {
+Type *DCInstruction::getTypeForVT(MVT::SimpleValueType VT) {
+  switch (VT) {
   case MVT::Other:
     return Builder.getVoidTy();
   case MVT::iPTR:
@@ -125,20 +133,33 @@ Type *DCInstruction::NextTy() {
            "Target DataLayout disagrees on pointer width");
     return Builder.getInt64Ty();
   default:
-    return EVT(NextVT).getTypeForEVT(getContext());
+    return EVT(VT).getTypeForEVT(getContext());
   }
 }
 
-void DCInstruction::prepareOperands() {
-  for (unsigned OpI = 0; OpI != Ops.size(); ++OpI)
-    Ops[OpI] = Vals[Next()];
+void DCInstruction::setResultTypes(ArrayRef<MVT::SimpleValueType> ResVTs) {
+  ResTys.clear();
+  for (MVT::SimpleValueType VT : ResVTs)
+    ResTys.push_back(getTypeForVT(VT));
+}
+
+void DCInstruction::setOperands(ArrayRef<uint16_t> OpIdx) {
+  Ops.clear();
+  for (uint16_t Idx : OpIdx)
+    Ops.push_back(Vals[Idx]);
+}
+
+ArrayRef<uint16_t> DCInstruction::prepareOperands() {
+  ArrayRef<uint16_t> OpIdx(SemanticsArray + SemaIdx, Ops.size());
+  setOperands(OpIdx);
+  SemaIdx += OpIdx.size();
+  return OpIdx;
 }
 
 void DCInstruction::dumpOperation(StringRef Opcode,
                                   ArrayRef<Type *> ResultTypes,
                                   ArrayRef<Value *> Operands,
-                                  unsigned SemaStartIdx) {
-  SemaStartIdx += 2;
+                                  ArrayRef<uint16_t> OpIdx) {
   unsigned NumVal = Vals.size();
   dbgs() << "  - ";
   bool PrintComma = false;
@@ -146,7 +167,6 @@ void DCInstruction::dumpOperation(StringRef Opcode,
     if (PrintComma)
       dbgs() << ", ";
     dbgs() << '<' << NumVal++ << ">(";
-    ++SemaStartIdx;
     if (Ty)
       Ty->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
     else
@@ -161,10 +181,11 @@ void DCInstruction::dumpOperation(StringRef Opcode,
   dbgs() << Opcode << "(";
 
   PrintComma = false;
-  for (auto *Op : Operands) {
+  for (unsigned i = 0, e = Operands.size(); i != e; ++i) {
+    Value *Op = Operands[i];
     if (PrintComma)
       dbgs() << ", ";
-    dbgs() << '<' << SemanticsArray[SemaStartIdx++] << ">(";
+    dbgs() << '<' << OpIdx[i] << ">(";
     if (Op)
       Op->printAsOperand(dbgs(), /*PrintType=*/true, getModule());
     else
@@ -225,6 +246,11 @@ bool DCInstruction::tryTranslateInst() {
   if (translateTargetInst())
     return true;
 
+  if (CompiledSemantics && !InterpretSemantics)
+    if (CompiledSemaFn Translate =
+            CompiledSemantics[TheMCInst.Inst.getOpcode()])
+      return Translate(*this);
+
   SemaIdx = OpcodeToSemaIdx[TheMCInst.Inst.getOpcode()];
   if (SemaIdx == ~0U)
     return false;
@@ -238,179 +264,210 @@ bool DCInstruction::tryTranslateInst() {
 }
 
 bool DCInstruction::translateDCOp(uint16_t Opcode) {
-  auto &MRI = getTranslator().getMRI();
-  (void)MRI;
-
   switch (Opcode) {
   case DCINS::PUT_RC: {
     unsigned MIOperandNo = Next();
     unsigned ResOpIdx = Next();
-    unsigned RegNo = getRegOp(MIOperandNo);
-    Value *Res = Vals[ResOpIdx];
-
-    DEBUG({
-      dbgs() << "  - " << MRI.getName(RegNo) << " = PUT_RC <"
-             << ResOpIdx << ">(";
-      Res->printAsOperand(dbgs());
-      dbgs() << ")\n";
-    });
-
-    IntegerType *RegType = getRegIntType(RegNo);
-    if (Res->getType()->isPointerTy())
-      Res = Builder.CreatePtrToInt(Res, RegType);
-    if (!Res->getType()->isIntegerTy())
-      Res = Builder.CreateBitCast(
-          Res, IntegerType::get(getContext(),
-                                Res->getType()->getPrimitiveSizeInBits()));
-    if (Res->getType()->getPrimitiveSizeInBits() < RegType->getBitWidth())
-      Res = llvm::insertBitsInValue(Builder.saveIP(), getRegAsInt(RegNo), Res);
-    assert(Res->getType() == RegType);
-    setReg(RegNo, Res);
-    break;
+    translatePutRC(MIOperandNo, ResOpIdx);
+    return true;
   }
   case DCINS::PUT_REG: {
     unsigned RegNo = Next();
     unsigned ResOpIdx = Next();
-    Value *Res = Vals[ResOpIdx];
-
-    DEBUG({
-      dbgs() << "  - " << MRI.getName(RegNo) << " = PUT_REG <"
-             << ResOpIdx << ">(";
-      Res->printAsOperand(dbgs());
-      dbgs() << ")\n";
-    });
-
-    setReg(RegNo, Res);
-    break;
-  }
-  case DCINS::GET_RC: {
-    unsigned MIOperandNo = Next();
-    unsigned RegNo = getRegOp(MIOperandNo);
-
-    DEBUG({
-      dbgs() << "  - <" << Vals.size() << ">(";
-      ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
-      dbgs() << ") = GET_RC " << MRI.getName(RegNo) << "\n";
-    });
-
-    Value *Reg = getRegAsInt(RegNo);
-    if (getResultTy(0)->getPrimitiveSizeInBits() <
-        Reg->getType()->getPrimitiveSizeInBits())
-      Reg = Builder.CreateTrunc(
-          Reg, IntegerType::get(getContext(),
-                                getResultTy(0)->getPrimitiveSizeInBits()));
-    if (!getResultTy(0)->isIntegerTy())
-      Reg = Builder.CreateBitCast(Reg, getResultTy(0));
-    addResult(Reg);
-    break;
-  }
-  case DCINS::GET_REG: {
-    unsigned RegNo = Next();
-
-    DEBUG({
-      dbgs() << "  - <" << Vals.size() << ">(";
-      ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
-      dbgs() << ") = GET_REG " << MRI.getName(RegNo) << "\n";
-    });
-
-    Value *RegVal = getReg(RegNo);
-    addResult(RegVal);
-    break;
+    translatePutReg(RegNo, ResOpIdx);
+    return true;
   }
+  case DCINS::GET_RC:
+    translateGetRC(Next());
+    return true;
+  case DCINS::GET_REG:
+    translateGetReg(Next());
+    return true;
   case DCINS::CUSTOM_OP: {
     unsigned OperandKind = Next(), MIOperandNo = Next();
-
-    DEBUG({
-      dbgs() << "  - <" << Vals.size() << ">(";
-      ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
-      dbgs() << ") = CUSTOM_OP " << getDCCustomOpName(OperandKind) << " "
-             << MIOperandNo << "\n";
-    });
-
-    Value *Op = translateCustomOperand(OperandKind, MIOperandNo);
-    if (!Op)
-      return false;
-    addResult(Op);
-    break;
+    return translateCustomOp(OperandKind, MIOperandNo);
   }
   case DCINS::COMPLEX_PATTERN: {
     unsigned PatternKind = Next();
     // Fill the operands array, taking care to remove our PatternKind operand.
     Ops.pop_back();
-    prepareOperands();
-
-    DEBUG(dumpOperation(
-        ("COMPLEX_PATTERN " + getDCComplexPatternName(PatternKind)).str(),
-        ResTys, Ops, SemaIdx - Ops.size() - ResTys.size() - 3));
-
-    Value *Op = translateComplexPattern(PatternKind);
-    if (!Op)
-      return false;
-    addResult(Op);
-    break;
+    return translateComplexPatternOp(PatternKind, prepareOperands());
   }
   case DCINS::PREDICATE: {
     unsigned PredicateKind = Next();
     // Fill the operands array, taking care to remove our PredicateKind operand.
     Ops.pop_back();
-    prepareOperands();
+    return translatePredicateOp(PredicateKind, prepareOperands());
+  }
+  case DCINS::GET_IMMEDIATE:
+    translateGetImmediate(Next());
+    return true;
+  case DCINS::GET_CONSTANT:
+    translateGetConstant(ConstantArray[Next()]);
+    return true;
+  case DCINS::IMPLICIT:
+    return translateImplicitOp(Next());
+  default:
+    llvm_unreachable("Unexpected non-DCINS opcode");
+  }
+}
 
-    DEBUG(dumpOperation(
-        ("PREDICATE " + getDCPredicateName(PredicateKind)).str(),
-        ResTys, Ops, SemaIdx - Ops.size() - ResTys.size() - 3));
+void DCInstruction::translatePutRC(unsigned MIOperandNo, unsigned ResOpIdx) {
+  unsigned RegNo = getRegOp(MIOperandNo);
+  Value *Res = Vals[ResOpIdx];
+
+  DEBUG({
+    dbgs() << "  - " << getTranslator().getMRI().getName(RegNo)
+           << " = PUT_RC <" << ResOpIdx << ">(";
+    Res->printAsOperand(dbgs());
+    dbgs() << ")\n";
+  });
+
+  IntegerType *RegType = getRegIntType(RegNo);
+  if (Res->getType()->isPointerTy())
+    Res = Builder.CreatePtrToInt(Res, RegType);
+  if (!Res->getType()->isIntegerTy())
+    Res = Builder.CreateBitCast(
+        Res, IntegerType::get(getContext(),
+                              Res->getType()->getPrimitiveSizeInBits()));
+  if (Res->getType()->getPrimitiveSizeInBits() < RegType->getBitWidth())
+    Res = llvm::insertBitsInValue(Builder.saveIP(), getRegAsInt(RegNo), Res);
+  assert(Res->getType() == RegType);
+  setReg(RegNo, Res);
+}
 
-    if (!translatePredicate(PredicateKind))
-      return false;
-    break;
-  }
-  case DCINS::GET_IMMEDIATE: {
-    unsigned MIOperandNo = Next();
-    Value *Cst = ConstantInt::get(cast<IntegerType>(getResultTy(0)),
-                                  getImmOp(MIOperandNo));
+void DCInstruction::translatePutReg(unsigned RegNo, unsigned ResOpIdx) {
+  Value *Res = Vals[ResOpIdx];
 
-    DEBUG({
-      dbgs() << "  - <" << Vals.size() << ">(";
-      ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
-      dbgs() << ") = GET_IMMEDIATE ";
-      Cst->printAsOperand(dbgs(), /*PrintType=*/false, getModule());
-    });
+  DEBUG({
+    dbgs() << "  - " << getTranslator().getMRI().getName(RegNo)
+           << " = PUT_REG <" << ResOpIdx << ">(";
+    Res->printAsOperand(dbgs());
+    dbgs() << ")\n";
+  });
 
-    addResult(Cst);
-    break;
-  }
-  case DCINS::GET_CONSTANT: {
-    uint64_t ValIdx = Next();
+  setReg(RegNo, Res);
+}
 
-    DEBUG(dbgs() << "  - <" << Vals.size() << ">(";
-          ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
-          dbgs() << ") = GET_CONSTANT " << ValIdx << "\n");
+void DCInstruction::translateGetRC(unsigned MIOperandNo) {
+  unsigned RegNo = getRegOp(MIOperandNo);
+
+  DEBUG({
+    dbgs() << "  - <" << Vals.size() << ">(";
+    ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
+    dbgs() << ") = GET_RC " << getTranslator().getMRI().getName(RegNo)
+           << "\n";
+  });
+
+  Value *Reg = getRegAsInt(RegNo);
+  if (getResultTy(0)->getPrimitiveSizeInBits() <
+      Reg->getType()->getPrimitiveSizeInBits())
+    Reg = Builder.CreateTrunc(
+        Reg, IntegerType::get(getContext(),
+                              getResultTy(0)->getPrimitiveSizeInBits()));
+  if (!getResultTy(0)->isIntegerTy())
+    Reg = Builder.CreateBitCast(Reg, getResultTy(0));
+  addResult(Reg);
+}
 
-    const DataLayout &DL = getModule()->getDataLayout();
-    Type *CTy = getResultTy(0);
-    if (!CTy->isIntegerTy())
-      CTy = Builder.getIntNTy(DL.getTypeSizeInBits(CTy));
-    Constant *C = ConstantInt::get(CTy, ConstantArray[ValIdx]);
-    C = ConstantExpr::getCast(CastInst::getCastOpcode(C, /*SrcIsSigned=*/false,
-                                                      getResultTy(0),
-                                                      /*DstIsSigned=*/false),
-                              C, getResultTy(0));
-    addResult(C);
-    break;
-  }
-  case DCINS::IMPLICIT: {
-    const unsigned RegNo = Next();
+void DCInstruction::translateGetReg(unsigned RegNo) {
+  DEBUG({
+    dbgs() << "  - <" << Vals.size() << ">(";
+    ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
+    dbgs() << ") = GET_REG " << getTranslator().getMRI().getName(RegNo)
+           << "\n";
+  });
 
-    DEBUG(dbgs() << "  - " << MRI.getName(RegNo) << " = IMPLICIT\n");
+  Value *RegVal = getReg(RegNo);
+  addResult(RegVal);
+}
 
-    translateImplicit(RegNo);
-    break;
-  }
-  default:
-    llvm_unreachable("Unexpected non-DCINS opcode");
-  }
+bool DCInstruction::translateCustomOp(unsigned OperandKind,
+                                      unsigned MIOperandNo) {
+  DEBUG({
+    dbgs() << "  - <" << Vals.size() << ">(";
+    ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
+    dbgs() << ") = CUSTOM_OP " << getDCCustomOpName(OperandKind) << " "
+           << MIOperandNo << "\n";
+  });
+
+  Value *Op = translateCustomOperand(OperandKind, MIOperandNo);
+  if (!Op)
+    return false;
+  addResult(Op);
   return true;
 }
 
+bool DCInstruction::translateComplexPatternOp(unsigned PatternKind,
+                                              ArrayRef<uint16_t> OpIdx) {
+  DEBUG(dumpOperation(
+      ("COMPLEX_PATTERN " + getDCComplexPatternName(PatternKind)).str(),
+      ResTys, Ops, OpIdx));
+
+  Value *Op = translateComplexPattern(PatternKind);
+  if (!Op)
+    return false;
+  addResult(Op);
+  return true;
+}
+
+bool DCInstruction::translatePredicateOp(unsigned PredicateKind,
+                                         ArrayRef<uint16_t> OpIdx) {
+  DEBUG(dumpOperation(
+      ("PREDICATE " + getDCPredicateName(PredicateKind)).str(),
+      ResTys, Ops, OpIdx));
+
+  return translatePredicate(PredicateKind);
+}
+
+void DCInstruction::translateGetImmediate(unsigned MIOperandNo) {
+  Value *Cst = ConstantInt::get(cast<IntegerType>(getResultTy(0)),
+                                getImmOp(MIOperandNo));
+
+  DEBUG({
+    dbgs() << "  - <" << Vals.size() << ">(";
+    ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
+    dbgs() << ") = GET_IMMEDIATE ";
+    Cst->printAsOperand(dbgs(), /*PrintType=*/false, getModule());
+  });
+
+  addResult(Cst);
+}
+
+void DCInstruction::translateGetConstant(uint64_t Val) {
+  DEBUG(dbgs() << "  - <" << Vals.size() << ">(";
+        ResTys[0]->print(dbgs(), /*IsForDebug=*/true, /*NoDetails=*/true);
+        dbgs() << ") = GET_CONSTANT " << Val << "\n");
+
+  const DataLayout &DL = getModule()->getDataLayout();
+  Type *CTy = getResultTy(0);
+  if (!CTy->isIntegerTy())
+    CTy = Builder.getIntNTy(DL.getTypeSizeInBits(CTy));
+  Constant *C = ConstantInt::get(CTy, Val);
+  C = ConstantExpr::getCast(CastInst::getCastOpcode(C, /*SrcIsSigned=*/false,
+                                                    getResultTy(0),
+                                                    /*DstIsSigned=*/false),
+                            C, getResultTy(0));
+  addResult(C);
+}
+
+bool DCInstruction::translateImplicitOp(unsigned RegNo) {
+  DEBUG(dbgs() << "  - " << getTranslator().getMRI().getName(RegNo)
+               << " = IMPLICIT\n");
+
+  translateImplicit(RegNo);
+  return true;
+}
+
+bool DCInstruction::checkNumResults(bool Success, unsigned OldNumVals) {
+  // We promised to generate one result per result type.  Make sure we didn't
+  // lie.
+  (void)OldNumVals;
+  assert((!Success || (Vals.size() == OldNumVals + ResTys.size())) &&
+         "Operation didn't define as many results as declared in its signature");
+  return Success;
+}
+
 bool DCInstruction::translateOpcode(unsigned Opcode) {
   // We already ate the opcode; the next element in the semantics array is the
   // "signature", with:
@@ -420,45 +477,37 @@ bool DCInstruction::translateOpcode(unsigned Opcode) {
   const uint8_t NumResults = Signature >> 8;
   const uint8_t NumOperands = Signature & 0xFF;
 
-  // Prepare our result type array.
+  // Next in the semantics array are the NumResults result types.
   ResTys.clear();
-  ResTys.resize(NumResults);
+  for (unsigned ResI = 0; ResI != NumResults; ++ResI)
+    ResTys.push_back(NextTy());
 
   // Prepare our operand array.
   Ops.clear();
   Ops.resize(NumOperands);
 
-  // Next in the semantics array are the NumResults result types.
-  for (unsigned ResI = 0; ResI != NumResults; ++ResI)
-    ResTys[ResI] = NextTy();
-
-  // We promised to generate NumResults results.  Make sure we didn't lie.
   const unsigned OldNumVals = Vals.size();
-  auto DoAndCheckResults = [&](bool Success) {
-    (void)OldNumVals;
-    assert((!Success ||
-        (Vals.size() == OldNumVals + NumResults)) &&
-        "Operation didn't define as many results as declared in its signature");
-    return Success;
-  };
 
   // Next are the operands, which are always an index in the table of previously
   // produced results, except for the special DCINS builtin operations, which
   // have operation-specific behavior.  Deal with those first.
   if (Opcode >= DCINS::DC_OPCODE_START && Opcode <= DCINS::END_OF_INSTRUCTION)
-    return DoAndCheckResults(translateDCOp(Opcode));
+    return checkNumResults(translateDCOp(Opcode), OldNumVals);
 
   // Finally, handle the regular (ISD) operations.  The remaining elements in
   // the semantics array entry is the index of each operand in the Vals table.
-  prepareOperands();
+  ArrayRef<uint16_t> OpIdx = prepareOperands();
+  return checkNumResults(translateOperation(Opcode, OpIdx), OldNumVals);
+}
 
-  DEBUG(dumpOperation(getDCOpcodeName(Opcode), ResTys, Ops,
-                      SemaIdx - NumOperands - NumResults - 2));
+bool DCInstruction::translateOperation(unsigned Opcode,
+                                       ArrayRef<uint16_t> OpIdx) {
+  DEBUG(dumpOperation(getDCOpcodeName(Opcode), ResTys, Ops, OpIdx));
 
   // At this point, we prepared the types and operands.  We just need to do
   // the translation, starting with the target-specific nodes.
   if (Opcode >= ISD::BUILTIN_OP_END)
-    return DoAndCheckResults(translateTargetOpcode(Opcode));
+    return translateTargetOpcode(Opcode);
 
   switch (Opcode) {
   case ISD::ADD:
@@ -612,32 +661,51 @@ bool DCInstruction::translateOpcode(unsigned Opcode) {
     break;
   }
   case ISD::LOAD: {
-    Type *ResPtrTy = getResultTy(0)->getPointerTo();
-    Value *Ptr = getOperand(0);
-    if (!Ptr->getType()->isPointerTy())
-      Ptr = Builder.CreateIntToPtr(Ptr, ResPtrTy);
-    else if (Ptr->getType() != ResPtrTy)
-      Ptr = Builder.CreateBitCast(Ptr, ResPtrTy);
-    addResult(Builder.CreateAlignedLoad(Ptr, 1));
+    translateLoad();
     break;
   }
   case ISD::STORE: {
-    Value *Val = getOperand(0);
-    Value *Ptr = getOperand(1);
-    Type *ValPtrTy = Val->getType()->getPointerTo();
-    Type *PtrTy = Ptr->getType();
-    if (!PtrTy->isPointerTy())
-      Ptr = Builder.CreateIntToPtr(Ptr, ValPtrTy);
-    else if (PtrTy != ValPtrTy)
-      Ptr = Builder.CreateBitCast(Ptr, ValPtrTy);
-    Builder.CreateAlignedStore(Val, Ptr, 1);
+    translateStore();
     break;
   }
   case ISD::BRIND: {
     Value *Op0 = getOperand(0);
     setReg(getTranslator().getMRI().getProgramCounter(), Op0);
+
+    // If the MC CFG knows the possible targets (e.g., from a jump table),
+    // switch over them, and only go through the dispatcher for the others.
+    const MCBasicBlock &MCBB = DCB.getMCBasicBlock();
+    if (MCBB.succ_begin() == MCBB.succ_end()) {
+      insertCall(Op0);
+      Builder.CreateBr(getParentFunction().getExitBlock());
+      break;
+    }
+
+    // The registers are live in all the targets: flush them before
+    // branching.
+    DCB.saveAllLiveRegs();
+
+    // Emit the dispatcher call first: flushing the registers again can still
+    // add stores to this block (not the dispatch block), and they have to go
+    // before the switch.
+    auto *DispatchBB = BasicBlock::Create(
+        getContext(), "dispatch_" + utohexstr(TheMCInst.Address),
+        getFunction());
+    Instruction *SwitchPt = &*Builder.GetInsertPoint();
+    Builder.SetInsertPoint(DispatchBB);
     insertCall(Op0);
     Builder.CreateBr(getParentFunction().getExitBlock());
+
+    Builder.SetInsertPoint(SwitchPt);
+    auto *OpTy = cast<IntegerType>(Op0->getType());
+    SwitchInst *SI = Builder.CreateSwitch(
+        Op0, DispatchBB, std::distance(MCBB.succ_begin(), MCBB.succ_end()));
+    for (auto SuccI = MCBB.succ_begin(), SuccE = MCBB.succ_end();
+         SuccI != SuccE; ++SuccI) {
+      uint64_t Target = (*SuccI)->getStartAddr();
+      SI->addCase(ConstantInt::get(OpTy, Target),
+                  getParentFunction().getOrCreateBasicBlock(Target));
+    }
     break;
   }
   case ISD::BR: {
@@ -690,19 +758,127 @@ bool DCInstruction::translateOpcode(unsigned Opcode) {
            << getTranslator().getMII().getName(TheMCInst.Inst.getOpcode())
            << ": " << TheMCInst.Inst << "\n";
     errs() << "Opcode: " << Opcode << "\n";
-    return DoAndCheckResults(false);
+    return false;
   }
-  return DoAndCheckResults(true);
+  return true;
+}
+
+bool DCInstruction::semaGetRC(MVT::SimpleValueType VT, unsigned MIOperandNo) {
+  setResultTypes(VT);
+  translateGetRC(MIOperandNo);
+  return true;
+}
+
+bool DCInstruction::semaPutRC(unsigned MIOperandNo, unsigned ValIdx) {
+  translatePutRC(MIOperandNo, ValIdx);
+  return true;
+}
+
+bool DCInstruction::semaGetReg(MVT::SimpleValueType VT, unsigned RegNo) {
+  setResultTypes(VT);
+  translateGetReg(RegNo);
+  return true;
+}
+
+bool DCInstruction::semaPutReg(unsigned RegNo, unsigned ValIdx) {
+  translatePutReg(RegNo, ValIdx);
+  return true;
+}
+
+bool DCInstruction::semaCustomOp(MVT::SimpleValueType VT, unsigned OperandKind,
+                                 unsigned MIOperandNo) {
+  setResultTypes(VT);
+  return translateCustomOp(OperandKind, MIOperandNo);
+}
+
+bool DCInstruction::semaGetImmediate(MVT::SimpleValueType VT,
+                                     unsigned MIOperandNo) {
+  setResultTypes(VT);
+  translateGetImmediate(MIOperandNo);
+  return true;
+}
+
+bool DCInstruction::semaGetConstant(MVT::SimpleValueType VT, uint64_t Val) {
+  setResultTypes(VT);
+  translateGetConstant(Val);
+  return true;
+}
+
+bool DCInstruction::semaImplicit(unsigned RegNo) {
+  return translateImplicitOp(RegNo);
+}
+
+bool DCInstruction::semaComplexPattern(ArrayRef<MVT::SimpleValueType> ResVTs,
+                                       unsigned PatternKind,
+                                       ArrayRef<uint16_t> OpIdx) {
+  setResultTypes(ResVTs);
+  setOperands(OpIdx);
+  const unsigned OldNumVals = Vals.size();
+  return checkNumResults(translateComplexPatternOp(PatternKind, OpIdx),
+                         OldNumVals);
+}
+
+bool DCInstruction::semaPredicate(ArrayRef<MVT::SimpleValueType> ResVTs,
+                                  unsigned PredicateKind,
+                                  ArrayRef<uint16_t> OpIdx) {
+  setResultTypes(ResVTs);
+  setOperands(OpIdx);
+  const unsigned OldNumVals = Vals.size();
+  return checkNumResults(translatePredicateOp(PredicateKind, OpIdx),
+                         OldNumVals);
+}
+
+bool DCInstruction::semaOperation(unsigned Opcode,
+                                  ArrayRef<MVT::SimpleValueType> ResVTs,
+                                  ArrayRef<uint16_t> OpIdx) {
+  setResultTypes(ResVTs);
+  setOperands(OpIdx);
+  const unsigned OldNumVals = Vals.size();
+  return checkNumResults(translateOperation(Opcode, OpIdx), OldNumVals);
 }
 
 Value *DCInstruction::translateComplexPattern(unsigned) {
   return nullptr;
 }
 
+unsigned DCInstruction::getAccessAlignment(Value *Ptr, unsigned MinAlign) {
+  // Most addresses are only known after the registers are promoted, see
+  // DCAlignmentInference; this catches constant and masked addresses.
+  return std::max(MinAlign,
+                  getKnownAlignment(Ptr, getModule()->getDataLayout()));
+}
+
+void DCInstruction::translateLoad(unsigned MinAlign) {
+  Type *ResPtrTy = getResultTy(0)->getPointerTo();
+  Value *Ptr = getOperand(0);
+  if (!Ptr->getType()->isPointerTy())
+    Ptr = Builder.CreateIntToPtr(Ptr, ResPtrTy);
+  else if (Ptr->getType() != ResPtrTy)
+    Ptr = Builder.CreateBitCast(Ptr, ResPtrTy);
+  addResult(Builder.CreateAlignedLoad(Ptr, getAccessAlignment(Ptr, MinAlign)));
+}
+
+void DCInstruction::translateStore(unsigned MinAlign, bool isNonTemporal) {
+  Value *Val = getOperand(0);
+  Value *Ptr = getOperand(1);
+  Type *ValPtrTy = Val->getType()->getPointerTo();
+  Type *PtrTy = Ptr->getType();
+  if (!PtrTy->isPointerTy())
+    Ptr = Builder.CreateIntToPtr(Ptr, ValPtrTy);
+  else if (PtrTy != ValPtrTy)
+    Ptr = Builder.CreateBitCast(Ptr, ValPtrTy);
+  StoreInst *SI =
+      Builder.CreateAlignedStore(Val, Ptr, getAccessAlignment(Ptr, MinAlign));
+  if (isNonTemporal)
+    SI->setMetadata(LLVMContext::MD_nontemporal,
+                    MDNode::get(getContext(), ConstantAsMetadata::get(
+                                                  Builder.getInt32(1))));
+}
+
 bool DCInstruction::translateExtLoad(Type *MemTy, bool isSExt) {
   Value *Ptr = getOperand(0);
   Ptr = Builder.CreateBitOrPointerCast(Ptr, MemTy->getPointerTo());
-  Value *V = Builder.CreateLoad(MemTy, Ptr);
+  Value *V = Builder.CreateAlignedLoad(Ptr, getAccessAlignment(Ptr, 1));
   addResult(isSExt ? Builder.CreateSExt(V, getResultTy(0))
                    : Builder.CreateZExt(V, getResultTy(0)));
   return true;
@@ -710,45 +886,48 @@ bool DCInstruction::translateExtLoad(Type *MemTy, bool isSExt) {
 
 bool DCInstruction::translatePredicate(unsigned PredicateKind) {
   switch (PredicateKind) {
+  // The instructions selected by the aligned predicates fault on misaligned
+  // addresses, so their accesses are known to be aligned.  memop doesn't
+  // imply anything: it also matches unaligned loads on some subtargets.
+  case TargetOpcode::Predicate::alignedload:
+    translateLoad(16);
+    return true;
+  case TargetOpcode::Predicate::alignedload256:
+    translateLoad(32);
+    return true;
+  case TargetOpcode::Predicate::alignedload512:
+    translateLoad(64);
+    return true;
   case TargetOpcode::Predicate::memop64:
   case TargetOpcode::Predicate::memop:
   case TargetOpcode::Predicate::loadi16:
   case TargetOpcode::Predicate::loadi32:
-  case TargetOpcode::Predicate::alignedload:
-  case TargetOpcode::Predicate::alignedload256:
-  case TargetOpcode::Predicate::alignedload512:
   case TargetOpcode::Predicate::vec128load:
   case TargetOpcode::Predicate::vec256load:
   case TargetOpcode::Predicate::vec512load:
-  // FIXME: Take advantage of the implied alignment.
-  case TargetOpcode::Predicate::load: {
-    Type *ResPtrTy = getResultTy(0)->getPointerTo();
-    Value *Ptr = getOperand(0);
-    if (!Ptr->getType()->isPointerTy())
-      Ptr = Builder.CreateIntToPtr(Ptr, ResPtrTy);
-    else if (Ptr->getType() != ResPtrTy)
-      Ptr = Builder.CreateBitCast(Ptr, ResPtrTy);
-    addResult(Builder.CreateAlignedLoad(Ptr, 1));
+  case TargetOpcode::Predicate::load:
+    translateLoad();
     return true;
-  }
   case TargetOpcode::Predicate::alignednontemporalstore:
+    translateStore(
+        getModule()->getDataLayout().getTypeStoreSize(getOperand(0)->getType()),
+        /*isNonTemporal=*/true);
+    return true;
   case TargetOpcode::Predicate::nontemporalstore:
+    translateStore(1, /*isNonTemporal=*/true);
+    return true;
   case TargetOpcode::Predicate::alignedstore:
+    translateStore(16);
+    return true;
   case TargetOpcode::Predicate::alignedstore256:
+    translateStore(32);
+    return true;
   case TargetOpcode::Predicate::alignedstore512:
-  // FIXME: Take advantage of NT/alignment.
-  case TargetOpcode::Predicate::store: {
-    Value *Val = getOperand(0);
-    Value *Ptr = getOperand(1);
-    Type *ValPtrTy = Val->getType()->getPointerTo();
-    Type *PtrTy = Ptr->getType();
-    if (!PtrTy->isPointerTy())
-      Ptr = Builder.CreateIntToPtr(Ptr, ValPtrTy);
-    else if (PtrTy != ValPtrTy)
-      Ptr = Builder.CreateBitCast(Ptr, ValPtrTy);
-    Builder.CreateAlignedStore(Val, Ptr, 1);
+    translateStore(64);
+    return true;
+  case TargetOpcode::Predicate::store:
+    translateStore();
     return true;
-  }
   case TargetOpcode::Predicate::zextloadi8:
     return translateExtLoad(Builder.getInt8Ty());
   case TargetOpcode::Predicate::zextloadi16:
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/DC/DCModule.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/DC/DCTranslator.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
@@ -22,6 +23,9 @@ using namespace llvm;
 
 #define DEBUG_TYPE "dc-module"
 
+STATISTIC(NumTypedExternalWrappers,
+          "Number of external functions called with their prototype");
+
 static cl::opt<std::string> DebugInfoDir(
     "debug-info-dir",
     cl::desc("The path to a directory where synthetic source files can be "
@@ -108,29 +112,42 @@ unsigned DCModule::incrementDebugLine() { return DebugLine++; }
 
 Function *DCModule::createExternalWrapperFunction(uint64_t Addr,
                                                   StringRef Name) {
+  if (FunctionType *ExtFnTy = DCT.getExternalFunctionType(Name))
+    return createExternalWrapperFunction(
+        Addr, getModule()->getOrInsertFunction(Name, ExtFnTy), ExtFnTy);
+
   Function *ExtFn = cast<Function>(getModule()->getOrInsertFunction(
       Name,
       FunctionType::get(Type::getVoidTy(getContext()), /*isVarArg=*/false)));
   return createExternalWrapperFunction(Addr, ExtFn);
 }
 
-Function *DCModule::createExternalWrapperFunction(uint64_t Addr) {
+Function *DCModule::createExternalWrapperFunction(uint64_t Addr,
+                                                  FunctionType *ExtFnTy) {
+  Type *ExtFnPtrTy =
+      ExtFnTy ? ExtFnTy->getPointerTo()
+              : FunctionType::get(Type::getVoidTy(getContext()),
+                                  /*isVarArg=*/false)->getPointerTo();
   Value *ExtFn = ConstantExpr::getIntToPtr(
-      ConstantInt::get(Type::getInt64Ty(getContext()), Addr),
-      FunctionType::get(Type::getVoidTy(getContext()), /*isVarArg=*/false)
-          ->getPointerTo());
+      ConstantInt::get(Type::getInt64Ty(getContext()), Addr), ExtFnPtrTy);
 
-  return createExternalWrapperFunction(Addr, ExtFn);
+  return createExternalWrapperFunction(Addr, ExtFn, ExtFnTy);
 }
 
-Function *DCModule::createExternalWrapperFunction(uint64_t Addr, Value *ExtFn) {
+Function *DCModule::createExternalWrapperFunction(uint64_t Addr, Value *ExtFn,
+                                                  FunctionType *ExtFnTy) {
   Function *Fn = getOrCreateFunction(Addr);
   if (!Fn->isDeclaration())
     return Fn;
 
   BasicBlock *BB = BasicBlock::Create(getContext(), "", Fn);
   Value *RegSet = &*Fn->arg_begin();
-  insertExternalWrapperAsm(BB, ExtFn, RegSet);
+  if (ExtFnTy && insertExternalWrapperCall(BB, ExtFn, ExtFnTy, RegSet)) {
+    ++NumTypedExternalWrappers;
+  } else {
+    insertExternalWrapperAsm(BB, ExtFn, RegSet);
+    ExternalWrappers.insert(Fn);
+  }
   ReturnInst::Create(getContext(), BB);
   return Fn;
 }
@@ -0,0 +1,100 @@
+//===-- lib/DC/DCPassPipeline.cpp - DC Optimization Pipeline ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCPassPipeline.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/ErrorHandling.h"
+
+using namespace llvm;
+
+DCPassPipeline::DCPassPipeline(StringRef FunctionPipeline,
+                               StringRef ModulePipeline)
+    : FunctionPipeline(FunctionPipeline), ModulePipeline(ModulePipeline) {
+  // Register the default alias analyses first, so that registering the
+  // function analyses doesn't register an empty AAManager.
+  FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  if (!FunctionPipeline.empty() &&
+      !PB.parsePassPipeline(FPM, FunctionPipeline, /*VerifyEachPass=*/false))
+    report_fatal_error(Twine("Unable to parse function pass pipeline '") +
+                       FunctionPipeline + "'");
+  if (!ModulePipeline.empty() &&
+      !PB.parsePassPipeline(MPM, ModulePipeline, /*VerifyEachPass=*/false))
+    report_fatal_error(Twine("Unable to parse module pass pipeline '") +
+                       ModulePipeline + "'");
+}
+
+// The translated IR is mostly made of register set loads and stores, flag
+// computations that are never used, and unaligned memory accesses through
+// inttoptr.  O1 is used for code that might only run a few times (e.g., by
+// DYN, at tier 0), so it only gets mem2reg and the alignment inference, run
+// before the pipeline.  Past that, EarlyCSE removes most of the redundant loads
+// and computations, for little compile time.  ADCE then removes the unused
+// flags, which leaves the final instcombine much less to do.
+// GVN is the most expensive pass; it only pays off at O3, when the code is
+// expected to run for a long time.
+
+StringRef DCPassPipeline::getDefaultFunctionPipeline(unsigned OptLevel) {
+  switch (OptLevel) {
+  case 0:
+  case 1:
+    return "";
+  case 2:
+    return "early-cse,simplify-cfg,adce,instcombine";
+  default:
+    return "early-cse,simplify-cfg,instcombine,gvn,adce,simplify-cfg,"
+           "instcombine";
+  }
+}
+
+StringRef DCPassPipeline::getDefaultModulePipeline(unsigned OptLevel,
+                                                   bool PromotesRegSet) {
+  // Register set promotion replaces the register set of promoted functions
+  // with a local copy, that SROA needs to promote in turn, which exposes more
+  // redundancies to the rest of the pipeline.  Otherwise, the functions were
+  // already optimized by the function pipeline.
+  if (!PromotesRegSet)
+    return "";
+  switch (OptLevel) {
+  case 0:
+    return "";
+  case 1:
+    return "function(sroa)";
+  case 2:
+    return "function(sroa,early-cse,instcombine)";
+  default:
+    return "function(sroa,early-cse,gvn,instcombine,simplify-cfg)";
+  }
+}
+
+void DCPassPipeline::runOnFunction(Function &F) {
+  if (FunctionPipeline.empty())
+    return;
+  FPM.run(F, FAM);
+  FAM.clear(F);
+  LAM.clear();
+}
+
+void DCPassPipeline::runOnModule(Module &M) {
+  if (ModulePipeline.empty())
+    return;
+  MPM.run(M, MAM);
+  // The module is handed off, and never optimized again.
+  MAM.clear();
+  CGAM.clear();
+  FAM.clear();
+  LAM.clear();
+}
@@ -0,0 +1,318 @@
+//===-- lib/DC/DCRegSetPromotion.cpp - Promote regset accesses --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCRegSetPromotion.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "dc-regset-promotion"
+
+STATISTIC(NumPromotedFunctions, "Number of functions with a promoted regset");
+STATISTIC(NumPromotedCalls, "Number of calls passing registers as values");
+
+namespace llvm {
+void initializeDCRegSetPromotionPass(PassRegistry &);
+}
+
+namespace {
+/// The regset fields accessed by a translated function, and its callees.
+struct RegSetAccessInfo {
+  BitVector Read, Written;
+  /// The translated functions called directly with the regset.
+  SmallVector<Function *, 4> Callees;
+  /// Whether the regset is used in any other way, in which case the whole
+  /// regset needs to be in memory.
+  bool Escapes = false;
+
+  explicit RegSetAccessInfo(unsigned NumFields)
+      : Read(NumFields), Written(NumFields) {}
+};
+
+/// A promoted function, and the regset fields it takes and returns.
+struct PromotedFunction {
+  Function *PF;
+  SmallVector<unsigned, 8> InFields, OutFields;
+};
+
+class DCRegSetPromotion : public ModulePass {
+  FunctionType *FuncTy;
+
+public:
+  static char ID;
+
+  DCRegSetPromotion(FunctionType *FuncTy = nullptr)
+      : ModulePass(ID), FuncTy(FuncTy) {
+    initializeDCRegSetPromotionPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  bool isTranslatedFunction(const Function *F) const {
+    return F && !F->isDeclaration() && F->getFunctionType() == FuncTy;
+  }
+
+  void analyzeFunction(Function &F, RegSetAccessInfo &Info) const;
+  PromotedFunction promoteFunction(Function &F, const RegSetAccessInfo &Info);
+  void rewritePromotedCalls(
+      const PromotedFunction &Caller,
+      const MapVector<Function *, PromotedFunction> &Promoted);
+};
+} // end anonymous namespace
+
+/// Get the index of the regset field addressed by \p GEP, a GEP on the regset,
+/// or -1 if it isn't constant.
+static int getRegSetFieldIndex(const GetElementPtrInst *GEP) {
+  if (GEP->getNumIndices() < 2)
+    return -1;
+  auto *Idx0 = dyn_cast<ConstantInt>(GEP->getOperand(1));
+  auto *Idx1 = dyn_cast<ConstantInt>(GEP->getOperand(2));
+  if (!Idx0 || !Idx0->isZero() || !Idx1)
+    return -1;
+  return Idx1->getZExtValue();
+}
+
+void DCRegSetPromotion::analyzeFunction(Function &F,
+                                        RegSetAccessInfo &Info) const {
+  Argument *RegSetArg = &*F.arg_begin();
+  for (User *U : RegSetArg->users()) {
+    if (auto *GEP = dyn_cast<GetElementPtrInst>(U)) {
+      int Field = getRegSetFieldIndex(GEP);
+      if (Field == -1) {
+        Info.Escapes = true;
+        return;
+      }
+      for (User *GU : GEP->users()) {
+        if (isa<LoadInst>(GU)) {
+          Info.Read.set(Field);
+        } else if (auto *SI = dyn_cast<StoreInst>(GU)) {
+          if (SI->getPointerOperand() != GEP) {
+            Info.Escapes = true;
+            return;
+          }
+          Info.Written.set(Field);
+        } else {
+          Info.Escapes = true;
+          return;
+        }
+      }
+      continue;
+    }
+
+    auto *CI = dyn_cast<CallInst>(U);
+    if (CI && isTranslatedFunction(CI->getCalledFunction()) &&
+        CI->getNumArgOperands() == 1) {
+      Info.Callees.push_back(CI->getCalledFunction());
+      continue;
+    }
+
+    // The regset is passed to an indirect call, an external function, or
+    // the runtime.
+    Info.Escapes = true;
+    return;
+  }
+}
+
+PromotedFunction
+DCRegSetPromotion::promoteFunction(Function &F, const RegSetAccessInfo &Info) {
+  LLVMContext &Ctx = F.getContext();
+  Module &M = *F.getParent();
+  auto *RegSetTy = cast<StructType>(
+      cast<PointerType>(FuncTy->getParamType(0))->getElementType());
+
+  PromotedFunction Result;
+  BitVector InFields = Info.Read;
+  InFields |= Info.Written;
+  for (int Field = InFields.find_first(); Field != -1;
+       Field = InFields.find_next(Field))
+    Result.InFields.push_back(Field);
+  for (int Field = Info.Written.find_first(); Field != -1;
+       Field = Info.Written.find_next(Field))
+    Result.OutFields.push_back(Field);
+
+  SmallVector<Type *, 8> InTys, OutTys;
+  for (unsigned Field : Result.InFields)
+    InTys.push_back(RegSetTy->getElementType(Field));
+  for (unsigned Field : Result.OutFields)
+    OutTys.push_back(RegSetTy->getElementType(Field));
+  auto *RetTy = StructType::get(Ctx, OutTys);
+  auto *PFTy = FunctionType::get(RetTy, InTys, /*isVarArg=*/false);
+
+  // Move the body over to the promoted function.
+  Function *PF = Function::Create(PFTy, GlobalValue::InternalLinkage,
+                                  F.getName() + "_promoted");
+  M.getFunctionList().insertAfter(F.getIterator(), PF);
+  PF->getBasicBlockList().splice(PF->end(), F.getBasicBlockList());
+  PF->setSubprogram(F.getSubprogram());
+  F.setSubprogram(nullptr);
+  Result.PF = PF;
+
+  // Replace the regset with a local copy, initialized from the arguments.
+  BasicBlock &EntryBB = PF->getEntryBlock();
+  IRBuilder<> Builder(&EntryBB, EntryBB.begin());
+  AllocaInst *LocalRegSet = Builder.CreateAlloca(RegSetTy, nullptr, "regset");
+  F.arg_begin()->replaceAllUsesWith(LocalRegSet);
+  auto ArgI = PF->arg_begin();
+  for (unsigned Field : Result.InFields)
+    Builder.CreateStore(&*ArgI++,
+                        Builder.CreateStructGEP(RegSetTy, LocalRegSet, Field));
+
+  // And return the written registers.
+  SmallVector<ReturnInst *, 4> Returns;
+  for (BasicBlock &BB : *PF)
+    if (auto *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+      Returns.push_back(RI);
+  for (ReturnInst *RI : Returns) {
+    Builder.SetInsertPoint(RI);
+    Value *RetVal = UndefValue::get(RetTy);
+    for (unsigned i = 0, e = Result.OutFields.size(); i != e; ++i)
+      RetVal = Builder.CreateInsertValue(
+          RetVal,
+          Builder.CreateLoad(Builder.CreateStructGEP(RegSetTy, LocalRegSet,
+                                                     Result.OutFields[i])),
+          i);
+    Builder.CreateRet(RetVal)->setDebugLoc(RI->getDebugLoc());
+    RI->eraseFromParent();
+  }
+
+  // Finally, turn the original function into a wrapper, going through the
+  // in-memory regset.
+  Value *RegSetArg = &*F.arg_begin();
+  Builder.SetInsertPoint(BasicBlock::Create(Ctx, "entry", &F));
+  SmallVector<Value *, 8> Args;
+  for (unsigned Field : Result.InFields)
+    Args.push_back(Builder.CreateLoad(
+        Builder.CreateStructGEP(RegSetTy, RegSetArg, Field)));
+  Value *Ret = Builder.CreateCall(PF, Args);
+  for (unsigned i = 0, e = Result.OutFields.size(); i != e; ++i)
+    Builder.CreateStore(
+        Builder.CreateExtractValue(Ret, i),
+        Builder.CreateStructGEP(RegSetTy, RegSetArg, Result.OutFields[i]));
+  Builder.CreateRetVoid();
+
+  ++NumPromotedFunctions;
+  return Result;
+}
+
+void DCRegSetPromotion::rewritePromotedCalls(
+    const PromotedFunction &Caller,
+    const MapVector<Function *, PromotedFunction> &Promoted) {
+  auto *RegSetTy = cast<StructType>(
+      cast<PointerType>(FuncTy->getParamType(0))->getElementType());
+
+  SmallVector<CallInst *, 8> Calls;
+  for (Instruction &I : instructions(Caller.PF))
+    if (auto *CI = dyn_cast<CallInst>(&I))
+      if (Promoted.count(CI->getCalledFunction()))
+        Calls.push_back(CI);
+
+  for (CallInst *CI : Calls) {
+    const PromotedFunction &Callee =
+        Promoted.find(CI->getCalledFunction())->second;
+    Value *LocalRegSet = CI->getArgOperand(0);
+
+    IRBuilder<> Builder(CI);
+    SmallVector<Value *, 8> Args;
+    for (unsigned Field : Callee.InFields)
+      Args.push_back(Builder.CreateLoad(
+          Builder.CreateStructGEP(RegSetTy, LocalRegSet, Field)));
+    CallInst *NewCI = Builder.CreateCall(Callee.PF, Args);
+    NewCI->setDebugLoc(CI->getDebugLoc());
+    NewCI->setTailCall(CI->isTailCall());
+    for (unsigned i = 0, e = Callee.OutFields.size(); i != e; ++i)
+      Builder.CreateStore(
+          Builder.CreateExtractValue(NewCI, i),
+          Builder.CreateStructGEP(RegSetTy, LocalRegSet, Callee.OutFields[i]));
+    CI->eraseFromParent();
+    ++NumPromotedCalls;
+  }
+}
+
+bool DCRegSetPromotion::runOnModule(Module &M) {
+  if (!FuncTy)
+    return false;
+  const unsigned NumFields =
+      cast<StructType>(
+          cast<PointerType>(FuncTy->getParamType(0))->getElementType())
+          ->getNumElements();
+
+  // First, look at the regset accesses of each function, ...
+  MapVector<Function *, RegSetAccessInfo> Infos;
+  for (Function &F : M) {
+    if (!isTranslatedFunction(&F))
+      continue;
+    auto &Info =
+        Infos.insert(std::make_pair(&F, RegSetAccessInfo(NumFields)))
+            .first->second;
+    analyzeFunction(F, Info);
+  }
+
+  // ... then propagate them from the callees to the callers, until nothing
+  // changes.
+  bool Changed;
+  do {
+    Changed = false;
+    for (auto &FI : Infos) {
+      RegSetAccessInfo &Info = FI.second;
+      if (Info.Escapes)
+        continue;
+      for (Function *Callee : Info.Callees) {
+        const RegSetAccessInfo &CalleeInfo = Infos.find(Callee)->second;
+        if (CalleeInfo.Escapes) {
+          Info.Escapes = true;
+          Changed = true;
+          break;
+        }
+        BitVector OldRead = Info.Read, OldWritten = Info.Written;
+        Info.Read |= CalleeInfo.Read;
+        Info.Written |= CalleeInfo.Written;
+        Changed |= OldRead != Info.Read || OldWritten != Info.Written;
+      }
+    }
+  } while (Changed);
+
+  MapVector<Function *, PromotedFunction> Promoted;
+  for (auto &FI : Infos) {
+    if (FI.second.Escapes)
+      continue;
+    DEBUG(dbgs() << "Promoting the regset of " << FI.first->getName() << ": "
+                 << FI.second.Read.count() << " fields read, "
+                 << FI.second.Written.count() << " written\n");
+    Promoted.insert(
+        std::make_pair(FI.first, promoteFunction(*FI.first, FI.second)));
+  }
+
+  for (auto &PFI : Promoted)
+    rewritePromotedCalls(PFI.second, Promoted);
+
+  return !Promoted.empty();
+}
+
+char DCRegSetPromotion::ID = 0;
+INITIALIZE_PASS(DCRegSetPromotion, "dc-regset-promotion",
+                "Promote the DC Register Set to SSA Values", false, false)
+
+ModulePass *llvm::createDCRegSetPromotionPass(FunctionType *FuncTy) {
+  return new DCRegSetPromotion(FuncTy);
+}
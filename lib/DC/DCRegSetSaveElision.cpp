@@ -0,0 +1,295 @@
+//===-- lib/DC/DCRegSetSaveElision.cpp - Elide call regset saves -*- C++ -*-=//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCRegSetSaveElision.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/DC/DCModule.h"
+#include "llvm/DC/DCRegisterSetDesc.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <iterator>
+#include <map>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "dc-regset-save-elision"
+
+STATISTIC(NumElidedSaves, "Number of register saves elided around calls");
+STATISTIC(NumElidedRestores, "Number of register restores elided after calls");
+
+namespace llvm {
+void initializeDCRegSetSaveElisionPass(PassRegistry &);
+}
+
+namespace {
+/// The regset fields a function can access, and modify, including through
+/// its callees.
+struct RegSetSummary {
+  BitVector Accessed, Modified;
+  /// Whether the function can access the regset in other ways, and should be
+  /// assumed to access and modify all of it.
+  bool Unknown = false;
+
+  explicit RegSetSummary(unsigned NumFields)
+      : Accessed(NumFields), Modified(NumFields) {}
+};
+
+class DCRegSetSaveElision : public ModulePass {
+  DCModule *DCM;
+
+  /// The summaries of the functions already processed.  This is a std::map
+  /// because we keep references to its elements while adding new ones.
+  std::map<const Function *, RegSetSummary> Summaries;
+  /// The functions being processed, to detect recursion.
+  SmallPtrSet<const Function *, 8> InProgress;
+
+  unsigned NumFields = 0;
+  RegSetSummary WrapperSummary{0}, UnknownSummary{0};
+  bool Changed = false;
+
+public:
+  static char ID;
+
+  DCRegSetSaveElision(DCModule *DCM = nullptr) : ModulePass(ID), DCM(DCM) {
+    initializeDCRegSetSaveElisionPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  bool isTranslatedFunction(const Function *F) const {
+    return F && !F->isDeclaration() && F->getFunctionType() == DCM->getFuncTy();
+  }
+
+  const RegSetSummary &getSummary(Function &F);
+  void summarizeFunction(Function &F, RegSetSummary &Summary);
+  void elideCallSaves(CallInst &CI, const RegSetSummary &CalleeSummary);
+};
+} // end anonymous namespace
+
+/// Get the index of the regset field addressed by \p Ptr, a GEP on the regset,
+/// or -1 if it isn't one.
+static int getRegSetFieldIndex(const Value *Ptr) {
+  auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+  if (!GEP || GEP->getNumIndices() < 2)
+    return -1;
+  auto *Idx0 = dyn_cast<ConstantInt>(GEP->getOperand(1));
+  auto *Idx1 = dyn_cast<ConstantInt>(GEP->getOperand(2));
+  if (!Idx0 || !Idx0->isZero() || !Idx1)
+    return -1;
+  return Idx1->getZExtValue();
+}
+
+const RegSetSummary &DCRegSetSaveElision::getSummary(Function &F) {
+  auto It = Summaries.find(&F);
+  if (It != Summaries.end())
+    return It->second;
+
+  if (DCM->isExternalWrapperFunction(&F))
+    return WrapperSummary;
+
+  // We don't know about functions outside the module, and conservatively
+  // assume that recursive calls access everything.
+  if (!isTranslatedFunction(&F) || !InProgress.insert(&F).second)
+    return UnknownSummary;
+
+  // First, elide the saves around the calls in F, using the callees'
+  // summaries.  This makes F's own summary more precise, as the registers
+  // that aren't restored from the regset after a call aren't modified.
+  SmallVector<CallInst *, 8> Calls;
+  for (User *U : F.arg_begin()->users())
+    if (auto *CI = dyn_cast<CallInst>(U))
+      if (CI->getCalledFunction())
+        Calls.push_back(CI);
+  for (CallInst *CI : Calls) {
+    const RegSetSummary &CalleeSummary = getSummary(*CI->getCalledFunction());
+    if (!CalleeSummary.Unknown)
+      elideCallSaves(*CI, CalleeSummary);
+  }
+  InProgress.erase(&F);
+
+  RegSetSummary Summary(NumFields);
+  summarizeFunction(F, Summary);
+  DEBUG(dbgs() << "Regset summary of " << F.getName() << ": ";
+        if (Summary.Unknown) dbgs() << "unknown\n";
+        else dbgs() << Summary.Accessed.count() << " fields accessed, "
+                    << Summary.Modified.count() << " modified\n");
+  return Summaries.emplace(&F, std::move(Summary)).first->second;
+}
+
+void DCRegSetSaveElision::summarizeFunction(Function &F,
+                                            RegSetSummary &Summary) {
+  Argument *RegSetArg = &*F.arg_begin();
+  BasicBlock *EntryBB = &F.getEntryBlock();
+
+  for (User *U : RegSetArg->users()) {
+    if (auto *GEP = dyn_cast<GetElementPtrInst>(U)) {
+      int Field = getRegSetFieldIndex(GEP);
+      if (Field == -1) {
+        Summary.Unknown = true;
+        return;
+      }
+      for (User *GU : GEP->users()) {
+        if (isa<LoadInst>(GU)) {
+          Summary.Accessed.set(Field);
+        } else if (auto *SI = dyn_cast<StoreInst>(GU)) {
+          if (SI->getPointerOperand() != GEP) {
+            Summary.Unknown = true;
+            return;
+          }
+          Summary.Accessed.set(Field);
+          // Storing back the value loaded in the entry block, before any
+          // call, doesn't modify the field.
+          auto *LI = dyn_cast<LoadInst>(SI->getValueOperand());
+          if (!LI || LI->getPointerOperand() != GEP ||
+              LI->getParent() != EntryBB)
+            Summary.Modified.set(Field);
+        } else {
+          Summary.Unknown = true;
+          return;
+        }
+      }
+      continue;
+    }
+
+    auto *CI = dyn_cast<CallInst>(U);
+    if (CI && CI->getCalledFunction() && CI->getNumArgOperands() == 1) {
+      const RegSetSummary &CalleeSummary =
+          getSummary(*CI->getCalledFunction());
+      if (CalleeSummary.Unknown) {
+        Summary.Unknown = true;
+        return;
+      }
+      Summary.Accessed |= CalleeSummary.Accessed;
+      Summary.Modified |= CalleeSummary.Modified;
+      continue;
+    }
+
+    // The regset is passed to an indirect call, or to the runtime.
+    Summary.Unknown = true;
+    return;
+  }
+}
+
+void DCRegSetSaveElision::elideCallSaves(CallInst &CI,
+                                         const RegSetSummary &CalleeSummary) {
+  BasicBlock *BB = CI.getParent();
+
+  // The saves are right before the call.  Without mem2reg, each is preceded
+  // by the load of the register alloca.
+  DenseMap<unsigned, StoreInst *> Saves;
+  for (auto I = CI.getIterator(), B = BB->begin(); I != B;) {
+    --I;
+    if (auto *LI = dyn_cast<LoadInst>(&*I))
+      if (isa<AllocaInst>(LI->getPointerOperand()))
+        continue;
+    auto *SI = dyn_cast<StoreInst>(&*I);
+    if (!SI || !SI->getMetadata("dc.regset.save"))
+      break;
+    int Field = getRegSetFieldIndex(SI->getPointerOperand());
+    if (Field == -1)
+      return;
+    Saves[Field] = SI;
+  }
+
+  // The restores are right after the call.  Without mem2reg, each is followed
+  // by the store to the register alloca.
+  SmallVector<std::pair<unsigned, LoadInst *>, 8> Restores;
+  for (auto I = std::next(CI.getIterator()), E = BB->end(); I != E; ++I) {
+    if (auto *SI = dyn_cast<StoreInst>(&*I))
+      if (isa<AllocaInst>(SI->getPointerOperand()))
+        continue;
+    auto *LI = dyn_cast<LoadInst>(&*I);
+    if (!LI || !LI->getMetadata("dc.regset.restore"))
+      break;
+    int Field = getRegSetFieldIndex(LI->getPointerOperand());
+    if (Field == -1)
+      return;
+    Restores.push_back(std::make_pair(Field, LI));
+  }
+
+  // The fields the callee doesn't modify still have the saved value.
+  for (auto &FieldRestore : Restores) {
+    unsigned Field = FieldRestore.first;
+    StoreInst *Save = Saves.lookup(Field);
+    if (!Save || CalleeSummary.Modified.test(Field))
+      continue;
+    LoadInst *Restore = FieldRestore.second;
+    Restore->replaceAllUsesWith(Save->getValueOperand());
+    Restore->eraseFromParent();
+    ++NumElidedRestores;
+    Changed = true;
+
+    // And if it doesn't access them at all, they don't need to be saved.
+    // Note that we only do this when the restore was elided: otherwise, it
+    // would read the stale regset value.
+    if (!CalleeSummary.Accessed.test(Field)) {
+      Save->eraseFromParent();
+      ++NumElidedSaves;
+    }
+  }
+}
+
+bool DCRegSetSaveElision::runOnModule(Module &M) {
+  if (!DCM)
+    return false;
+
+  const DCRegisterSetDesc &RSD = DCM->getTranslator().getRegSetDesc();
+  NumFields = RSD.RegSetType->getNumElements();
+  UnknownSummary = RegSetSummary(NumFields);
+  UnknownSummary.Unknown = true;
+
+  // The external wrappers access the registers defined by the ABI.
+  WrapperSummary = RegSetSummary(NumFields);
+  SmallVector<unsigned, 16> ReadRegs, WrittenRegs;
+  WrapperSummary.Unknown = !DCM->getExternalWrapperRegs(ReadRegs, WrittenRegs);
+  auto getField = [&](unsigned Reg) {
+    return RSD.RegOffsetsInSet[RSD.RegLargestSupers[Reg]];
+  };
+  for (unsigned Reg : ReadRegs) {
+    int Field = getField(Reg);
+    if (Field == -1)
+      WrapperSummary.Unknown = true;
+    else
+      WrapperSummary.Accessed.set(Field);
+  }
+  for (unsigned Reg : WrittenRegs) {
+    int Field = getField(Reg);
+    if (Field == -1) {
+      WrapperSummary.Unknown = true;
+    } else {
+      WrapperSummary.Accessed.set(Field);
+      WrapperSummary.Modified.set(Field);
+    }
+  }
+
+  Changed = false;
+  for (Function &F : M)
+    getSummary(F);
+  Summaries.clear();
+  return Changed;
+}
+
+char DCRegSetSaveElision::ID = 0;
+INITIALIZE_PASS(DCRegSetSaveElision, "dc-regset-save-elision",
+                "Elide DC Register Set Saves Around Calls", false, false)
+
+ModulePass *llvm::createDCRegSetSaveElisionPass(DCModule &DCM) {
+  return new DCRegSetSaveElision(&DCM);
+}
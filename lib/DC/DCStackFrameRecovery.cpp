@@ -0,0 +1,372 @@
+//===-- lib/DC/DCStackFrameRecovery.cpp - Recover stack frames --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCStackFrameRecovery.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdint>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "dc-stack-frame-recovery"
+
+STATISTIC(NumRecoveredFrames, "Number of functions with a recovered frame");
+STATISTIC(NumFrameAccesses, "Number of stack accesses rewritten to the frame");
+
+namespace llvm {
+void initializeDCStackFrameRecoveryPass(PassRegistry &);
+}
+
+/// The offset of the derived values whose offset from the incoming stack
+/// pointer isn't a known constant.
+static const int64_t Overdefined = INT64_MIN;
+
+namespace {
+class DCStackFrameRecovery : public FunctionPass {
+  unsigned SPField;
+
+  /// The values derived from the incoming stack pointer.
+  SetVector<Value *> Derived;
+  /// The constant offset of each derived value from the incoming stack
+  /// pointer, or Overdefined.  Values not in the map aren't computed yet.
+  DenseMap<Value *, int64_t> Offsets;
+
+  /// The loads and stores through derived pointers.
+  SmallVector<Instruction *, 16> Accesses;
+  /// The stores of derived values.
+  SmallVector<StoreInst *, 4> EscapingStores;
+
+public:
+  static char ID;
+
+  DCStackFrameRecovery(unsigned SPField = -1U)
+      : FunctionPass(ID), SPField(SPField) {
+    initializeDCStackFrameRecoveryPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool findDerivedValues(Value *SPInit);
+  void computeOffsets(Value *SPInit);
+  int64_t getOffset(Value *V) const;
+  Optional<int64_t> evaluate(Instruction *I) const;
+};
+} // end anonymous namespace
+
+/// Get the index of the regset field addressed by \p Ptr, a GEP on the regset,
+/// or -1 if it isn't one.
+static int getRegSetFieldIndex(const Value *Ptr) {
+  auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+  if (!GEP || GEP->getNumIndices() < 2)
+    return -1;
+  auto *Idx0 = dyn_cast<ConstantInt>(GEP->getOperand(1));
+  auto *Idx1 = dyn_cast<ConstantInt>(GEP->getOperand(2));
+  if (!Idx0 || !Idx0->isZero() || !Idx1)
+    return -1;
+  return Idx1->getZExtValue();
+}
+
+static bool isOverflowIntrinsic(const Value *V) {
+  auto *II = dyn_cast<IntrinsicInst>(V);
+  if (!II)
+    return false;
+  switch (II->getIntrinsicID()) {
+  case Intrinsic::sadd_with_overflow:
+  case Intrinsic::uadd_with_overflow:
+  case Intrinsic::ssub_with_overflow:
+  case Intrinsic::usub_with_overflow:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Find all the values that can carry (part of) the address of the stack, and
+/// the memory accesses through them.  Returns false if the address escapes in
+/// a way we can't track.
+bool DCStackFrameRecovery::findDerivedValues(Value *SPInit) {
+  Derived.insert(SPInit);
+  for (unsigned i = 0; i != Derived.size(); ++i) {
+    Value *V = Derived[i];
+    for (User *U : V->users()) {
+      auto *I = cast<Instruction>(U);
+      switch (I->getOpcode()) {
+      default:
+        if (isa<BinaryOperator>(I))
+          Derived.insert(I);
+        else
+          return false;
+        break;
+      case Instruction::PHI:
+      case Instruction::Select:
+      case Instruction::ZExt:
+      case Instruction::SExt:
+      case Instruction::IntToPtr:
+      case Instruction::PtrToInt:
+      case Instruction::BitCast:
+        Derived.insert(I);
+        break;
+      // Comparisons and narrow truncations (the status flags) only expose
+      // a few bits of the address.
+      case Instruction::ICmp:
+        break;
+      case Instruction::Trunc:
+        if (I->getType()->getIntegerBitWidth() >= 32)
+          Derived.insert(I);
+        break;
+      case Instruction::Call:
+        // The overflow bits of the stack pointer arithmetic are in the status
+        // flags.
+        if (!isOverflowIntrinsic(I))
+          return false;
+        for (User *CU : I->users()) {
+          auto *EVI = dyn_cast<ExtractValueInst>(CU);
+          if (!EVI)
+            return false;
+          if (EVI->getIndices()[0] == 0)
+            Derived.insert(EVI);
+        }
+        break;
+      case Instruction::Load:
+        Accesses.push_back(I);
+        break;
+      case Instruction::Store: {
+        auto *SI = cast<StoreInst>(I);
+        if (SI->getValueOperand() == V)
+          EscapingStores.push_back(SI);
+        else
+          Accesses.push_back(SI);
+        break;
+      }
+      }
+    }
+  }
+  return true;
+}
+
+int64_t DCStackFrameRecovery::getOffset(Value *V) const {
+  auto It = Offsets.find(V);
+  return It == Offsets.end() ? Overdefined : It->second;
+}
+
+/// Compute the offset of \p I from its operands, or None if they aren't
+/// computed yet.
+Optional<int64_t> DCStackFrameRecovery::evaluate(Instruction *I) const {
+  auto getOperandOffset = [&](Value *Op) -> Optional<int64_t> {
+    if (!Derived.count(Op))
+      return Overdefined;
+    auto It = Offsets.find(Op);
+    if (It == Offsets.end())
+      return None;
+    return It->second;
+  };
+  auto addConstant = [&](Value *Op, Value *C,
+                         bool IsSub) -> Optional<int64_t> {
+    Optional<int64_t> Off = getOperandOffset(Op);
+    if (!Off || *Off == Overdefined)
+      return Off;
+    auto *CI = dyn_cast<ConstantInt>(C);
+    if (!CI)
+      return Overdefined;
+    return IsSub ? *Off - CI->getSExtValue() : *Off + CI->getSExtValue();
+  };
+
+  switch (I->getOpcode()) {
+  default:
+    return Overdefined;
+  case Instruction::Add: {
+    Value *Op0 = I->getOperand(0), *Op1 = I->getOperand(1);
+    if (!Derived.count(Op0))
+      std::swap(Op0, Op1);
+    return addConstant(Op0, Op1, /*IsSub=*/false);
+  }
+  case Instruction::Sub:
+    return addConstant(I->getOperand(0), I->getOperand(1), /*IsSub=*/true);
+  case Instruction::ExtractValue: {
+    // The result of an overflow intrinsic.
+    auto *II = cast<IntrinsicInst>(
+        cast<ExtractValueInst>(I)->getAggregateOperand());
+    Value *Op0 = II->getArgOperand(0), *Op1 = II->getArgOperand(1);
+    Intrinsic::ID IID = II->getIntrinsicID();
+    if (IID == Intrinsic::ssub_with_overflow ||
+        IID == Intrinsic::usub_with_overflow)
+      return addConstant(Op0, Op1, /*IsSub=*/true);
+    if (!Derived.count(Op0))
+      std::swap(Op0, Op1);
+    return addConstant(Op0, Op1, /*IsSub=*/false);
+  }
+  case Instruction::IntToPtr:
+  case Instruction::PtrToInt:
+  case Instruction::BitCast:
+    return getOperandOffset(I->getOperand(0));
+  case Instruction::PHI:
+  case Instruction::Select: {
+    // Optimistically ignore the operands not computed yet, e.g., around loops.
+    Optional<int64_t> Merged;
+    auto *PN = dyn_cast<PHINode>(I);
+    unsigned NumOps = PN ? PN->getNumIncomingValues() : 2;
+    for (unsigned i = 0; i != NumOps; ++i) {
+      Value *Op = PN ? PN->getIncomingValue(i) : I->getOperand(i + 1);
+      Optional<int64_t> Off = getOperandOffset(Op);
+      if (!Off)
+        continue;
+      Merged = (!Merged || *Merged == *Off) ? *Off : Overdefined;
+    }
+    return Merged;
+  }
+  }
+}
+
+void DCStackFrameRecovery::computeOffsets(Value *SPInit) {
+  Offsets[SPInit] = 0;
+  bool Changed;
+  do {
+    Changed = false;
+    for (Value *V : Derived) {
+      if (V == SPInit)
+        continue;
+      Optional<int64_t> Off = evaluate(cast<Instruction>(V));
+      if (!Off)
+        continue;
+      auto It = Offsets.find(V);
+      if (It == Offsets.end()) {
+        Offsets[V] = *Off;
+        Changed = true;
+      } else if (It->second != *Off && It->second != Overdefined) {
+        // Offsets can only go from constant to overdefined.
+        It->second = Overdefined;
+        Changed = true;
+      }
+    }
+  } while (Changed);
+}
+
+bool DCStackFrameRecovery::runOnFunction(Function &F) {
+  if (SPField == -1U || F.arg_size() != 1 ||
+      !F.arg_begin()->getType()->isPointerTy())
+    return false;
+
+  Derived.clear();
+  Offsets.clear();
+  Accesses.clear();
+  EscapingStores.clear();
+
+  // Look for the incoming stack pointer.  If the regset is passed to a call,
+  // the callee can access our frame through the stack pointer.
+  Argument *RegSetArg = &*F.arg_begin();
+  LoadInst *SPInit = nullptr;
+  for (User *U : RegSetArg->users()) {
+    if (isa<CallInst>(U))
+      return false;
+    if (getRegSetFieldIndex(U) != (int)SPField)
+      continue;
+    for (User *GU : U->users()) {
+      auto *LI = dyn_cast<LoadInst>(GU);
+      if (!LI)
+        continue;
+      if (SPInit || LI->getParent() != &F.getEntryBlock())
+        return false;
+      SPInit = LI;
+    }
+  }
+  if (!SPInit)
+    return false;
+
+  if (!findDerivedValues(SPInit))
+    return false;
+  computeOffsets(SPInit);
+
+  // The stack pointer can only be returned to the caller, and only if it's
+  // above our frame.
+  for (StoreInst *SI : EscapingStores) {
+    if (getRegSetFieldIndex(SI->getPointerOperand()) != (int)SPField ||
+        cast<Instruction>(SI->getPointerOperand())->getOperand(0) !=
+            RegSetArg)
+      return false;
+    int64_t Off = getOffset(SI->getValueOperand());
+    if (Off == Overdefined || Off < 0)
+      return false;
+  }
+
+  // The accesses below the incoming stack pointer are to our frame.  Those
+  // above it are to the caller's, which we keep as-is.
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  SmallVector<std::pair<Instruction *, int64_t>, 16> FrameAccesses;
+  int64_t FrameSize = 0;
+  for (Instruction *I : Accesses) {
+    auto *LI = dyn_cast<LoadInst>(I);
+    Value *Ptr = LI ? LI->getPointerOperand()
+                    : cast<StoreInst>(I)->getPointerOperand();
+    Type *Ty = LI ? LI->getType()
+                  : cast<StoreInst>(I)->getValueOperand()->getType();
+    int64_t Off = getOffset(Ptr);
+    if (Off == Overdefined)
+      return false;
+    int64_t Size = DL.getTypeStoreSize(Ty);
+    if (Off >= 0)
+      continue;
+    if (Off + Size > 0)
+      return false;
+    FrameAccesses.push_back(std::make_pair(I, Off));
+    FrameSize = std::max(FrameSize, -Off);
+  }
+  if (FrameAccesses.empty())
+    return false;
+
+  DEBUG(dbgs() << "Recovered a " << FrameSize << " bytes stack frame in "
+               << F.getName() << ", with " << FrameAccesses.size()
+               << " accesses\n");
+
+  BasicBlock &EntryBB = F.getEntryBlock();
+  IRBuilder<> Builder(&EntryBB, EntryBB.begin());
+  AllocaInst *Frame = Builder.CreateAlloca(
+      ArrayType::get(Builder.getInt8Ty(), FrameSize), nullptr, "stack_frame");
+  Frame->setAlignment(16);
+
+  for (auto &FA : FrameAccesses) {
+    Instruction *I = FA.first;
+    const unsigned PtrOpIdx = isa<LoadInst>(I) ? 0 : 1;
+    Value *OldPtr = I->getOperand(PtrOpIdx);
+    Builder.SetInsertPoint(I);
+    Value *NewPtr = Builder.CreateConstInBoundsGEP2_64(
+        Frame, 0, FrameSize + FA.second);
+    I->setOperand(PtrOpIdx,
+                  Builder.CreateBitCast(NewPtr, OldPtr->getType()));
+    if (auto *OldPtrI = dyn_cast<Instruction>(OldPtr))
+      if (OldPtrI->use_empty())
+        OldPtrI->eraseFromParent();
+    ++NumFrameAccesses;
+  }
+  ++NumRecoveredFrames;
+  return true;
+}
+
+char DCStackFrameRecovery::ID = 0;
+INITIALIZE_PASS(DCStackFrameRecovery, "dc-stack-frame-recovery",
+                "Recover the Stack Frame of DC Translated Functions", false,
+                false)
+
+FunctionPass *llvm::createDCStackFrameRecoveryPass(unsigned SPField) {
+  return new DCStackFrameRecovery(SPField);
+}
@@ -0,0 +1,230 @@
+//===-- lib/DC/DCTranslationCache.cpp - DC Translation Cache ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCTranslationCache.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/DC/DCPassPipeline.h"
+#include "llvm/DC/DCTranslator.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MC/MCAnalysis/MCFunction.h"
+#include "llvm/MC/MCExpr.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "dc-translation-cache"
+
+DCTranslationCache::DCTranslationCache(StringRef CacheDir)
+    : CacheDir(CacheDir) {
+  if (auto EC = sys::fs::create_directories(CacheDir)) {
+    DEBUG(dbgs() << "Failed to create translation cache directory: "
+                 << EC.message() << "\n");
+    (void)EC;
+  }
+}
+
+std::string DCTranslationCache::getEntryPath(StringRef Key) const {
+  SmallString<128> Path(CacheDir);
+  sys::path::append(Path, Key + ".bc");
+  return Path.str();
+}
+
+namespace {
+class KeyHasher {
+  MD5 Hash;
+
+public:
+  void add(uint64_t V) {
+    uint8_t Bytes[8];
+    support::endian::write64le(Bytes, V);
+    Hash.update(Bytes);
+  }
+
+  void add(StringRef S) {
+    add(S.size());
+    Hash.update(S);
+  }
+
+  void add(const MCInst &Inst) {
+    add(Inst.getOpcode());
+    add(Inst.getNumOperands());
+    for (const MCOperand &Op : Inst) {
+      if (Op.isReg()) {
+        add(0);
+        add(Op.getReg());
+      } else if (Op.isImm()) {
+        add(1);
+        add(Op.getImm());
+      } else if (Op.isFPImm()) {
+        add(2);
+        add(DoubleToBits(Op.getFPImm()));
+      } else if (Op.isExpr()) {
+        std::string ExprStr;
+        raw_string_ostream OS(ExprStr);
+        Op.getExpr()->print(OS, /*MAI=*/nullptr);
+        add(3);
+        add(OS.str());
+      } else if (Op.isInst()) {
+        add(4);
+        add(*Op.getInst());
+      } else {
+        add(5);
+      }
+    }
+  }
+
+  std::string getDigest() {
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    return Result.digest().str();
+  }
+};
+} // end anonymous namespace
+
+std::string DCTranslationCache::computeKey(const DCTranslator &DCT,
+                                           const MCFunction &MCFN) const {
+  KeyHasher H;
+  H.add(Version);
+  H.add(LLVM_VERSION_STRING);
+  H.add(DCT.getSubtargetInfo().getTargetTriple().str());
+  H.add(DCT.getOptLevel());
+  H.add(DCT.getPassPipeline().getFunctionPipeline());
+  H.add(DCT.getSemanticsVersion());
+  H.add(DCT.recoversStackFrames());
+  H.add(DCT.assumesEntryStackAlignment());
+  H.add(DCT.getExternalSignaturesDigest());
+
+  H.add(MCFN.getStartAddr());
+  // The blocks are translated in this order, so it matters.
+  for (const MCBasicBlock *BB : MCFN) {
+    H.add(BB->getStartAddr());
+    H.add(BB->getSizeInBytes());
+    H.add(std::distance(BB->succ_begin(), BB->succ_end()));
+    for (auto SI = BB->succ_begin(), SE = BB->succ_end(); SI != SE; ++SI)
+      H.add((*SI)->getStartAddr());
+    for (const MCDecodedInst &I : *BB) {
+      H.add(I.Address);
+      H.add(I.Size);
+      H.add(I.Inst);
+    }
+  }
+
+  H.add(std::distance(MCFN.callee_begin(), MCFN.callee_end()));
+  for (uint64_t Callee : MCFN.callees())
+    H.add(Callee);
+  H.add(std::distance(MCFN.tailcallee_begin(), MCFN.tailcallee_end()));
+  for (uint64_t TailCallee : MCFN.tailcallees())
+    H.add(TailCallee);
+
+  return H.getDigest();
+}
+
+std::unique_ptr<Module> DCTranslationCache::lookup(StringRef Key,
+                                                   LLVMContext &Ctx) const {
+  auto BufferOrErr = MemoryBuffer::getFile(getEntryPath(Key));
+  if (!BufferOrErr)
+    return nullptr;
+
+  auto ModuleOrErr = parseBitcodeFile((*BufferOrErr)->getMemBufferRef(), Ctx);
+  if (!ModuleOrErr) {
+    DEBUG(dbgs() << "Invalid translation cache entry " << Key << "\n");
+    consumeError(ModuleOrErr.takeError());
+    return nullptr;
+  }
+  return std::move(*ModuleOrErr);
+}
+
+/// Collect in \p Defs the definitions referenced by \p V, that need to be
+/// stored along with the translated function of type \p FnTy.
+static void collectReferencedDefinitions(
+    const Value *V, FunctionType *FnTy,
+    SmallPtrSetImpl<const GlobalValue *> &Defs,
+    SmallPtrSetImpl<const Constant *> &VisitedConstants) {
+  if (auto *GV = dyn_cast<GlobalValue>(V)) {
+    if (GV->isDeclaration() || !Defs.insert(GV).second)
+      return;
+    if (auto *F = dyn_cast<Function>(GV)) {
+      // Other translated functions are only referenced by name.
+      if (F->getFunctionType() == FnTy) {
+        Defs.erase(F);
+        return;
+      }
+      for (const Instruction &I : instructions(F))
+        for (const Value *Op : I.operands())
+          collectReferencedDefinitions(Op, FnTy, Defs, VisitedConstants);
+    } else if (auto *GVar = dyn_cast<GlobalVariable>(GV)) {
+      collectReferencedDefinitions(GVar->getInitializer(), FnTy, Defs,
+                                   VisitedConstants);
+    }
+    return;
+  }
+  if (auto *C = dyn_cast<Constant>(V)) {
+    if (!VisitedConstants.insert(C).second)
+      return;
+    for (const Value *Op : C->operands())
+      collectReferencedDefinitions(Op, FnTy, Defs, VisitedConstants);
+  }
+}
+
+void DCTranslationCache::insert(StringRef Key, const Function &F) const {
+  SmallPtrSet<const GlobalValue *, 8> Defs;
+  SmallPtrSet<const Constant *, 8> VisitedConstants;
+  Defs.insert(&F);
+  for (const Instruction &I : instructions(F))
+    for (const Value *Op : I.operands())
+      collectReferencedDefinitions(Op, F.getFunctionType(), Defs,
+                                   VisitedConstants);
+
+  ValueToValueMapTy VMap;
+  std::unique_ptr<Module> M = CloneModule(
+      F.getParent(), VMap,
+      [&](const GlobalValue *GV) { return Defs.count(GV) != 0; });
+
+  for (const GlobalValue *GV : Defs) {
+    auto *NewGV = cast<GlobalValue>(VMap[GV]);
+    if (GV != &F && !NewGV->hasLocalLinkage())
+      NewGV->setLinkage(GlobalValue::LinkOnceODRLinkage);
+  }
+
+  // Write the entry atomically, so that concurrent translators (in the same
+  // or in different processes) never see a partial entry.
+  const std::string EntryPath = getEntryPath(Key);
+  SmallString<128> TempPath;
+  int FD;
+  if (auto EC =
+          sys::fs::createUniqueFile(EntryPath + ".tmp-%%%%%%", FD, TempPath)) {
+    DEBUG(dbgs() << "Failed to create translation cache entry: "
+                 << EC.message() << "\n");
+    (void)EC;
+    return;
+  }
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    WriteBitcodeToFile(M.get(), OS);
+  }
+  if (sys::fs::rename(TempPath, EntryPath))
+    sys::fs::remove(TempPath);
+}
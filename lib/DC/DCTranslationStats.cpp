@@ -0,0 +1,229 @@
+//===-- lib/DC/DCTranslationStats.cpp - DC Translation Statistics -*- C++ -*-=//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DC/DCTranslationStats.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/MC/MCAnalysis/MCFunction.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/YAMLParser.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+
+static cl::opt<std::string> StatsFilename(
+    "dc-stats",
+    cl::desc("Write the time spent in each translation stage, and counts for "
+             "the translated functions, as JSON to the given file"),
+    cl::value_desc("filename"));
+
+static cl::opt<unsigned> StatsNumSlowest(
+    "dc-stats-slowest",
+    cl::desc("Number of slowest functions to list in the -dc-stats output"),
+    cl::init(10));
+
+DCTranslationStats::StageRegion::StageRegion(DCTranslationStats *Stats,
+                                             Stage S)
+    : Stats(Stats), S(S) {
+  if (Stats)
+    StartTime = TimeRecord::getCurrentTime(/*Start=*/true);
+}
+
+double DCTranslationStats::StageRegion::stop() {
+  if (!Stats)
+    return 0;
+  TimeRecord Time = TimeRecord::getCurrentTime(/*Start=*/false);
+  Time -= StartTime;
+  Stats->addStageTime(S, Time);
+  Stats = nullptr;
+  return Time.getWallTime();
+}
+
+DCTranslationStats::DCTranslationStats(StringRef OutputFilename,
+                                       unsigned NumSlowest)
+    : OutputFilename(OutputFilename), NumSlowest(NumSlowest) {}
+
+std::unique_ptr<DCTranslationStats> DCTranslationStats::createFromCommandLine() {
+  if (StatsFilename.empty())
+    return nullptr;
+  return std::unique_ptr<DCTranslationStats>(
+      new DCTranslationStats(StatsFilename, StatsNumSlowest));
+}
+
+StringRef DCTranslationStats::getStageName(Stage S) {
+  switch (S) {
+  case ObjectLoad:   return "object-load";
+  case Symbolizer:   return "symbolizer";
+  case CFGRecovery:  return "cfg-recovery";
+  case Translation:  return "translation";
+  case Optimization: return "optimization";
+  case CodeGen:      return "codegen";
+  case Printing:     return "printing";
+  case NumStages:    break;
+  }
+  llvm_unreachable("Invalid translation stage!");
+}
+
+void DCTranslationStats::addStageTime(Stage S, const TimeRecord &Time) {
+  std::lock_guard<std::mutex> Lock(StatsMutex);
+  StageTimes[S] += Time;
+}
+
+void DCTranslationStats::addFunction(const MCFunction &MCFN, const Function &F,
+                                     bool Cached, double TranslationTime,
+                                     double OptimizationTime) {
+  FunctionStats FS;
+  FS.StartAddr = MCFN.getStartAddr();
+  FS.Name = F.getName();
+  FS.NumInsts = 0;
+  for (const MCBasicBlock *MCBB : MCFN)
+    FS.NumInsts += MCBB->size();
+  FS.NumBlocks = MCFN.size();
+  FS.NumIRInsts = FS.NumAllocas = FS.NumCalls = 0;
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB) {
+      ++FS.NumIRInsts;
+      if (isa<AllocaInst>(I))
+        ++FS.NumAllocas;
+      else if ((isa<CallInst>(I) || isa<InvokeInst>(I)) &&
+               !isa<IntrinsicInst>(I))
+        ++FS.NumCalls;
+    }
+  }
+  FS.Cached = Cached;
+  FS.TranslationTime = TranslationTime;
+  FS.OptimizationTime = OptimizationTime;
+
+  std::lock_guard<std::mutex> Lock(StatsMutex);
+  Functions.push_back(std::move(FS));
+}
+
+void DCTranslationStats::setCounter(StringRef Name, uint64_t Value) {
+  std::lock_guard<std::mutex> Lock(StatsMutex);
+  for (auto &C : Counters) {
+    if (C.first == Name) {
+      C.second = Value;
+      return;
+    }
+  }
+  Counters.emplace_back(Name, Value);
+}
+
+static void printJSONTime(raw_ostream &OS, StringRef Name, double Time) {
+  OS << '"' << Name << "\": " << format("%.6f", Time);
+}
+
+static void printJSONFunction(raw_ostream &OS,
+                              const DCTranslationStats::FunctionStats &FS) {
+  OS << "{ \"name\": \"" << yaml::escape(FS.Name) << "\""
+     << ", \"address\": " << FS.StartAddr
+     << ", \"insts\": " << FS.NumInsts
+     << ", \"blocks\": " << FS.NumBlocks
+     << ", \"ir-insts\": " << FS.NumIRInsts
+     << ", \"allocas\": " << FS.NumAllocas
+     << ", \"calls\": " << FS.NumCalls
+     << ", \"cached\": " << (FS.Cached ? "true" : "false") << ", ";
+  printJSONTime(OS, "translation-time", FS.TranslationTime);
+  OS << ", ";
+  printJSONTime(OS, "optimization-time", FS.OptimizationTime);
+  OS << " }";
+}
+
+void DCTranslationStats::printJSON(raw_ostream &OS) const {
+  std::lock_guard<std::mutex> Lock(StatsMutex);
+
+  OS << "{\n";
+  OS << "  \"stages\": {\n";
+  for (unsigned S = 0; S != NumStages; ++S) {
+    const TimeRecord &Time = StageTimes[S];
+    OS << "    \"" << getStageName(Stage(S)) << "\": { ";
+    printJSONTime(OS, "wall", Time.getWallTime());
+    OS << ", ";
+    printJSONTime(OS, "user", Time.getUserTime());
+    OS << ", ";
+    printJSONTime(OS, "system", Time.getSystemTime());
+    OS << ", ";
+    printJSONTime(OS, "cpu", Time.getProcessTime());
+    OS << " }" << (S + 1 != NumStages ? "," : "") << "\n";
+  }
+  OS << "  },\n";
+
+  FunctionStats Total = FunctionStats();
+  unsigned NumCached = 0;
+  for (const FunctionStats &FS : Functions) {
+    Total.NumInsts += FS.NumInsts;
+    Total.NumBlocks += FS.NumBlocks;
+    Total.NumIRInsts += FS.NumIRInsts;
+    Total.NumAllocas += FS.NumAllocas;
+    Total.NumCalls += FS.NumCalls;
+    NumCached += FS.Cached;
+  }
+  OS << "  \"functions\": { \"count\": " << Functions.size()
+     << ", \"cached\": " << NumCached
+     << ", \"insts\": " << Total.NumInsts
+     << ", \"blocks\": " << Total.NumBlocks
+     << ", \"ir-insts\": " << Total.NumIRInsts
+     << ", \"allocas\": " << Total.NumAllocas
+     << ", \"calls\": " << Total.NumCalls << " },\n";
+
+  // The slowest functions first; break ties by address, so that the output
+  // is stable when the times aren't precise enough to tell them apart.
+  std::vector<const FunctionStats *> Slowest;
+  for (const FunctionStats &FS : Functions)
+    Slowest.push_back(&FS);
+  std::sort(Slowest.begin(), Slowest.end(),
+            [](const FunctionStats *L, const FunctionStats *R) {
+              double LTime = L->TranslationTime + L->OptimizationTime;
+              double RTime = R->TranslationTime + R->OptimizationTime;
+              if (LTime != RTime)
+                return LTime > RTime;
+              return L->StartAddr < R->StartAddr;
+            });
+  if (Slowest.size() > NumSlowest)
+    Slowest.resize(NumSlowest);
+
+  OS << "  \"slowest-functions\": [";
+  for (unsigned i = 0, e = Slowest.size(); i != e; ++i) {
+    OS << (i ? ",\n" : "\n") << "    ";
+    printJSONFunction(OS, *Slowest[i]);
+  }
+  OS << (Slowest.empty() ? "]" : "\n  ]");
+
+  if (!Counters.empty()) {
+    OS << ",\n  \"counters\": {";
+    for (unsigned i = 0, e = Counters.size(); i != e; ++i)
+      OS << (i ? ", " : " ") << '"' << yaml::escape(Counters[i].first)
+         << "\": " << Counters[i].second;
+    OS << " }";
+  }
+
+  // Also include the counters of the translation libraries, if -stats was
+  // passed (and they were built in).
+  if (AreStatisticsEnabled()) {
+    OS << ",\n  \"statistics\": ";
+    PrintStatisticsJSON(OS);
+  } else {
+    OS << "\n";
+  }
+  OS << "}\n";
+}
+
+std::error_code DCTranslationStats::writeJSON() const {
+  std::error_code EC;
+  raw_fd_ostream OS(OutputFilename, EC, sys::fs::F_Text);
+  if (EC)
+    return EC;
+  printJSON(OS);
+  return std::error_code();
+}
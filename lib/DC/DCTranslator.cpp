@@ -9,18 +9,32 @@
 
 #include "llvm/DC/DCTranslator.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/DC/DCAlignmentInference.h"
 #include "llvm/DC/DCBasicBlock.h"
 #include "llvm/DC/DCFunction.h"
 #include "llvm/DC/DCInstruction.h"
 #include "llvm/DC/DCModule.h"
+#include "llvm/DC/DCPassPipeline.h"
+#include "llvm/DC/DCRegSetPromotion.h"
+#include "llvm/DC/DCRegSetSaveElision.h"
+#include "llvm/DC/DCStackFrameRecovery.h"
+#include "llvm/DC/DCTranslationCache.h"
+#include "llvm/DC/DCTranslationStats.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/MC/MCAnalysis/MCFunction.h"
 #include "llvm/MC/MCAnalysis/MCObjectDisassembler.h"
 #include "llvm/MC/MCAnalysis/MCObjectSymbolizer.h"
 #include "llvm/MC/MCInstrInfo.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -31,6 +45,55 @@ using namespace llvm;
 
 #define DEBUG_TYPE "dctranslator"
 
+STATISTIC(NumCacheHits, "Number of functions loaded from the translation cache");
+STATISTIC(NumCacheMisses, "Number of functions added to the translation cache");
+
+static cl::opt<std::string> TranslationCacheDir(
+    "dc-translation-cache-dir",
+    cl::desc("The path to a directory where translated functions are cached "
+             "across runs, or an empty string to disable the cache."));
+
+namespace llvm {
+extern cl::opt<bool> EnableRegSetSaveElision;
+}
+
+static cl::opt<bool> EnableRegSetPromotion(
+    "dc-promote-regset",
+    cl::desc("Pass the registers as values between the translated functions "
+             "of a module, instead of through the in-memory register set, "
+             "when possible."));
+
+static cl::opt<bool> EnableStackFrameRecovery(
+    "dc-recover-stack-frame",
+    cl::desc("Rewrite the stack accesses of translated functions whose frame "
+             "doesn't escape to use local allocas, when optimizing."));
+
+static cl::opt<bool> AssumeABIStackAlignment(
+    "dc-assume-abi-stack-alignment",
+    cl::desc("Assume the stack pointer is aligned as required by the ABI when "
+             "entering translated functions.  This doesn't hold for process "
+             "entry points, or hand-written assembly."));
+
+static cl::opt<std::string> ExternalSignaturesFile(
+    "dc-external-signatures",
+    cl::desc("The path to an IR file declaring the prototypes of external "
+             "functions, used to call them directly from the translated code "
+             "instead of through a register set trampoline."));
+
+static cl::opt<std::string> FunctionPasses(
+    "dc-passes",
+    cl::desc("The pass pipeline run on each translated function, in the "
+             "textual format of the new pass manager (the default depends on "
+             "the optimization level)"),
+    cl::value_desc("pipeline"));
+
+static cl::opt<std::string> ModulePasses(
+    "dc-module-passes",
+    cl::desc("The pass pipeline run on each translation module when it is "
+             "finalized, in the textual format of the new pass manager (the "
+             "default depends on the optimization level)"),
+    cl::value_desc("pipeline"));
+
 DCTranslator::DCTranslator(LLVMContext &Ctx, const DataLayout &DL,
                            unsigned OptLevel, const MCInstrInfo &MII,
                            const MCRegisterInfo &MRI,
@@ -38,11 +101,65 @@ DCTranslator::DCTranslator(LLVMContext &Ctx, const DataLayout &DL,
                            const DCRegisterSetDesc RegSetDesc)
     : Ctx(Ctx), DL(DL), MII(MII), MRI(MRI), STI(STI), MIP(MIP),
       RegSetDesc(RegSetDesc), ModuleSet(), CurrentModule(nullptr), CurrentFPM(),
-      OptLevel(OptLevel) {}
+      OptLevel(OptLevel), Stats(nullptr) {
+  if (!TranslationCacheDir.empty())
+    Cache.reset(new DCTranslationCache(TranslationCacheDir));
+
+  // An empty pipeline given on the command line disables the optimizations.
+  StringRef FunctionPipeline =
+      FunctionPasses.getNumOccurrences()
+          ? StringRef(FunctionPasses)
+          : DCPassPipeline::getDefaultFunctionPipeline(OptLevel);
+  StringRef ModulePipeline =
+      ModulePasses.getNumOccurrences()
+          ? StringRef(ModulePasses)
+          : DCPassPipeline::getDefaultModulePipeline(OptLevel,
+                                                     EnableRegSetPromotion);
+  Pipeline.reset(new DCPassPipeline(FunctionPipeline, ModulePipeline));
+
+  if (!ExternalSignaturesFile.empty()) {
+    auto BufferOrErr = MemoryBuffer::getFile(ExternalSignaturesFile);
+    if (!BufferOrErr)
+      report_fatal_error(Twine("Unable to load external function signatures "
+                               "from '") +
+                         ExternalSignaturesFile +
+                         "': " + BufferOrErr.getError().message());
+
+    // The signatures change the translation, so they're part of the
+    // translation cache keys.
+    MD5 Hash;
+    Hash.update((*BufferOrErr)->getBuffer());
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    ExternalSignaturesDigest = Result.digest().str();
+
+    SMDiagnostic Err;
+    ExternalSignatures = parseIR((*BufferOrErr)->getMemBufferRef(), Err, Ctx);
+    if (!ExternalSignatures)
+      report_fatal_error(Twine("Unable to load external function signatures "
+                               "from '") +
+                         ExternalSignaturesFile + "': " + Err.getMessage());
+  }
+}
 
 Module *DCTranslator::finalizeTranslationModule() {
   Module *OldModule = CurrentModule;
   assert(OldModule);
+
+  {
+    DCTranslationStats::StageRegion TR(Stats,
+                                       DCTranslationStats::Optimization);
+    if (EnableRegSetSaveElision || EnableRegSetPromotion) {
+      legacy::PassManager PM;
+      if (EnableRegSetSaveElision)
+        PM.add(createDCRegSetSaveElisionPass(*DCM));
+      if (EnableRegSetPromotion)
+        PM.add(createDCRegSetPromotionPass(DCM->getFuncTy()));
+      PM.run(*OldModule);
+    }
+    Pipeline->runOnModule(*OldModule);
+  }
+
   DEBUG(OldModule->dump());
 
   initializeTranslationModule();
@@ -57,17 +174,53 @@ void DCTranslator::initializeTranslationModule() {
 
   DCM = createDCModule(*CurrentModule);
 
+  // These need to run before the -dc-passes pipeline: stack frame recovery
+  // only handles the register set once it's promoted, and the rest of the
+  // pipeline benefits from the recovered frames and alignments.
   CurrentFPM.reset(new legacy::FunctionPassManager(CurrentModule));
   if (OptLevel >= 1)
     CurrentFPM->add(createPromoteMemoryToRegisterPass());
-  if (OptLevel >= 2)
-    CurrentFPM->add(createDeadCodeEliminationPass());
-  if (OptLevel >= 3)
-    CurrentFPM->add(createInstructionCombiningPass());
+  if (recoversStackFrames()) {
+    const unsigned SP = getStackPointerRegister();
+    CurrentFPM->add(createDCStackFrameRecoveryPass(
+        RegSetDesc.RegOffsetsInSet[RegSetDesc.RegLargestSupers[SP]]));
+    CurrentFPM->add(createSROAPass());
+  }
+  if (OptLevel >= 1)
+    CurrentFPM->add(createDCAlignmentInferencePass());
 }
 
 DCTranslator::~DCTranslator() {}
 
+bool DCTranslator::recoversStackFrames() const {
+  // The recovery needs the registers to be promoted first.
+  return EnableStackFrameRecovery && OptLevel >= 1 && getStackPointerRegister();
+}
+
+FunctionType *DCTranslator::getExternalFunctionType(StringRef Name) const {
+  if (!ExternalSignatures)
+    return nullptr;
+  Function *F = ExternalSignatures->getFunction(Name);
+  return F ? F->getFunctionType() : nullptr;
+}
+
+bool DCTranslator::assumesEntryStackAlignment() const {
+  unsigned Offset;
+  return AssumeABIStackAlignment && getEntryStackAlignment(Offset);
+}
+
+void DCTranslator::linkInModule(std::unique_ptr<Module> M) {
+  if (Linker::linkModules(*CurrentModule, std::move(M)))
+    report_fatal_error("Unable to link module into the translation module!");
+
+  for (Function &F : *CurrentModule)
+    if (F.hasLinkOnceODRLinkage())
+      F.setLinkage(GlobalValue::ExternalLinkage);
+  for (GlobalVariable &GV : CurrentModule->globals())
+    if (GV.hasLinkOnceODRLinkage())
+      GV.setLinkage(GlobalValue::ExternalLinkage);
+}
+
 Function *DCTranslator::getFunction(StringRef Name) {
   for (auto &M : ModuleSet)
     if (Function *F = M->getFunction(Name))
@@ -106,7 +259,37 @@ static bool BBBeginAddrLess(const MCBasicBlock *LHS, const MCBasicBlock *RHS) {
 }
 
 Function *DCTranslator::translateFunction(const MCFunction &MCFN) {
+  DCTranslationStats::StageRegion TranslationTR(
+      Stats, DCTranslationStats::Translation);
   Function *F = DCM->getOrCreateFunction(MCFN.getStartAddr());
+
+  // Look for the function in the translation cache.  The cache doesn't know
+  // about the debug info source file, so don't use it if we emit debug info.
+  std::string CacheKey;
+  if (Cache && F->isDeclaration() && !DCM->getDebugStream()) {
+    CacheKey = Cache->computeKey(*this, MCFN);
+    if (std::unique_ptr<Module> CachedM = Cache->lookup(CacheKey, Ctx)) {
+      DEBUG(dbgs() << "Found function at " << utohexstr(MCFN.getStartAddr())
+                   << " in the translation cache\n");
+      ++NumCacheHits;
+
+      // Linking replaces the declaration; put the definition in its place.
+      auto NextIt = std::next(F->getIterator());
+      std::string NextName =
+          NextIt == CurrentModule->end() ? "" : NextIt->getName().str();
+      linkInModule(std::move(CachedM));
+      F = DCM->getOrCreateFunction(MCFN.getStartAddr());
+      if (Function *NextF = CurrentModule->getFunction(NextName)) {
+        auto &FnList = CurrentModule->getFunctionList();
+        FnList.splice(NextF->getIterator(), FnList, F->getIterator());
+      }
+      if (Stats)
+        Stats->addFunction(MCFN, *F, /*Cached=*/true, TranslationTR.stop(),
+                           /*OptimizationTime=*/0);
+      return F;
+    }
+  }
+
   if (F->isDeclaration()) {
     AddrPrettyStackTraceEntry X(MCFN.getStartAddr(), "Function");
     std::unique_ptr<DCFunction> DCF = createDCFunction(*DCM, MCFN);
@@ -150,13 +333,35 @@ Function *DCTranslator::translateFunction(const MCFunction &MCFN) {
       DCF->createExternalTailCallBB(TailCallTarget);
   }
 
+  const double TranslationTime = TranslationTR.stop();
+
   // Now that the DCFunction is out of scope and complete, we can optimize it.
+  double OptimizationTime;
   {
+    DCTranslationStats::StageRegion OptimizationTR(
+        Stats, DCTranslationStats::Optimization);
     // ValueToValueMapTy VMap;
     // Function *OrigFn = CloneFunction(Fn, VMap, false);
     // OrigFn->setName(Fn->getName() + "_orig");
     // CurrentModule->getFunctionList().push_back(OrigFn);
     CurrentFPM->run(*F);
+    Pipeline->runOnFunction(*F);
+    OptimizationTime = OptimizationTR.stop();
+  }
+
+  if (Stats)
+    Stats->addFunction(MCFN, *F, /*Cached=*/false, TranslationTime,
+                       OptimizationTime);
+
+  if (!CacheKey.empty()) {
+    ++NumCacheMisses;
+    Cache->insert(CacheKey, *F);
+
+    // The placeholder blocks can leave an unused llvm.trap declaration behind,
+    // which a warm run wouldn't link in: drop it to print the same module.
+    if (Function *TrapF = CurrentModule->getFunction("llvm.trap"))
+      if (TrapF->use_empty())
+        TrapF->eraseFromParent();
   }
   return F;
 }
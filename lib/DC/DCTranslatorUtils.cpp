@@ -11,23 +11,38 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/DC/DCTranslatorUtils.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/DC/DCModule.h"
+#include "llvm/DC/DCTranslationStats.h"
 #include "llvm/DC/DCTranslator.h"
 #include "llvm/MC/MCAnalysis/MCFunction.h"
 #include "llvm/MC/MCAnalysis/MCModule.h"
 #include "llvm/MC/MCAnalysis/MCObjectDisassembler.h"
 #include "llvm/MC/MCAnalysis/MCObjectSymbolizer.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 
 using namespace llvm;
 
 #define DEBUG_TYPE "dctranslator-utils"
 
-void llvm::translateRecursivelyAt(ArrayRef<uint64_t> EntryAddrs,
-                                  DCTranslator &DCT, MCModule &MCM,
-                                  MCObjectDisassembler *MCOD,
-                                  MCObjectSymbolizer *MOS) {
+/// Walk the functions reachable from \p EntryAddrs, creating the external
+/// wrappers in \p DCT, and calling \p TranslateFn on the MCFunction of every
+/// function that still needs to be translated.
+/// If \p Recursive is false, only visit the functions at \p EntryAddrs.
+static void
+visitFunctionsRecursivelyAt(ArrayRef<uint64_t> EntryAddrs, DCTranslator &DCT,
+                            MCModule &MCM, MCObjectDisassembler *MCOD,
+                            MCObjectSymbolizer *MOS,
+                            function_ref<void(const MCFunction &)> TranslateFn,
+                            bool Recursive = true) {
   DCModule &DCM = *DCT.getDCModule();
   SmallSetVector<uint64_t, 16> WorkList;
 
@@ -71,12 +86,124 @@ void llvm::translateRecursivelyAt(ArrayRef<uint64_t> EntryAddrs,
         report_fatal_error(("Unable to translate unknown function at " +
                             utohexstr(Addr) + " without a disassembler!")
                                .c_str());
+      DCTranslationStats::StageRegion TR(DCT.getStats(),
+                                         DCTranslationStats::CFGRecovery);
       MCFN = MCOD->createFunction(&MCM, Addr);
     }
     assert(MCFN && "Wasn't able to translate function!");
 
-    DCT.translateFunction(*MCFN);
+    TranslateFn(*MCFN);
+    if (!Recursive)
+      continue;
     for (uint64_t CallTarget : MCFN->callees())
       WorkList.insert(CallTarget);
   }
 }
+
+void llvm::translateAt(ArrayRef<uint64_t> EntryAddrs, DCTranslator &DCT,
+                       MCModule &MCM, MCObjectDisassembler *MCOD,
+                       MCObjectSymbolizer *MOS) {
+  visitFunctionsRecursivelyAt(
+      EntryAddrs, DCT, MCM, MCOD, MOS,
+      [&](const MCFunction &MCFN) { DCT.translateFunction(MCFN); },
+      /*Recursive=*/false);
+}
+
+void llvm::translateRecursivelyAt(ArrayRef<uint64_t> EntryAddrs,
+                                  DCTranslator &DCT, MCModule &MCM,
+                                  MCObjectDisassembler *MCOD,
+                                  MCObjectSymbolizer *MOS) {
+  visitFunctionsRecursivelyAt(
+      EntryAddrs, DCT, MCM, MCOD, MOS,
+      [&](const MCFunction &MCFN) { DCT.translateFunction(MCFN); });
+}
+
+void llvm::translateRecursivelyAtInParallel(
+    ArrayRef<uint64_t> EntryAddrs, DCTranslator &DCT, MCModule &MCM,
+    const DCTranslatorFactory &CreateWorkerTranslator, unsigned NumThreads,
+    MCObjectDisassembler *MCOD, MCObjectSymbolizer *MOS) {
+  // First, discover all the functions to translate.  This needs to be done
+  // serially, as it can grow the MCModule.
+  std::vector<const MCFunction *> MCFNs;
+  visitFunctionsRecursivelyAt(
+      EntryAddrs, DCT, MCM, MCOD, MOS,
+      [&](const MCFunction &MCFN) { MCFNs.push_back(&MCFN); });
+
+  if (MCFNs.empty())
+    return;
+
+  const unsigned NumWorkers =
+      std::min<size_t>(std::max(NumThreads, 1U), MCFNs.size());
+  DEBUG(dbgs() << "Translating " << MCFNs.size() << " functions using "
+               << NumWorkers << " threads\n");
+
+  // Each worker translates every NumWorkers-th function in its own context,
+  // and hands back its finalized module as bitcode.
+  std::vector<SmallString<0>> WorkerBitcode(NumWorkers);
+  {
+    ThreadPool Pool(NumWorkers);
+    for (unsigned W = 0; W != NumWorkers; ++W) {
+      Pool.async([&, W]() {
+        LLVMContext WorkerCtx;
+        std::unique_ptr<DCTranslator> WorkerDCT =
+            CreateWorkerTranslator(WorkerCtx);
+        if (!WorkerDCT)
+          report_fatal_error("Unable to create a worker DC translator!");
+        WorkerDCT->setStats(DCT.getStats());
+
+        SmallVector<Function *, 8> Translated;
+        for (size_t i = W, e = MCFNs.size(); i < e; i += NumWorkers)
+          Translated.push_back(WorkerDCT->translateFunction(*MCFNs[i]));
+        Module *WorkerM = WorkerDCT->finalizeTranslationModule();
+
+        // Support functions (like the regset diff helper) can be defined by
+        // several workers: let the linker pick one of the definitions.
+        for (Function &F : *WorkerM)
+          if (!F.isDeclaration() && !is_contained(Translated, &F))
+            F.setLinkage(GlobalValue::LinkOnceODRLinkage);
+
+        raw_svector_ostream OS(WorkerBitcode[W]);
+        WriteBitcodeToFile(WorkerM, OS);
+      });
+    }
+    Pool.wait();
+  }
+
+  // Now link the worker modules back, in order.
+  Module &M = *DCT.getDCModule()->getModule();
+
+  // Linking definitions over existing declarations re-creates the functions,
+  // so remember the original order by name.
+  StringMap<unsigned> OrigOrder;
+  for (Function &F : M)
+    OrigOrder.insert(std::make_pair(F.getName(), OrigOrder.size()));
+
+  for (unsigned W = 0; W != NumWorkers; ++W) {
+    auto WorkerMOrErr = parseBitcodeFile(
+        MemoryBufferRef(WorkerBitcode[W], M.getModuleIdentifier()),
+        M.getContext());
+    if (!WorkerMOrErr)
+      report_fatal_error(WorkerMOrErr.takeError());
+    DCT.linkInModule(std::move(*WorkerMOrErr));
+  }
+
+  // Restore a deterministic function order: functions that were already in
+  // the module (including all translated functions, declared when discovered)
+  // keep their original order, and new ones are sorted by name.
+  std::vector<Function *> Fns;
+  for (Function &F : M)
+    Fns.push_back(&F);
+  std::stable_sort(Fns.begin(), Fns.end(), [&](Function *L, Function *R) {
+    auto LI = OrigOrder.find(L->getName()), RI = OrigOrder.find(R->getName());
+    bool LKnown = LI != OrigOrder.end(), RKnown = RI != OrigOrder.end();
+    if (LKnown != RKnown)
+      return LKnown;
+    if (LKnown)
+      return LI->second < RI->second;
+    return L->getName() < R->getName();
+  });
+  for (Function *F : Fns) {
+    M.getFunctionList().remove(F);
+    M.getFunctionList().push_back(F);
+  }
+}
@@ -8,20 +8,189 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/DC/LowerDCTranslateAt.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 using namespace llvm;
 
+/// Guard the (already lowered) translate.at callback call \p CI with an inline
+/// probe of the direct-mapped \p Cache, so that the callback is only called
+/// on a cache miss.  This turns:
+///   %fn = call i8* @callback(i8* %target)
+/// into:
+///   %key = load atomic acquire (gep %cache, index(%target)).GuestAddr
+///   br (icmp eq %key, %target), %hit, %miss
+/// hit:
+///   %cached = load atomic acquire (gep %cache, index(%target)).HostAddr
+///   %key.again = load atomic monotonic (gep %cache, index(%target)).GuestAddr
+///   br (icmp eq %key.again, %target), %tail, %miss
+/// miss:
+///   %translated = call i8* @callback(i8* %target)
+/// tail:
+///   %fn = phi i8* [ %cached, %hit ], [ %translated, %miss ]
+/// The cache is filled by the runtime while it's probed: the key is reloaded
+/// after the host address, in case the entry was replaced in between (see
+/// DYNTranslationTable).
+static void insertCacheProbe(CallInst *CI, Value *Cache, unsigned CacheBits) {
+  IRBuilder<> Builder(CI);
+  Type *I64Ty = Builder.getInt64Ty();
+  StructType *EntryTy = StructType::get(I64Ty, I64Ty);
+
+  Value *GuestAddr = Builder.CreatePtrToInt(CI->getArgOperand(0), I64Ty);
+  // Keep this in sync with getDCTranslateAtCacheIndex.
+  Value *Idx = Builder.CreateAnd(
+      Builder.CreateXor(GuestAddr, Builder.CreateLShr(GuestAddr, CacheBits)),
+      (1ULL << CacheBits) - 1);
+  Value *Entry = Builder.CreateInBoundsGEP(
+      EntryTy, Builder.CreateBitCast(Cache, EntryTy->getPointerTo()), Idx);
+  auto LoadField = [&](unsigned Field, AtomicOrdering Ordering) {
+    LoadInst *LI =
+        Builder.CreateLoad(Builder.CreateStructGEP(EntryTy, Entry, Field));
+    LI->setAlignment(8);
+    LI->setAtomic(Ordering);
+    return LI;
+  };
+  Value *Key = LoadField(0, AtomicOrdering::Acquire);
+  Value *IsHit = Builder.CreateICmpEQ(Key, GuestAddr);
+
+  TerminatorInst *HitTerm, *MissTerm;
+  SplitBlockAndInsertIfThenElse(
+      IsHit, CI, &HitTerm, &MissTerm,
+      MDBuilder(CI->getContext()).createBranchWeights(64, 1));
+
+  Builder.SetInsertPoint(HitTerm);
+  Value *HostAddr = Builder.CreateIntToPtr(
+      LoadField(1, AtomicOrdering::Acquire), CI->getType());
+  Value *IsStillHit = Builder.CreateICmpEQ(
+      LoadField(0, AtomicOrdering::Monotonic), GuestAddr);
+  BasicBlock *HitBB = HitTerm->getParent();
+  BasicBlock *TailBB = CI->getParent();
+  Builder.CreateCondBr(IsStillHit, TailBB, MissTerm->getParent());
+  HitTerm->eraseFromParent();
+
+  CI->moveBefore(MissTerm);
+
+  PHINode *PN = PHINode::Create(CI->getType(), 2, "", &TailBB->front());
+  CI->replaceAllUsesWith(PN);
+  PN->addIncoming(HostAddr, HitBB);
+  PN->addIncoming(CI, MissTerm->getParent());
+}
+
+/// Guard the (already lowered) translate.at callback call \p CI with a probe of
+/// the first \p NumEntries entries of a new DCInlineCache, private to the call
+/// site.  This turns:
+///   %fn = call i8* @callback(i8* %target)
+/// into:
+///   %key0 = load %ic.Entries[0].GuestAddr
+///   %host0 = load %ic.Entries[0].HostAddr
+///   br (icmp eq %key0, %target), %tail, %probe1
+/// probe1:
+///   ...
+/// miss:
+///   br (icmp uge (load %ic.Misses), MegamorphicMisses), %megamorphic, %update
+/// update:
+///   %updated = call i8* @miss_callback(i8* %target, i8* %ic)
+/// megamorphic:
+///   %translated = call i8* @callback(i8* %target)
+/// tail:
+///   %fn = phi i8* [ %host0, %entry ], ..., [ %updated, %update ],
+///                 [ %translated, %megamorphic ]
+static void insertInlineCacheProbe(CallInst *CI, Value *MissCallback,
+                                   unsigned NumEntries) {
+  Module &M = *CI->getModule();
+  LLVMContext &Ctx = M.getContext();
+  Function *F = CI->getFunction();
+  IRBuilder<> Builder(CI);
+  Type *I64Ty = Builder.getInt64Ty();
+  StructType *EntryTy = StructType::get(I64Ty, I64Ty);
+  ArrayType *EntriesTy = ArrayType::get(EntryTy, DCInlineCache::MaxEntries);
+  StructType *ICTy = StructType::get(I64Ty, EntriesTy);
+
+  Constant *EmptyEntry = ConstantStruct::get(
+      EntryTy, {ConstantInt::get(I64Ty, DCTranslateAtCacheEntry::EmptyKey),
+                ConstantInt::get(I64Ty, 0)});
+  SmallVector<Constant *, DCInlineCache::MaxEntries> EmptyEntries(
+      DCInlineCache::MaxEntries, EmptyEntry);
+  auto *IC = new GlobalVariable(
+      M, ICTy, /*isConstant=*/false, GlobalValue::PrivateLinkage,
+      ConstantStruct::get(ICTy, {ConstantInt::get(I64Ty, 0),
+                                 ConstantArray::get(EntriesTy, EmptyEntries)}),
+      "dc.inline_cache");
+
+  Value *Target = CI->getArgOperand(0);
+  Value *GuestAddr = Builder.CreatePtrToInt(Target, I64Ty);
+
+  // Move the call to its own block, which is only reached for megamorphic
+  // call sites, and merge all the paths in the tail.
+  BasicBlock *HeadBB = CI->getParent();
+  BasicBlock *TailBB =
+      HeadBB->splitBasicBlock(std::next(CI->getIterator()), "ic.tail");
+  BasicBlock *MegamorphicBB =
+      HeadBB->splitBasicBlock(CI->getIterator(), "ic.megamorphic");
+  HeadBB->getTerminator()->eraseFromParent();
+
+  PHINode *PN =
+      PHINode::Create(CI->getType(), NumEntries + 2, "", &TailBB->front());
+  CI->replaceAllUsesWith(PN);
+  PN->addIncoming(CI, MegamorphicBB);
+
+  auto *MissBB = BasicBlock::Create(Ctx, "ic.miss", F, MegamorphicBB);
+  auto *UpdateBB = BasicBlock::Create(Ctx, "ic.update", F, MegamorphicBB);
+  MDNode *LikelyHit = MDBuilder(Ctx).createBranchWeights(64, 1);
+
+  Builder.SetInsertPoint(HeadBB);
+  for (unsigned i = 0; i != NumEntries; ++i) {
+    auto getEntryField = [&](unsigned Field) {
+      return Builder.CreateInBoundsGEP(
+          ICTy, IC, {Builder.getInt32(0), Builder.getInt32(1),
+                     Builder.getInt32(i), Builder.getInt32(Field)});
+    };
+    Value *Key = Builder.CreateLoad(getEntryField(0));
+    // The host address is only used if the key matches.
+    Value *HostAddr = Builder.CreateIntToPtr(
+        Builder.CreateLoad(getEntryField(1)), CI->getType());
+    BasicBlock *NextBB =
+        i + 1 == NumEntries ? MissBB
+                            : BasicBlock::Create(Ctx, "ic.probe", F, MissBB);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(Key, GuestAddr), TailBB, NextBB,
+                         LikelyHit);
+    PN->addIncoming(HostAddr, Builder.GetInsertBlock());
+    Builder.SetInsertPoint(NextBB);
+  }
+
+  Value *Misses = Builder.CreateLoad(Builder.CreateStructGEP(ICTy, IC, 0));
+  Builder.CreateCondBr(
+      Builder.CreateICmpUGE(Misses, ConstantInt::get(
+                                        I64Ty, DCInlineCache::MegamorphicMisses)),
+      MegamorphicBB, UpdateBB);
+
+  Builder.SetInsertPoint(UpdateBB);
+  Value *Updated = Builder.CreateCall(
+      MissCallback, {Target, Builder.CreateBitCast(IC, Builder.getInt8PtrTy())});
+  Builder.CreateBr(TailBB);
+  PN->addIncoming(Updated, UpdateBB);
+}
+
 /// Lower calls to the @llvm.dc.translate.at intrinsic to calls to an arbitrary
 /// callback function, with the same signature, responsible for providing a
 /// translating IR function pointer from a raw (non-translated) indirect call
 /// target pointer.
-static bool lowerDCTranslateAt(Module &M, Value *DynTranslateAtCallback) {
+/// If \p Cache is non-null, the callback is only called when the inline probe
+/// of \p Cache misses.
+static bool lowerDCTranslateAt(Module &M, Value *DynTranslateAtCallback,
+                               Value *Cache, unsigned CacheBits,
+                               Value *InlineCacheMissCallback,
+                               unsigned InlineCacheSize) {
   bool Changed = false;
 
   if (!DynTranslateAtCallback)
@@ -33,6 +202,18 @@ static bool lowerDCTranslateAt(Module &M, Value *DynTranslateAtCallback) {
   if (DynTranslateAtCallback->getType() != TranslateAtInt->getType())
     report_fatal_error("Invalid translate.at callback type");
 
+  if (!InlineCacheMissCallback)
+    InlineCacheSize = 0;
+  if (InlineCacheSize > DCInlineCache::MaxEntries)
+    report_fatal_error("Invalid translate.at inline cache size");
+  if (InlineCacheSize) {
+    auto *I8PtrTy = Type::getInt8PtrTy(M.getContext());
+    auto *MissCallbackTy =
+        FunctionType::get(I8PtrTy, {I8PtrTy, I8PtrTy}, /*isVarArg=*/false);
+    if (InlineCacheMissCallback->getType() != MissCallbackTy->getPointerTo())
+      report_fatal_error("Invalid translate.at inline cache callback type");
+  }
+
   for (auto UI = TranslateAtInt->user_begin(), UE = TranslateAtInt->user_end();
        UI != UE; ) {
     auto *CI = dyn_cast<CallInst>(*UI);
@@ -48,6 +229,12 @@ static bool lowerDCTranslateAt(Module &M, Value *DynTranslateAtCallback) {
       continue;
 
     CI->setCalledFunction(DynTranslateAtCallback);
+    // Constant targets (of redirected direct calls) are monomorphic, and hit
+    // in the shared cache anyway.
+    if (InlineCacheSize && !isa<Constant>(CI->getArgOperand(0)))
+      insertInlineCacheProbe(CI, InlineCacheMissCallback, InlineCacheSize);
+    if (Cache)
+      insertCacheProbe(CI, Cache, CacheBits);
     Changed = true;
   }
 
@@ -62,16 +249,27 @@ namespace {
 /// \brief Legacy pass for lowering dc.translate.at intrinsics out of the IR.
 class LowerDCTranslateAt : public ModulePass {
   Value *DynTranslateAtCallback;
+  Value *Cache;
+  unsigned CacheBits;
+  Value *InlineCacheMissCallback;
+  unsigned InlineCacheSize;
 public:
   static char ID;
 
-  LowerDCTranslateAt(Value *DynTranslateAtCallback = nullptr)
-      : ModulePass(ID), DynTranslateAtCallback(DynTranslateAtCallback) {
+  LowerDCTranslateAt(Value *DynTranslateAtCallback = nullptr,
+                     Value *Cache = nullptr, unsigned CacheBits = 0,
+                     Value *InlineCacheMissCallback = nullptr,
+                     unsigned InlineCacheSize = 0)
+      : ModulePass(ID), DynTranslateAtCallback(DynTranslateAtCallback),
+        Cache(Cache), CacheBits(CacheBits),
+        InlineCacheMissCallback(InlineCacheMissCallback),
+        InlineCacheSize(InlineCacheSize) {
     initializeLowerDCTranslateAtPass(*PassRegistry::getPassRegistry());
   }
 
   bool runOnModule(Module &M) override {
-    return lowerDCTranslateAt(M, DynTranslateAtCallback);
+    return lowerDCTranslateAt(M, DynTranslateAtCallback, Cache, CacheBits,
+                              InlineCacheMissCallback, InlineCacheSize);
   }
 };
 }
@@ -80,6 +278,10 @@ char LowerDCTranslateAt::ID = 0;
 INITIALIZE_PASS(LowerDCTranslateAt, "lower-dc-translateat",
                 "Lower 'dc.translate.at' Intrinsics", false, false)
 
-Pass *llvm::createLowerDCTranslateAtPass(Value *DynTranslateAtCallback) {
-  return new LowerDCTranslateAt(DynTranslateAtCallback);
+Pass *llvm::createLowerDCTranslateAtPass(Value *DynTranslateAtCallback,
+                                         Value *Cache, unsigned CacheBits,
+                                         Value *InlineCacheMissCallback,
+                                         unsigned InlineCacheSize) {
+  return new LowerDCTranslateAt(DynTranslateAtCallback, Cache, CacheBits,
+                                InlineCacheMissCallback, InlineCacheSize);
 }
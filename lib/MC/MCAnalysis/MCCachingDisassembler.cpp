@@ -11,122 +11,141 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 using namespace llvm;
 
 #define DEBUG_TYPE "mccachingdisasm"
 
-STATISTIC(NumTranslatedInsts, "Number of instructions translated");
-STATISTIC(NumUniquedInsts   , "Number of instructions uniqued");
+STATISTIC(NumCacheHits,   "Number of instructions found in the cache");
+STATISTIC(NumCacheMisses, "Number of instructions decoded");
+STATISTIC(NumEvictedInsts, "Number of instructions evicted from the cache");
 
-MCCachingDisassembler::~MCCachingDisassembler() {}
+const unsigned MCCachingDisassembler::MaxKeyBytes;
+const unsigned MCCachingDisassembler::DefaultMaxEntries;
+
+MCCachingDisassembler::MCCachingDisassembler(const MCDisassembler &Disassembler,
+                                             const MCSubtargetInfo &STI,
+                                             unsigned MaxEntries)
+    : MCDisassembler(STI, Disassembler.getContext()), Impl(Disassembler),
+      MaxEntries(std::max(MaxEntries, 1U)), ClockHand(0), CachedSizes(0) {
+  CachedInsts.reserve(this->MaxEntries);
+}
+
+MCCachingDisassembler::~MCCachingDisassembler() {
+  DEBUG(dbgs() << "Instruction cache: " << CachedInsts.size() << " entries, "
+               << NumCacheHits << " hits, " << NumCacheMisses << " misses, "
+               << NumEvictedInsts << " evictions\n");
+}
+
+/// Extend the FNV-1a hash \p Hash of an encoding with the byte \p Byte.
+static uint64_t hashByte(uint64_t Hash, uint8_t Byte) {
+  return (Hash ^ Byte) * 0x100000001b3ULL;
+}
+
+/// Get the key of an encoding of hash \p Hash in the cache index, avoiding
+/// the DenseMap empty and tombstone keys.
+static uint64_t getIndexKey(uint64_t Hash) {
+  return std::min<uint64_t>(Hash, ~0ULL - 2);
+}
+
+static const uint64_t HashSeed = 0xcbf29ce484222325ULL;
 
 MCDisassembler::DecodeStatus MCCachingDisassembler::getInstruction(
     MCInst &Inst, uint64_t &InstSize, ArrayRef<uint8_t> Bytes, uint64_t Addr,
     raw_ostream &vStream, raw_ostream &cStream) const {
 
   if (findCachedInstruction(Inst, InstSize, Bytes)) {
-    ++NumUniquedInsts;
+    ++NumCacheHits;
     return Success;
   }
 
+  // Decode without holding the lock, so that other threads can still use the
+  // cache in the meantime.
   DecodeStatus S =
       Impl.getInstruction(Inst, InstSize, Bytes, Addr, vStream, cStream);
+  ++NumCacheMisses;
 
-  if (S == Success) {
-    ++NumTranslatedInsts;
-    addTempInstruction(Inst, Bytes.slice(InstSize));
-  }
+  if (S == Success && InstSize && InstSize <= MaxKeyBytes)
+    addCachedInstruction(Inst, Bytes.slice(0, InstSize));
 
   return S;
 }
 
 bool MCCachingDisassembler::findCachedInstruction(
     MCInst &Inst, uint64_t &InstSize, ArrayRef<uint8_t> Bytes) const {
-  ArrayRef<uint8_t> LongestBytes = Bytes.slice(LongestCachedRawBytes);
-  auto CachedIt =
-      std::lower_bound(CachedInsts.begin(), CachedInsts.end(), LongestBytes);
-  if (CachedIt != CachedInsts.end()) {
-    if (std::equal(CachedIt->Bytes.begin(), CachedIt->Bytes.end(),
-                   LongestBytes.begin())) {
-      Inst = CachedIt->Inst;
-      InstSize = CachedIt->Bytes.size();
-      return true;
-    }
+  std::lock_guard<std::mutex> Lock(CacheMutex);
+
+  // We don't know the size of the instruction yet: try all the sizes of the
+  // cached instructions, hashing the bytes incrementally.  An encoding is
+  // never a prefix of another, so at most one of them matches.
+  uint64_t Hash = HashSeed;
+  size_t MaxSize = std::min<size_t>(Bytes.size(), MaxKeyBytes);
+  for (size_t Size = 1; Size <= MaxSize; ++Size) {
+    Hash = hashByte(Hash, Bytes[Size - 1]);
+    if (!(CachedSizes & (1U << Size)))
+      continue;
+    auto It = CacheIndex.find(getIndexKey(Hash));
+    if (It == CacheIndex.end())
+      continue;
+    CachedInstEntry &Entry = CachedInsts[It->second];
+    if (Entry.Size != Size || !std::equal(Bytes.begin(), Bytes.begin() + Size,
+                                          Entry.Bytes))
+      continue;
+    Entry.Referenced = true;
+    Inst = Entry.Inst;
+    InstSize = Size;
+    return true;
   }
   return false;
 }
 
-void MCCachingDisassembler::addTempInstruction(const MCInst &Inst,
-                                               ArrayRef<uint8_t> Bytes) const {
-  TempInstKeys.push_back(TempInstKey());
-  TempInstKeys.back().Bytes = Bytes;
-  TempInstKeys.back().ValueIdx = TempInstValues.size();
-
-  TempInstValues.push_back(Inst);
-
-  if (TempInstValues.size() > 5000)
-    uniqueTempInstructions();
-}
-
-void MCCachingDisassembler::uniqueTempInstructions() const {
-
-  DEBUG(dbgs() << " Trying to unique \n");
-  DEBUG(dbgs() << " Uniqued " << NumUniquedInsts << " and translated "
-               << NumTranslatedInsts << " \n");
-
-  for (auto CachedInst : CachedInsts) {
-    TempInstKeys.push_back(TempInstKey());
-    TempInstKeys.back().Bytes = CachedInst.Bytes;
-    TempInstKeys.back().ValueIdx = TempInstValues.size();
-
-    TempInstValues.push_back(CachedInst.Inst);
-  }
-
-  std::sort(TempInstKeys.begin(), TempInstKeys.end());
-
-  struct TempInstKeyCount {
-    unsigned KeyIdx;
-    unsigned Count;
-    bool operator<(const TempInstKeyCount &RHS) const {
-      return RHS.Count < Count;
+void MCCachingDisassembler::addCachedInstruction(
+    const MCInst &Inst, ArrayRef<uint8_t> Bytes) const {
+  uint64_t Hash = HashSeed;
+  for (uint8_t Byte : Bytes)
+    Hash = hashByte(Hash, Byte);
+  Hash = getIndexKey(Hash);
+
+  std::lock_guard<std::mutex> Lock(CacheMutex);
+
+  // Another thread might have cached the same instruction in the meantime.
+  // If a different one has the same hash, replace it.
+  unsigned Idx;
+  auto It = CacheIndex.find(Hash);
+  if (It != CacheIndex.end()) {
+    Idx = It->second;
+  } else {
+    if (CachedInsts.size() < MaxEntries) {
+      Idx = CachedInsts.size();
+      CachedInsts.emplace_back();
+    } else {
+      Idx = evictCachedInstruction();
     }
-  };
-  std::vector<TempInstKeyCount> DuplicateKeys;
+    CacheIndex[Hash] = Idx;
+  }
 
-  ArrayRef<uint8_t> *LastKeyBytes = nullptr;
+  CachedInstEntry &Entry = CachedInsts[Idx];
+  Entry.Hash = Hash;
+  std::copy(Bytes.begin(), Bytes.end(), Entry.Bytes);
+  Entry.Size = Bytes.size();
+  Entry.Referenced = false;
+  Entry.Inst = Inst;
+  CachedSizes |= 1U << Bytes.size();
+}
 
-  for (size_t KI = 0, KE = TempInstKeys.size(); KI != KE; ++KI) {
-    TempInstKey& Key = TempInstKeys[KI];
-    if (!LastKeyBytes || !LastKeyBytes->equals(Key.Bytes)) {
-      DuplicateKeys.push_back(TempInstKeyCount());
-      DuplicateKeys.back().KeyIdx = KI;
+unsigned MCCachingDisassembler::evictCachedInstruction() const {
+  // Sweep the clock hand over the entries, giving a second chance to those
+  // used since its last pass, until finding one that wasn't.
+  while (true) {
+    unsigned Idx = ClockHand;
+    ClockHand = (ClockHand + 1) % CachedInsts.size();
+    CachedInstEntry &Entry = CachedInsts[Idx];
+    if (Entry.Referenced) {
+      Entry.Referenced = false;
+      continue;
     }
-    ++DuplicateKeys.back().Count;
-    LastKeyBytes = &Key.Bytes;
-  }
-
-  std::sort(DuplicateKeys.begin(), DuplicateKeys.end());
-
-  // FIXME: we should keep track of cachedinst->tempinst mapping when merging,
-  // so that we don't need to copy everything again, but only what changed
-  CachedInsts.clear();
-  CachedInsts.reserve(2000);
-  for (size_t DI = 0, DE = DuplicateKeys.size(); DI != DE && DI < 2000; ++DI) {
-    TempInstKeyCount& KeyCount = DuplicateKeys[DI];
-    TempInstKey& Key = TempInstKeys[KeyCount.KeyIdx];
-    MCInst& Value = TempInstValues[Key.ValueIdx];
-    CachedInsts.push_back(CachedInstEntry());
-    CachedInsts.back().Bytes = Key.Bytes;
-    CachedInsts.back().Inst = Value;
-    LongestCachedRawBytes = std::max(Key.Bytes.size(), LongestCachedRawBytes);
+    CacheIndex.erase(Entry.Hash);
+    ++NumEvictedInsts;
+    return Idx;
   }
-
-  // FIXME: insert them already sorted?
-  std::sort(CachedInsts.begin(), CachedInsts.end());
-  DEBUG(dbgs() << " Cached " << CachedInsts.size() <<  " \n");
-
-  TempInstKeys.clear();
-  TempInstValues.clear();
-  TempInstKeys.reserve(7000);
-  TempInstValues.reserve(7000);
 }
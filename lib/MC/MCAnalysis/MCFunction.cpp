@@ -9,7 +9,9 @@
 
 #include "llvm/MC/MCAnalysis/MCFunction.h"
 #include "llvm/MC/MCAnalysis/MCModule.h"
+#include "llvm/Support/MathExtras.h"
 #include <algorithm>
+#include <cstring>
 
 using namespace llvm;
 
@@ -24,6 +26,162 @@ MCFunction::~MCFunction() {
     delete BB;
 }
 
+// The operands are packed in 64-bit words, tagged in their low bits.
+// Registers, and immediates that fit, are stored in the tagged word.  Other
+// operands store their value in the next word.
+namespace {
+enum OperandTag : uint64_t {
+  OT_Reg,
+  OT_Imm,
+  OT_WideImm,
+  OT_FPImm,
+  OT_Expr,
+  OT_Inst,
+  OT_Invalid
+};
+const unsigned OperandTagBits = 3;
+} // end anonymous namespace
+
+static unsigned getNumOperandWords(const MCOperand &Op) {
+  if (Op.isReg() || !Op.isValid())
+    return 1;
+  if (Op.isImm() && isInt<64 - OperandTagBits>(Op.getImm()))
+    return 1;
+  return 2;
+}
+
+static uint64_t *packOperand(const MCOperand &Op, uint64_t *W) {
+  if (Op.isReg()) {
+    *W++ = (uint64_t(Op.getReg()) << OperandTagBits) | OT_Reg;
+  } else if (Op.isImm()) {
+    if (isInt<64 - OperandTagBits>(Op.getImm())) {
+      *W++ = (uint64_t(Op.getImm()) << OperandTagBits) | OT_Imm;
+    } else {
+      *W++ = OT_WideImm;
+      *W++ = uint64_t(Op.getImm());
+    }
+  } else if (Op.isFPImm()) {
+    *W++ = OT_FPImm;
+    *W++ = DoubleToBits(Op.getFPImm());
+  } else if (Op.isExpr()) {
+    *W++ = OT_Expr;
+    *W++ = reinterpret_cast<uintptr_t>(Op.getExpr());
+  } else if (Op.isInst()) {
+    *W++ = OT_Inst;
+    *W++ = reinterpret_cast<uintptr_t>(Op.getInst());
+  } else {
+    *W++ = OT_Invalid;
+  }
+  return W;
+}
+
+static const uint64_t *unpackOperand(const uint64_t *W, MCOperand &Op) {
+  const uint64_t Word = *W++;
+  switch (Word & ((1 << OperandTagBits) - 1)) {
+  case OT_Reg:
+    Op = MCOperand::createReg(Word >> OperandTagBits);
+    break;
+  case OT_Imm:
+    Op = MCOperand::createImm(int64_t(Word) >> OperandTagBits);
+    break;
+  case OT_WideImm:
+    Op = MCOperand::createImm(int64_t(*W++));
+    break;
+  case OT_FPImm:
+    Op = MCOperand::createFPImm(BitsToDouble(*W++));
+    break;
+  case OT_Expr:
+    Op = MCOperand::createExpr(reinterpret_cast<const MCExpr *>(*W++));
+    break;
+  case OT_Inst:
+    Op = MCOperand::createInst(reinterpret_cast<const MCInst *>(*W++));
+    break;
+  default:
+    Op = MCOperand();
+    break;
+  }
+  return W;
+}
+
+void MCFunction::reserveInsts(size_t NewInsts, size_t NewWords) {
+  // Grow geometrically, so that appending instructions one at a time doesn't
+  // waste too much of the arena on the previous arrays.
+  if (NumInsts + NewInsts > InstCapacity) {
+    size_t Capacity = std::max<size_t>(NumInsts + NewInsts, InstCapacity * 2);
+    assert(Capacity <= UINT32_MAX && "Too many instructions in function!");
+    PackedInst *NewArray = static_cast<PackedInst *>(
+        ParentModule->allocateInstStorage(Capacity * sizeof(PackedInst),
+                                          alignof(PackedInst)));
+    if (NumInsts)
+      std::memcpy(NewArray, Insts, NumInsts * sizeof(PackedInst));
+    Insts = NewArray;
+    InstCapacity = Capacity;
+  }
+  if (NumOperandWords + NewWords > OperandWordCapacity) {
+    size_t Capacity = std::max<size_t>(NumOperandWords + NewWords,
+                                       OperandWordCapacity * 2);
+    assert(Capacity <= UINT32_MAX && "Too many operands in function!");
+    uint64_t *NewArray = static_cast<uint64_t *>(
+        ParentModule->allocateInstStorage(Capacity * sizeof(uint64_t),
+                                          alignof(uint64_t)));
+    if (NumOperandWords)
+      std::memcpy(NewArray, OperandWords, NumOperandWords * sizeof(uint64_t));
+    OperandWords = NewArray;
+    OperandWordCapacity = Capacity;
+  }
+}
+
+void MCFunction::appendInst(const MCInst &Inst, uint64_t Address,
+                            uint64_t Size) {
+  unsigned NumWords = 0;
+  for (const MCOperand &Op : Inst)
+    NumWords += getNumOperandWords(Op);
+  reserveInsts(1, NumWords);
+
+  assert(isInt<32>(int64_t(Address - StartAddr)) &&
+         "Instruction too far from the function start!");
+  assert(Size <= UINT8_MAX && Inst.getNumOperands() <= UINT8_MAX &&
+         Inst.getOpcode() <= UINT16_MAX && "Instruction can't be packed!");
+  PackedInst &PI = Insts[NumInsts++];
+  PI.AddrOffset = int32_t(Address - StartAddr);
+  PI.Size = Size;
+  PI.NumOperands = Inst.getNumOperands();
+  PI.Opcode = Inst.getOpcode();
+  PI.FirstWord = NumOperandWords;
+
+  uint64_t *W = OperandWords + NumOperandWords;
+  for (const MCOperand &Op : Inst)
+    W = packOperand(Op, W);
+  NumOperandWords = W - OperandWords;
+}
+
+void MCFunction::setInsts(ArrayRef<MCDecodedInst> NewInsts) {
+  assert(!NumInsts && "Function already has instructions!");
+  // Allocate the exact size upfront.
+  size_t NumWords = 0;
+  for (const MCDecodedInst &DI : NewInsts)
+    for (const MCOperand &Op : DI.Inst)
+      NumWords += getNumOperandWords(Op);
+  reserveInsts(NewInsts.size(), NumWords);
+  for (const MCDecodedInst &DI : NewInsts)
+    appendInst(DI.Inst, DI.Address, DI.Size);
+}
+
+void MCFunction::unpackInst(uint32_t Idx, MCDecodedInst &DI) const {
+  assert(Idx < NumInsts && "Instruction index out of range!");
+  const PackedInst &PI = Insts[Idx];
+  DI.Address = StartAddr + PI.AddrOffset;
+  DI.Size = PI.Size;
+  DI.Inst.clear();
+  DI.Inst.setOpcode(PI.Opcode);
+  const uint64_t *W = OperandWords + PI.FirstWord;
+  for (unsigned i = 0; i != PI.NumOperands; ++i) {
+    MCOperand Op;
+    W = unpackOperand(W, Op);
+    DI.Inst.addOperand(Op);
+  }
+}
+
 MCBasicBlock *MCFunction::find(uint64_t StartAddr) {
   for (auto BB : *this)
     if (BB->getStartAddr() == StartAddr)
@@ -70,7 +228,8 @@ MCBasicBlock &MCFunction::createBlock(uint64_t BlockStartAddr) {
 // MCBasicBlock
 
 MCBasicBlock::MCBasicBlock(uint64_t StartAddr, MCFunction *Parent)
-    : StartAddr(StartAddr), SizeInBytes(0), InstCount(0),
+    : StartAddr(StartAddr), SizeInBytes(0),
+      InstBegin(Parent->NumInsts), InstEnd(InstBegin),
       NextInstAddress(StartAddr), Parent(Parent) {
 }
 
@@ -95,8 +254,10 @@ bool MCBasicBlock::isPredecessor(const MCBasicBlock *MCBB) const {
 }
 
 void MCBasicBlock::addInst(const MCInst &I, uint64_t InstSize) {
-  Insts.push_back(MCDecodedInst(I, NextInstAddress, InstSize));
+  assert(InstEnd == Parent->NumInsts &&
+         "Can only append instructions to the last block!");
+  Parent->appendInst(I, NextInstAddress, InstSize);
   NextInstAddress += InstSize;
   SizeInBytes += InstSize;
-  ++InstCount;
+  ++InstEnd;
 }
@@ -13,12 +13,22 @@
 using namespace llvm;
 
 MCFunction *MCModule::createFunction(StringRef Name, uint64_t StartAddr) {
-  std::unique_ptr<MCFunction> MCF(new MCFunction(Name, StartAddr, this));
-  FunctionsByAddr.insert(std::make_pair(StartAddr, MCF.get()));
+  return addFunction(
+      std::unique_ptr<MCFunction>(new MCFunction(Name, StartAddr, this)));
+}
+
+MCFunction *MCModule::addFunction(std::unique_ptr<MCFunction> MCF) {
+  assert(MCF->getParent() == this && "Function created for another module!");
+  FunctionsByAddr.insert(std::make_pair(MCF->getStartAddr(), MCF.get()));
   Functions.push_back(std::move(MCF));
   return Functions.back().get();
 }
 
+void *MCModule::allocateInstStorage(size_t Size, size_t Alignment) {
+  std::lock_guard<std::mutex> Lock(InstAllocatorMutex);
+  return InstAllocator.Allocate(Size, Alignment);
+}
+
 MCFunction *MCModule::findFunctionAt(uint64_t StartAddr) {
   auto FnIt = FunctionsByAddr.find(StartAddr);
   if (FnIt == FunctionsByAddr.end())
@@ -9,48 +9,87 @@
 
 #include "llvm/MC/MCAnalysis/MCObjectDisassembler.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/BinaryFormat/ELF.h"
 #include "llvm/BinaryFormat/MachO.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/MC/MCAnalysis/MCFunction.h"
 #include "llvm/MC/MCAnalysis/MCModule.h"
 #include "llvm/MC/MCAnalysis/MCObjectSymbolizer.h"
 #include "llvm/MC/MCDisassembler/MCDisassembler.h"
 #include "llvm/MC/MCInstrAnalysis.h"
+#include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/MachO.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <map>
+#ifdef LLVM_ON_UNIX
+#include <sys/mman.h>
+#endif
 
 using namespace llvm;
 using namespace object;
 
 #define DEBUG_TYPE "mccfg"
 
+STATISTIC(NumReleasedBytes, "Number of disassembled bytes released");
+
 MCObjectDisassembler::MCObjectDisassembler(const ObjectFile &Obj,
                                            const MCDisassembler &Dis,
                                            const MCInstrAnalysis &MIA,
                                            MCObjectSymbolizer *MOS)
     : Obj(Obj), Dis(Dis), MIA(MIA), MOS(MOS) {}
 
+/// Find the region containing \p Addr in \p Regions, sorted by address.
+template <typename RegionTy>
+static const RegionTy *findRegionContaining(const std::vector<RegionTy> &Regions,
+                                            uint64_t Addr) {
+  auto Region = std::lower_bound(Regions.begin(), Regions.end(), Addr,
+                                 [](const RegionTy &L, uint64_t Addr) {
+                                   return L.Addr + L.Bytes.size() <= Addr;
+                                 });
+  if (Region != Regions.end())
+    if (Region->Addr <= Addr)
+      return &*Region;
+  return nullptr;
+}
+
 const MCObjectDisassembler::MemoryRegion &
 MCObjectDisassembler::getRegionFor(uint64_t Addr) {
-  auto Region =
-      std::lower_bound(SectionRegions.begin(), SectionRegions.end(), Addr,
-                       [](const MemoryRegion &L, uint64_t Addr) {
-                         return L.Addr + L.Bytes.size() <= Addr;
-                       });
-  if (Region != SectionRegions.end())
-    if (Region->Addr <= Addr)
-      return *Region;
+  if (const MemoryRegion *Region = findRegionContaining(SectionRegions, Addr))
+    return *Region;
   return FallbackRegion;
 }
 
+/// Return true if \p Section is never written to, so that its contents in
+/// \p Obj are also its contents at runtime.
+static bool isReadOnlySection(const ObjectFile &Obj,
+                              const SectionRef &Section) {
+  if (Section.isText())
+    return true;
+  if (Section.isBSS() || Section.isVirtual())
+    return false;
+  if (isa<ELFObjectFileBase>(&Obj))
+    return !(ELFSectionRef(Section).getFlags() & ELF::SHF_WRITE);
+  if (auto *MOOF = dyn_cast<MachOObjectFile>(&Obj))
+    return MOOF->getSectionFinalSegmentName(Section.getRawDataRefImpl()) ==
+           "__TEXT";
+  return false;
+}
+
 MCModule *MCObjectDisassembler::buildEmptyModule() {
   return new MCModule;
 }
@@ -69,21 +108,25 @@ MCModule *MCObjectDisassembler::buildModule() {
         continue;
       if (MOS)
         StartAddr = MOS->getEffectiveLoadAddr(StartAddr);
-      if (!isText)
+      bool isReadOnly = isReadOnlySection(Obj, Section);
+      if (!isText && !isReadOnly)
         continue;
 
       StringRef Contents;
       if (Section.getContents(Contents))
         continue;
-      SectionRegions.emplace_back(
-          StartAddr,
-          ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(Contents.data()),
-                            Contents.size()));
+      ArrayRef<uint8_t> Bytes(
+          reinterpret_cast<const uint8_t *>(Contents.data()), Contents.size());
+      if (isText)
+        SectionRegions.emplace_back(StartAddr, Bytes);
+      if (isReadOnly)
+        ReadOnlyRegions.emplace_back(StartAddr, Bytes);
     }
-    std::sort(SectionRegions.begin(), SectionRegions.end(),
-              [](const MemoryRegion &L, const MemoryRegion &R) {
-                return L.Addr < R.Addr;
-              });
+    auto AddrLess = [](const MemoryRegion &L, const MemoryRegion &R) {
+      return L.Addr < R.Addr;
+    };
+    std::sort(SectionRegions.begin(), SectionRegions.end(), AddrLess);
+    std::sort(ReadOnlyRegions.begin(), ReadOnlyRegions.end(), AddrLess);
   }
 
   buildCFG(*Module);
@@ -115,10 +158,15 @@ namespace {
     uint64_t BeginAddr;
     uint64_t SizeInBytes;
     MCBasicBlock *BB;
-    std::vector<MCDecodedInst> Insts;
+    /// The range of the block's instructions in the function-wide list of
+    /// decoded instructions.  A block is always disassembled in one go, so
+    /// its instructions are contiguous, and splitting it splits the range.
+    size_t InstBegin, InstEnd;
     MCObjectDisassembler::AddressSetTy SuccAddrs;
 
-    BBInfo() : BeginAddr(0), SizeInBytes(0), BB(nullptr) {}
+    BBInfo()
+        : BeginAddr(0), SizeInBytes(0), BB(nullptr), InstBegin(0),
+          InstEnd(0) {}
   };
 }
 
@@ -127,6 +175,104 @@ static void RemoveDupsFromAddressVector(MCObjectDisassembler::AddressSetTy &V) {
   V.erase(std::unique(V.begin(), V.end()), V.end());
 }
 
+/// The maximum number of instructions to look at, before an indirect branch,
+/// when looking for the jump table it uses.
+static const unsigned MaxJumpTableLookback = 16;
+
+/// Gather the last instructions of the block \p BBI, and of the blocks falling
+/// through to it, up to \p MaxInsts, in execution order, and their addresses,
+/// followed by the end address of \p BBI.
+static void
+gatherPrecedingInsts(const std::map<uint64_t, BBInfo> &BBInfos,
+                     const std::vector<MCDecodedInst> &Insts,
+                     const BBInfo &BBI, const MCInstrAnalysis &MIA,
+                     unsigned MaxInsts, SmallVectorImpl<MCInst> &PrecInsts,
+                     SmallVectorImpl<uint64_t> &Addrs) {
+  SmallVector<size_t, 16> Indices;
+  const BBInfo *Cur = &BBI;
+  while (true) {
+    for (size_t i = Cur->InstEnd;
+         i != Cur->InstBegin && Indices.size() < MaxInsts;)
+      Indices.push_back(--i);
+    if (Indices.size() == MaxInsts)
+      break;
+
+    // Only follow the previous block if it falls through to this one.
+    auto It = BBInfos.find(Cur->BeginAddr);
+    if (It == BBInfos.begin())
+      break;
+    const BBInfo &Prev = std::prev(It)->second;
+    if (Prev.BeginAddr + Prev.SizeInBytes != Cur->BeginAddr ||
+        Prev.InstBegin == Prev.InstEnd)
+      break;
+    const MCInst &PrevLast = Insts[Prev.InstEnd - 1].Inst;
+    if (MIA.isTerminator(PrevLast) && !MIA.isConditionalBranch(PrevLast))
+      break;
+    Cur = &Prev;
+  }
+
+  for (size_t Idx : reverse(Indices)) {
+    PrecInsts.push_back(Insts[Idx].Inst);
+    Addrs.push_back(Insts[Idx].Address);
+  }
+  const MCDecodedInst &Last = Insts[BBI.InstEnd - 1];
+  Addrs.push_back(Last.Address + Last.Size);
+}
+
+bool MCObjectDisassembler::findJumpTableTargets(ArrayRef<MCInst> Insts,
+                                                ArrayRef<uint64_t> Addrs,
+                                                AddressSetTy &Targets) {
+  MCInstrAnalysis::JumpTable JT;
+  if (!MIA.evaluateJumpTable(Insts, Addrs, JT))
+    return false;
+
+  DEBUG(dbgs() << "Found jump table at " << utohexstr(JT.Addr) << " with "
+               << JT.NumEntries << " entries\n");
+
+  // The table needs to be in memory we know isn't modified at runtime.
+  const uint64_t TableSize = JT.NumEntries * JT.EntrySize;
+  const MemoryRegion *Region = findRegionContaining(ReadOnlyRegions, JT.Addr);
+  if (!Region || JT.Addr + TableSize > Region->Addr + Region->Bytes.size() ||
+      (JT.EntrySize != 4 && JT.EntrySize != 8)) {
+    DEBUG(dbgs() << "Jump table isn't in a read-only region!\n");
+    return false;
+  }
+
+  for (uint64_t i = 0; i != JT.NumEntries; ++i) {
+    const uint64_t EntryAddr = JT.Addr + i * JT.EntrySize;
+    // FIXME: We only handle little-endian targets.
+    const uint8_t *Entry = Region->Bytes.data() + (EntryAddr - Region->Addr);
+    uint64_t Contents = JT.EntrySize == 8 ? support::endian::read64le(Entry)
+                                          : support::endian::read32le(Entry);
+
+    // Resolve the entry through the relocation there, if any.
+    uint64_t Value = Contents;
+    if (MOS && !MOS->getRelocatedValueAt(MOS->getOriginalLoadAddr(EntryAddr),
+                                         Contents, Value)) {
+      DEBUG(dbgs() << "Unresolved jump table relocation at "
+                   << utohexstr(EntryAddr) << "!\n");
+      return false;
+    }
+
+    uint64_t Target;
+    if (JT.IsRelative)
+      Target = JT.Addr + (JT.EntrySize == 4 ? int64_t(int32_t(Value)) : Value);
+    else
+      Target = MOS ? MOS->getEffectiveLoadAddr(Value) : Value;
+
+    // All the targets need to be code: otherwise, this probably isn't a
+    // jump table at all.
+    if (!findRegionContaining(SectionRegions, Target) ||
+        (Target >= JT.Addr && Target < JT.Addr + TableSize)) {
+      DEBUG(dbgs() << "Invalid jump table target " << utohexstr(Target)
+                   << "!\n");
+      return false;
+    }
+    Targets.push_back(Target);
+  }
+  return true;
+}
+
 void MCObjectDisassembler::buildCFG(MCModule &Module) {
   SmallSetVector<uint64_t, 16> WorkList;
 
@@ -145,15 +291,84 @@ void MCObjectDisassembler::buildCFG(MCModule &Module) {
   for (auto Entrypoint : MOS->getEntrypoints())
     WorkList.insert(Entrypoint);
 
+  if (NumThreads > 1)
+    return buildCFGInParallel(Module, WorkList);
+
   // Starting from there, disassemble each discovered function.
   for (size_t i = 0; i < WorkList.size(); ++i) {
     uint64_t Addr = WorkList[i];
     if (getRegionFor(Addr).Bytes.empty())
       continue;
     MCFunction *MCFN = createFunction(&Module, Addr);
+    noteDisassembled(*MCFN);
     for (uint64_t Callee : MCFN->callees())
       WorkList.insert(Callee);
   }
+  releaseDisassembledRanges();
+}
+
+void MCObjectDisassembler::noteDisassembled(const MCFunction &MCFN) {
+  if (!MaxResidentBytes)
+    return;
+
+  // Only the section contents are file-backed: the fallback region is live
+  // memory, which we must never release.
+  for (const MCBasicBlock *BB : MCFN) {
+    const MemoryRegion *Region =
+        findRegionContaining(SectionRegions, BB->getStartAddr());
+    if (!Region)
+      continue;
+    uint64_t Offset = BB->getStartAddr() - Region->Addr;
+    uint64_t Size = std::min<uint64_t>(BB->getSizeInBytes(),
+                                       Region->Bytes.size() - Offset);
+    const uint8_t *Begin = Region->Bytes.data() + Offset;
+    DisassembledRanges.emplace_back(Begin, Begin + Size);
+    DisassembledBytes += Size;
+  }
+
+  if (DisassembledBytes > MaxResidentBytes)
+    releaseDisassembledRanges();
+}
+
+void MCObjectDisassembler::releaseDisassembledRanges() {
+  if (DisassembledRanges.empty())
+    return;
+
+#ifdef LLVM_ON_UNIX
+  // Only release the pages entirely covered by the disassembled ranges: the
+  // partial pages at their ends can hold bytes that weren't disassembled yet.
+  // Adjacent ranges are merged first, so that we don't miss the pages they
+  // cover together.
+  std::sort(DisassembledRanges.begin(), DisassembledRanges.end());
+  const uintptr_t PageSize = sys::Process::getPageSize();
+  auto Release = [&](uintptr_t Begin, uintptr_t End) {
+    Begin = alignTo(Begin, PageSize);
+    End = alignDown(End, PageSize);
+    if (Begin >= End)
+      return;
+    if (::madvise(reinterpret_cast<void *>(Begin), End - Begin,
+                  MADV_DONTNEED) == 0)
+      NumReleasedBytes += End - Begin;
+  };
+
+  uintptr_t Begin = reinterpret_cast<uintptr_t>(DisassembledRanges[0].first);
+  uintptr_t End = reinterpret_cast<uintptr_t>(DisassembledRanges[0].second);
+  for (auto &Range : makeArrayRef(DisassembledRanges).drop_front()) {
+    uintptr_t RBegin = reinterpret_cast<uintptr_t>(Range.first);
+    uintptr_t REnd = reinterpret_cast<uintptr_t>(Range.second);
+    if (RBegin > End) {
+      Release(Begin, End);
+      Begin = RBegin;
+    }
+    End = std::max(End, REnd);
+  }
+  Release(Begin, End);
+#endif
+
+  DEBUG(dbgs() << "Released " << DisassembledBytes
+               << " disassembled bytes\n");
+  DisassembledRanges.clear();
+  DisassembledBytes = 0;
 }
 
 namespace {
@@ -171,6 +386,51 @@ namespace {
   };
 } // end anonymous namespace
 
+void MCObjectDisassembler::buildCFGInParallel(
+    MCModule &Module, SmallSetVector<uint64_t, 16> &WorkList) {
+  ThreadPool Pool(NumThreads);
+
+  // Process the worklist in waves: disassemble all the functions currently in
+  // the worklist concurrently, each into a standalone MCFunction, then add
+  // them to the module, and their callees to the worklist, in worklist order.
+  // This is the same order the serial buildCFG uses, so the module is the same.
+  for (size_t i = 0; i < WorkList.size();) {
+    const size_t WaveBegin = i, WaveEnd = WorkList.size();
+    DEBUG(dbgs() << "Disassembling " << (WaveEnd - WaveBegin)
+                 << " functions in parallel\n");
+
+    std::vector<std::unique_ptr<MCFunction>> Staged(WaveEnd - WaveBegin);
+    for (size_t wi = WaveBegin; wi != WaveEnd; ++wi) {
+      const uint64_t Addr = WorkList[wi];
+      // External functions aren't disassembled: leave them to createFunction.
+      if (getRegionFor(Addr).Bytes.empty() ||
+          (MOS && !MOS->findExternalFunctionAt(Addr).empty()))
+        continue;
+      std::unique_ptr<MCFunction> &MCFN = Staged[wi - WaveBegin];
+      MCFN.reset(new MCFunction(("fn_" + utohexstr(Addr)).c_str(), Addr,
+                                &Module));
+      Pool.async([this, &Module, &MCFN, Addr]() {
+        AddrPrettyStackTraceEntry X(Addr, "Function");
+        disassembleFunctionAt(&Module, MCFN.get(), Addr);
+      });
+    }
+    Pool.wait();
+
+    for (; i != WaveEnd; ++i) {
+      const uint64_t Addr = WorkList[i];
+      if (getRegionFor(Addr).Bytes.empty())
+        continue;
+      std::unique_ptr<MCFunction> &StagedFN = Staged[i - WaveBegin];
+      MCFunction *MCFN = StagedFN ? Module.addFunction(std::move(StagedFN))
+                                  : createFunction(&Module, Addr);
+      noteDisassembled(*MCFN);
+      for (uint64_t Callee : MCFN->callees())
+        WorkList.insert(Callee);
+    }
+  }
+  releaseDisassembledRanges();
+}
+
 // Basic idea of the disassembly + discovery:
 //
 // start with the wanted address, insert it in the worklist
@@ -189,8 +449,13 @@ namespace {
 void MCObjectDisassembler::disassembleFunctionAt(MCModule *Module,
                                                  MCFunction *MCFN,
                                                  uint64_t BBBeginAddr) {
+  // The blocks, keyed by start address.  They never overlap, so the block
+  // containing an address, if any, is the last one starting at or before it.
   std::map<uint64_t, BBInfo> BBInfos;
 
+  // All the decoded instructions, in disassembly order.
+  std::vector<MCDecodedInst> Insts;
+
   typedef SmallSetVector<uint64_t, 16> AddrWorklistTy;
 
   AddrWorklistTy Worklist;
@@ -208,12 +473,13 @@ void MCObjectDisassembler::disassembleFunctionAt(MCModule *Module,
 
     DEBUG(dbgs() << "Looking for block at " << utohexstr(BeginAddr) << "\n");
 
-    // Look for a BB at BeginAddr.
-    auto BeforeIt = std::upper_bound(
-        BBInfos.begin(), BBInfos.end(), BeginAddr,
-        [](uint64_t Addr, const std::pair<uint64_t, BBInfo> &BBI) {
-          return Addr < BBI.second.BeginAddr+BBI.second.SizeInBytes;
-        });
+    // Look for a BB containing BeginAddr, or for the first one after it.
+    auto BeforeIt = BBInfos.upper_bound(BeginAddr);
+    if (BeforeIt != BBInfos.begin()) {
+      auto PrevIt = std::prev(BeforeIt);
+      if (BeginAddr < PrevIt->first + PrevIt->second.SizeInBytes)
+        BeforeIt = PrevIt;
+    }
 
     assert((BeforeIt == BBInfos.end() || BeforeIt->first != BeginAddr) &&
            "Visited same basic block twice!");
@@ -231,29 +497,24 @@ void MCObjectDisassembler::disassembleFunctionAt(MCModule *Module,
       BBInfo &NewBB = BBInfos[BeginAddr];
       NewBB.BeginAddr = BeginAddr;
 
-      auto SplitInst = BeforeBB.Insts.end();
-      for (auto I = BeforeBB.Insts.begin(), E = BeforeBB.Insts.end(); I != E;
-           ++I) {
-        if (BeginAddr == I->Address) {
-          SplitInst = I;
-          break;
-        }
-      }
+      // The instructions are sorted by address, so binary search them.
+      auto InstsBegin = Insts.begin() + BeforeBB.InstBegin;
+      auto InstsEnd = Insts.begin() + BeforeBB.InstEnd;
+      auto SplitInst = std::lower_bound(
+          InstsBegin, InstsEnd, BeginAddr,
+          [](const MCDecodedInst &I, uint64_t Addr) { return I.Address < Addr; });
 
-      assert(SplitInst != BeforeBB.Insts.end() &&
+      assert(SplitInst != InstsEnd && SplitInst->Address == BeginAddr &&
              "Split point does not fall on an instruction boundary!");
 
-      // FIXME: use a list instead for free splicing?
-
-      // Splice the remaining instructions to the new block.
-      // While SplitInst is still valid, decrease the size to match.
-      const uint64_t SplitOffset = SplitInst->Address - BeforeBB.BeginAddr;
+      // Give the remaining instructions to the new block.
+      const uint64_t SplitOffset = BeginAddr - BeforeBB.BeginAddr;
       NewBB.SizeInBytes = BeforeBB.SizeInBytes - SplitOffset;
       BeforeBB.SizeInBytes = SplitOffset;
 
-      // Now do the actual splicing out of BeforeBB.
-      NewBB.Insts.insert(NewBB.Insts.begin(), SplitInst, BeforeBB.Insts.end());
-      BeforeBB.Insts.erase(SplitInst, BeforeBB.Insts.end());
+      NewBB.InstBegin = SplitInst - Insts.begin();
+      NewBB.InstEnd = BeforeBB.InstEnd;
+      BeforeBB.InstEnd = NewBB.InstBegin;
 
       // Move the successors to the new block.
       std::swap(NewBB.SuccAddrs, BeforeBB.SuccAddrs);
@@ -275,8 +536,7 @@ void MCObjectDisassembler::disassembleFunctionAt(MCModule *Module,
 
       BBInfo &BBI = BBInfos[BeginAddr];
       BBI.BeginAddr = BeginAddr;
-
-      assert(BBI.Insts.empty() && "Basic Block already exists!");
+      BBI.InstBegin = BBI.InstEnd = Insts.size();
 
       DEBUG(dbgs() << "No existing block found, starting disassembly from "
                    << utohexstr(Region.Addr) << " to "
@@ -285,7 +545,9 @@ void MCObjectDisassembler::disassembleFunctionAt(MCModule *Module,
       auto AddInst = [&](MCInst &I, uint64_t Addr, uint64_t Size) {
         const uint64_t NextAddr = BBI.BeginAddr + BBI.SizeInBytes;
         assert(NextAddr == Addr);
-        BBI.Insts.emplace_back(I, NextAddr, Size);
+        assert(BBI.InstEnd == Insts.size() && "Block isn't contiguous!");
+        Insts.emplace_back(I, NextAddr, Size);
+        ++BBI.InstEnd;
         BBI.SizeInBytes += Size;
       };
 
@@ -338,13 +600,31 @@ void MCObjectDisassembler::disassembleFunctionAt(MCModule *Module,
               }
             }
           }
+
+          // If the terminator is an indirect branch using a jump table, add
+          // all the table targets.
+          if (MIA.isIndirectBranch(Inst)) {
+            SmallVector<MCInst, 16> PrecInsts;
+            SmallVector<uint64_t, 17> PrecAddrs;
+            gatherPrecedingInsts(BBInfos, Insts, BBI, MIA,
+                                 MaxJumpTableLookback, PrecInsts, PrecAddrs);
+            AddressSetTy Targets;
+            if (findJumpTableTargets(PrecInsts, PrecAddrs, Targets)) {
+              for (uint64_t Target : Targets) {
+                BBI.SuccAddrs.push_back(Target);
+                Worklist.insert(Target);
+              }
+            }
+          }
           break;
         }
       }
     }
   }
 
-  // First, create all blocks.
+  // First, create all blocks.  The function takes all the instructions, and
+  // each block references its range.
+  MCFN->setInsts(Insts);
   for (size_t wi = 0, we = Worklist.size(); wi != we; ++wi) {
     const uint64_t BeginAddr = Worklist[wi];
     BBInfo *BBI = &BBInfos[BeginAddr];
@@ -352,9 +632,10 @@ void MCObjectDisassembler::disassembleFunctionAt(MCModule *Module,
 
     MCBB = &MCFN->createBlock(BeginAddr);
 
-    std::swap(MCBB->Insts, BBI->Insts);
-    MCBB->InstCount = MCBB->Insts.size();
+    MCBB->InstBegin = BBI->InstBegin;
+    MCBB->InstEnd = BBI->InstEnd;
     MCBB->SizeInBytes = BBI->SizeInBytes;
+    MCBB->NextInstAddress = BeginAddr + BBI->SizeInBytes;
   }
 
   // Next, add all predecessors/successors.
@@ -19,6 +19,7 @@
 #include "llvm/Object/SymbolSize.h"
 #include "llvm/Support/DataExtractor.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
@@ -205,6 +206,36 @@ StringRef MCMachObjectSymbolizer::findExternalFunctionAt(uint64_t Addr) {
   return SymName.substr(1);
 }
 
+bool MCMachObjectSymbolizer::getRelocatedValueAt(uint64_t Addr,
+                                                 uint64_t Contents,
+                                                 uint64_t &Value) {
+  const RelocationRef *R = findRelocationStartingAt(Addr);
+  if (!R) {
+    Value = Contents;
+    return true;
+  }
+
+  // Only resolve absolute relocations (X86_64_RELOC_UNSIGNED, or
+  // GENERIC_RELOC_VANILLA on i386), not pairs like X86_64_RELOC_SUBTRACTOR.
+  const MachO::any_relocation_info RE =
+      MOOF.getRelocation(R->getRawDataRefImpl());
+  if (MOOF.isRelocationScattered(RE) || MOOF.getAnyRelocationPCRel(RE) ||
+      MOOF.getAnyRelocationType(RE) != MachO::X86_64_RELOC_UNSIGNED)
+    return false;
+
+  // Section relocations are already applied to the contents, which are the
+  // address of the target; symbol relocations add the symbol address.
+  if (MOOF.getPlainRelocationExternal(RE)) {
+    symbol_iterator SI = R->getSymbol();
+    if (SI == MOOF.symbol_end() ||
+        (SI->getFlags() & SymbolRef::SF_Undefined))
+      return false;
+    Contents += unwrapOrReportError(SI->getAddress());
+  }
+  Value = Contents;
+  return true;
+}
+
 void MCMachObjectSymbolizer::
 tryAddingPcLoadReferenceComment(raw_ostream &cStream, int64_t Value,
                                 uint64_t Address) {
@@ -243,11 +274,11 @@ static bool shouldSkipELFSection(SectionRef S) {
 
 MCELFObjectSymbolizer::MCELFObjectSymbolizer(
     MCContext &Ctx, std::unique_ptr<MCRelocationInfo> RelInfo,
-    const ELFObjectFileBase &ELFOF)
+    const ELFObjectFileBase &ELFOF, uint64_t LoadBias)
     : MCObjectSymbolizer(Ctx, std::move(RelInfo), ELFOF, shouldSkipELFSection),
-      OF(ELFOF) {
+      OF(ELFOF), LoadBias(LoadBias) {
 
-  (void)OF;
+  gatherStaticInitExitFunctions();
 
   if (MainEntrypoint.hasValue() == false) {
     // FIXME: Find the main entrypoint in a stripped ELF-File if possible.
@@ -262,6 +293,81 @@ MCELFObjectSymbolizer::MCELFObjectSymbolizer(
   }
 }
 
+/// Append to \p Fns the function pointers in the ELF section \p Name of \p OF.
+/// In PIEs, the array is only filled by the dynamic loader, using
+/// R_X86_64_RELATIVE relocations, so get the pointers from these instead.
+// FIXME: We only handle 64bit LE ELF.
+static void readELFFunctionPointerArray(const ELFObjectFileBase &OFB,
+                                        StringRef Name,
+                                        std::vector<uint64_t> &Fns) {
+  const auto *OF = dyn_cast<ELF64LEObjectFile>(&OFB);
+  if (!OF)
+    return;
+  for (const SectionRef &Section : OF->sections()) {
+    StringRef SecName;
+    Section.getName(SecName);
+    if (SecName != Name)
+      continue;
+
+    StringRef Contents;
+    Section.getContents(Contents);
+    const uint64_t ArrayAddr = Section.getAddress();
+    const uint64_t ArraySize = Contents.size() / 8;
+
+    std::vector<uint64_t> Ptrs(ArraySize);
+    for (uint64_t I = 0; I != ArraySize; ++I)
+      Ptrs[I] = support::endian::read64le(Contents.data() + I * 8);
+
+    for (const SectionRef &RelSection : OF->sections()) {
+      if (ELFSectionRef(RelSection).getType() != ELF::SHT_RELA)
+        continue;
+      for (const RelocationRef &Reloc : RelSection.relocations()) {
+        // RelocationRef::getOffset() is only valid in relocatable objects;
+        // in executables, r_offset is the virtual address we want.
+        const auto *Rela = OF->getRela(Reloc.getRawDataRefImpl());
+        const uint64_t Offset = Rela->r_offset;
+        if (Rela->getType(false) != ELF::R_X86_64_RELATIVE ||
+            Offset < ArrayAddr || Offset >= ArrayAddr + ArraySize * 8)
+          continue;
+        Ptrs[(Offset - ArrayAddr) / 8] = Rela->r_addend;
+      }
+    }
+
+    // 0 and -1 are used as terminators/placeholders by some toolchains.
+    for (uint64_t Ptr : Ptrs)
+      if (Ptr != 0 && Ptr != ~0ULL)
+        Fns.push_back(Ptr);
+    return;
+  }
+}
+
+void MCELFObjectSymbolizer::gatherStaticInitExitFunctions() {
+  if (OF.getArch() != Triple::x86_64)
+    return;
+
+  readELFFunctionPointerArray(OF, ".preinit_array", StaticInitFunctions);
+  readELFFunctionPointerArray(OF, ".init_array", StaticInitFunctions);
+  // .fini_array is executed in reverse order.
+  readELFFunctionPointerArray(OF, ".fini_array", StaticExitFunctions);
+  std::reverse(StaticExitFunctions.begin(), StaticExitFunctions.end());
+}
+
+uint64_t MCELFObjectSymbolizer::getEffectiveLoadAddr(uint64_t Addr) {
+  return Addr + LoadBias;
+}
+
+uint64_t MCELFObjectSymbolizer::getOriginalLoadAddr(uint64_t EffectiveAddr) {
+  return EffectiveAddr - LoadBias;
+}
+
+ArrayRef<uint64_t> MCELFObjectSymbolizer::getStaticInitFunctions() {
+  return StaticInitFunctions;
+}
+
+ArrayRef<uint64_t> MCELFObjectSymbolizer::getStaticExitFunctions() {
+  return StaticExitFunctions;
+}
+
 //===- MCObjectSymbolizer -------------------------------------------------===//
 
 MCObjectSymbolizer::MCObjectSymbolizer(
@@ -302,6 +408,14 @@ uint64_t MCObjectSymbolizer::getEffectiveLoadAddr(uint64_t Addr) {
 
 uint64_t MCObjectSymbolizer::getOriginalLoadAddr(uint64_t Addr) { return Addr; }
 
+ArrayRef<uint64_t> MCObjectSymbolizer::getStaticInitFunctions() {
+  return None;
+}
+
+ArrayRef<uint64_t> MCObjectSymbolizer::getStaticExitFunctions() {
+  return None;
+}
+
 bool MCObjectSymbolizer::
 tryAddingSymbolicOperand(MCInst &MI, raw_ostream &cStream,
                          int64_t Value, uint64_t Address, bool IsBranch,
@@ -409,6 +523,15 @@ StringRef MCObjectSymbolizer::findExternalFunctionAt(uint64_t Addr) {
   return StringRef();
 }
 
+bool MCObjectSymbolizer::getRelocatedValueAt(uint64_t Addr, uint64_t Contents,
+                                             uint64_t &Value) {
+  // We don't know how to apply relocations in general.
+  if (findRelocationStartingAt(Addr))
+    return false;
+  Value = Contents;
+  return true;
+}
+
 // SortedSections implementation.
 
 const SectionRef *
@@ -449,6 +572,20 @@ const RelocationRef *MCObjectSymbolizer::findRelocationAt(uint64_t Addr) const {
   return &*RI;
 }
 
+const RelocationRef *
+MCObjectSymbolizer::findRelocationStartingAt(uint64_t Addr) const {
+  const SectionInfo *SecInfo = findSectionInfoContaining(Addr);
+  if (!SecInfo)
+    return nullptr;
+  // The relocation offsets are relative to their section.
+  const uint64_t Offset = Addr - SecInfo->Section.getAddress();
+  auto RI = std::lower_bound(SecInfo->Relocs.begin(), SecInfo->Relocs.end(),
+                             Offset, RelocU64OffsetComparator);
+  if (RI == SecInfo->Relocs.end() || RI->getOffset() != Offset)
+    return nullptr;
+  return &*RI;
+}
+
 void MCObjectSymbolizer::buildSectionList(
     std::function<bool(SectionRef)> ShouldSkipSection) {
 
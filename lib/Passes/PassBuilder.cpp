@@ -1554,6 +1554,27 @@ bool PassBuilder::parsePassPipeline(ModulePassManager &MPM,
   return parseModulePassPipeline(MPM, *Pipeline, VerifyEachPass, DebugLogging);
 }
 
+bool PassBuilder::parsePassPipeline(FunctionPassManager &FPM,
+                                    StringRef PipelineText, bool VerifyEachPass,
+                                    bool DebugLogging) {
+  auto Pipeline = parsePipelineText(PipelineText);
+  if (!Pipeline || Pipeline->empty())
+    return false;
+
+  // If the first name is a loop pass, wrap the pipeline up automatically.
+  StringRef FirstName = Pipeline->front().Name;
+  if (!isFunctionPassName(FirstName)) {
+    if (isLoopPassName(FirstName))
+      Pipeline = {{"loop", std::move(*Pipeline)}};
+    else
+      // Not a function or loop pass name!
+      return false;
+  }
+
+  return parseFunctionPassPipeline(FPM, *Pipeline, VerifyEachPass,
+                                   DebugLogging);
+}
+
 bool PassBuilder::parseAAPipeline(AAManager &AA, StringRef PipelineText) {
   // If the pipeline just consists of the word 'default' just replace the AA
   // manager with our default one.
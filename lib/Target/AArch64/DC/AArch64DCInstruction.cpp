@@ -32,6 +32,7 @@
 #include <algorithm>
 
 #define GET_INSTR_SEMA
+#define GET_COMPILED_SEMA
 #include "AArch64GenSema.inc"
 using namespace llvm;
 
@@ -40,7 +41,7 @@ using namespace llvm;
 AArch64DCInstruction::AArch64DCInstruction(DCBasicBlock &DCB,
                                            const MCDecodedInst &MCI)
     : DCInstruction(DCB, MCI, AArch64::OpcodeToSemaIdx, AArch64::InstSemantics,
-                    AArch64::ConstantArray) {}
+                    AArch64::ConstantArray, AArch64::CompiledSemantics) {}
 
 bool AArch64DCInstruction::translateTargetInst() {
   unsigned Opcode = TheMCInst.Inst.getOpcode();
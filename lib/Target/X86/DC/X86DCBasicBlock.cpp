@@ -9,12 +9,17 @@
 
 #include "X86DCBasicBlock.h"
 #include "llvm/DC/RegisterValueUtils.h"
+#include "llvm/IR/Instructions.h"
 
 using namespace llvm;
 
 X86DCBasicBlock::X86DCBasicBlock(DCFunction &DCF, const MCBasicBlock &MCB)
     : DCBasicBlock(DCF, MCB), LastEFLAGSChangingDef(0), LastEFLAGSDef(0),
-      LastEFLAGSDefWasPartialINCDEC(false), SFVals(X86::MAX_FLAGS + 1),
+      LastEFLAGSDefWasPartialINCDEC(false),
+      LastEFLAGSDefLiveFlags(X86::AllStatusFlags),
+      LiveInFlags(getParent().getLiveInFlags(MCB)),
+      SuccLiveInFlags(getParent().getSuccLiveInFlags(MCB)),
+      EFLAGSIsLiveIn(LiveInFlags != 0), SFVals(X86::MAX_FLAGS + 1),
       SFAssignments(X86::MAX_FLAGS + 1), CCVals(X86::COND_INVALID),
       CCAssignments(X86::COND_INVALID), LastPrefix(0) {}
 
@@ -25,6 +30,17 @@ X86DCBasicBlock::~X86DCBasicBlock() {
     if (auto *TI = dyn_cast<TerminatorInst>(&*std::prev(BB->end(), 2)))
       Builder.SetInsertPoint(TI);
   materializeEFLAGS();
+
+  // Pass the status flags read by the successors as they are, if they might
+  // have changed in this block.
+  if (EFLAGSIsLiveIn)
+    return;
+  const X86::StatusFlag Flags[6] = {X86::CF, X86::PF, X86::AF,
+                                    X86::ZF, X86::SF, X86::OF};
+  for (X86::StatusFlag SF : Flags)
+    if (SuccLiveInFlags & (1 << SF))
+      Builder.CreateStore(getSF(SF),
+                          getParent().getOrCreateStatusFlagAlloca(SF));
 }
 
 void X86DCBasicBlock::clearCCSF() {
@@ -44,7 +60,8 @@ void X86DCBasicBlock::materializeEFLAGS() {
     Builder.SetCurrentDebugLocation(EFLAGSDefI->getDebugLoc());
 
   Value *EFLAGSDef =
-      computeEFLAGSForDef(LastEFLAGSChangingDef, LastEFLAGSDefWasPartialINCDEC);
+      computeEFLAGSForDef(LastEFLAGSChangingDef, LastEFLAGSDefWasPartialINCDEC,
+                          LastEFLAGSDefLiveFlags);
   setReg(X86::EFLAGS, EFLAGSDef);
   LastEFLAGSDef = EFLAGSDef;
   LastEFLAGSChangingDef = 0;
@@ -62,25 +79,20 @@ void X86DCBasicBlock::dematerializeRegister(unsigned RegNo, Value *RV) {
   if (RV != LastEFLAGSDef) {
     clearCCSF();
     LastEFLAGSDef = RV;
+
+    // Loading the incoming EFLAGS doesn't change it, anything else does.
+    if (EFLAGSIsLiveIn) {
+      auto *LI = dyn_cast<LoadInst>(RV);
+      if (!LI || LI->getPointerOperand() !=
+                     getParent().getOrCreateRegAlloca(X86::EFLAGS))
+        EFLAGSIsLiveIn = false;
+    }
   }
 }
 
-static StringRef getSFName(X86::StatusFlag SF) {
-  switch (SF) {
-  case X86::SF:
-    return "SF";
-  case X86::CF:
-    return "CF";
-  case X86::PF:
-    return "PF";
-  case X86::AF:
-    return "AF";
-  case X86::ZF:
-    return "ZF";
-  case X86::OF:
-    return "OF";
-  }
-  llvm_unreachable("Unknown status flag.");
+void X86DCBasicBlock::clobberEFLAGS() {
+  clearCCSF();
+  EFLAGSIsLiveIn = false;
 }
 
 static StringRef getCCName(X86::CondCode CC) {
@@ -200,8 +212,10 @@ void X86DCBasicBlock::setCC(X86::CondCode CC, Value *CCV) {
         (Twine(getCCName(CC)) + "_" + utostr(CCAssignments[CC]++)).str());
 }
 
-Value *X86DCBasicBlock::getEFLAGSforCMP(Value *LHS, Value *RHS) {
+Value *X86DCBasicBlock::getEFLAGSforCMP(Value *LHS, Value *RHS,
+                                        uint64_t Addr) {
   clearCCSF();
+  EFLAGSIsLiveIn = false;
   assert(LHS->getType() == RHS->getType());
   if (RHS->getType()->isIntegerTy()) {
     // FIXME: the ultimate goal is to make this transparent, depending on the
@@ -217,7 +231,9 @@ Value *X86DCBasicBlock::getEFLAGSforCMP(Value *LHS, Value *RHS) {
     setCC(X86::COND_E, Builder.CreateICmpEQ(LHS, RHS));
     setCC(X86::COND_NE, Builder.CreateICmpNE(LHS, RHS));
     // Per the intel manual, CMP is equivalent to SUB.
-    LastEFLAGSDef = computeEFLAGSForDef(Builder.CreateSub(LHS, RHS));
+    LastEFLAGSDef =
+        computeEFLAGSForDef(Builder.CreateSub(LHS, RHS), /*DontUpdateCF=*/false,
+                            getParent().getLiveFlagsAfterDef(Addr));
     return LastEFLAGSDef;
   } else {
     setSF(X86::OF, Builder.getFalse());
@@ -231,26 +247,35 @@ Value *X86DCBasicBlock::getEFLAGSforCMP(Value *LHS, Value *RHS) {
   }
 }
 
-void X86DCBasicBlock::updateEFLAGS(Value *Def, bool IsINCDEC) {
+void X86DCBasicBlock::updateEFLAGS(Value *Def, uint64_t Addr, bool IsINCDEC) {
   // FIXME: we only really need the alloca here.
   LastEFLAGSChangingDef = 0;
   getReg(X86::EFLAGS);
   LastEFLAGSChangingDef = Def;
   LastEFLAGSDef = 0;
   LastEFLAGSDefWasPartialINCDEC = IsINCDEC;
+  LastEFLAGSDefLiveFlags = getParent().getLiveFlagsAfterDef(Addr);
+  EFLAGSIsLiveIn = false;
 }
 
-Value *X86DCBasicBlock::computeEFLAGSForDef(Value *Def, bool DontUpdateCF) {
+Value *X86DCBasicBlock::computeEFLAGSForDef(Value *Def, bool DontUpdateCF,
+                                            unsigned LiveFlags) {
   // FIXME: This describes the general semantics of EFLAGS update, but this
   // needs to handle the differences between instructions.
   // This would be done by keeping more information on the instruction with
   // LastEFLAGSChangingDef.
   // For now we only do DontUpdateCF, for INC/DEC instructions.
 
-  setSF(X86::ZF, Builder.CreateIsNull(Def));
+  // The flags that are never read are left cleared.
+  auto IsLive = [&](X86::StatusFlag SF) { return LiveFlags & (1 << SF); };
+
+  setSF(X86::ZF,
+        IsLive(X86::ZF) ? Builder.CreateIsNull(Def) : Builder.getFalse());
 
-  setSF(X86::SF,
-        Builder.CreateICmpSLT(Def, ConstantInt::getNullValue(Def->getType())));
+  setSF(X86::SF, IsLive(X86::SF)
+                     ? Builder.CreateICmpSLT(
+                           Def, ConstantInt::getNullValue(Def->getType()))
+                     : Builder.getFalse());
 
   // FIXME: We need to generate AF as well.
   setSF(X86::AF, Builder.getFalse());
@@ -268,33 +293,37 @@ Value *X86DCBasicBlock::computeEFLAGSForDef(Value *Def, bool DontUpdateCF) {
     CarryIntrinsic = Intrinsic::usub_with_overflow;
   }
 
-  if (BinOp && OverflowIntrinsic && CarryIntrinsic) {
+  // Dead flags don't need the intrinsics.
+  if (!IsLive(X86::OF))
+    OverflowIntrinsic = Intrinsic::not_intrinsic;
+  if (!IsLive(X86::CF))
+    CarryIntrinsic = Intrinsic::not_intrinsic;
+
+  auto CreateOverflowBit = [&](Intrinsic::ID IID) {
     Value *Args[] = {BinOp->getOperand(0), BinOp->getOperand(1)};
-    setSF(X86::OF, Builder.CreateExtractValue(
-                       Builder.CreateCall(
-                           Intrinsic::getDeclaration(
-                               getModule(), OverflowIntrinsic, BinOp->getType()),
-                           Args),
-                       1));
-    if (!DontUpdateCF)
-      setSF(X86::CF, Builder.CreateExtractValue(
-                         Builder.CreateCall(
-                             Intrinsic::getDeclaration(
-                                 getModule(), CarryIntrinsic, BinOp->getType()),
-                             Args),
-                         1));
-  } else {
-    if (!DontUpdateCF)
-      setSF(X86::CF, Builder.getFalse());
-    setSF(X86::OF, Builder.getFalse());
-  }
+    return Builder.CreateExtractValue(
+        Builder.CreateCall(
+            Intrinsic::getDeclaration(getModule(), IID, BinOp->getType()),
+            Args),
+        1);
+  };
+
+  setSF(X86::OF, OverflowIntrinsic ? CreateOverflowBit(OverflowIntrinsic)
+                                   : Builder.getFalse());
+  if (!DontUpdateCF)
+    setSF(X86::CF, CarryIntrinsic ? CreateOverflowBit(CarryIntrinsic)
+                                  : Builder.getFalse());
 
   Type *I8Ty = Builder.getInt8Ty();
-  setSF(X86::PF, Builder.CreateIsNull(Builder.CreateTrunc(
-                     Builder.CreateCall(Intrinsic::getDeclaration(
-                                             getModule(), Intrinsic::ctpop, I8Ty),
-                                         {Builder.CreateTrunc(Def, I8Ty)}),
-                     Builder.getInt1Ty())));
+  if (IsLive(X86::PF))
+    setSF(X86::PF, Builder.CreateIsNull(Builder.CreateTrunc(
+                       Builder.CreateCall(
+                           Intrinsic::getDeclaration(getModule(),
+                                                     Intrinsic::ctpop, I8Ty),
+                           {Builder.CreateTrunc(Def, I8Ty)}),
+                       Builder.getInt1Ty())));
+  else
+    setSF(X86::PF, Builder.getFalse());
   return createEFLAGSFromSFs();
 }
 
@@ -319,15 +348,19 @@ void X86DCBasicBlock::setSF(X86::StatusFlag SF, Value *Val) {
   // No need to recreate EFLAGS, because this is only called from updateEFLAGS.
   SFVals[SF] = Val;
   if (!Val->hasName())
-    Val->setName(
-        (Twine(getSFName(SF)) + "_" + utostr(SFAssignments[SF]++)).str());
+    Val->setName((Twine(X86::getStatusFlagName(SF)) + "_" +
+                  utostr(SFAssignments[SF]++))
+                     .str());
 }
 
 Value *X86DCBasicBlock::getSF(X86::StatusFlag SF) {
   Value *SV = SFVals[SF];
   if (SV == 0) {
-    SV = llvm::extractBitsFromValue(Builder.saveIP(), SF, 1,
-                                    getReg(X86::EFLAGS));
+    if (EFLAGSIsLiveIn && (LiveInFlags & (1 << SF)))
+      SV = Builder.CreateLoad(getParent().getOrCreateStatusFlagAlloca(SF));
+    else
+      SV = llvm::extractBitsFromValue(Builder.saveIP(), SF, 1,
+                                      getReg(X86::EFLAGS));
     setSF(SF, SV);
   }
   return SV;
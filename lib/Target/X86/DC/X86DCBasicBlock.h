@@ -17,18 +17,6 @@
 
 namespace llvm {
 
-namespace X86 {
-enum StatusFlag {
-  CF = 0,
-  PF = 2,
-  AF = 4,
-  ZF = 6,
-  SF = 7,
-  OF = 11,
-  MAX_FLAGS = OF
-};
-} // end namespace X86
-
 class Value;
 
 class X86DCBasicBlock final : public DCBasicBlock {
@@ -39,6 +27,14 @@ class X86DCBasicBlock final : public DCBasicBlock {
   Value *LastEFLAGSDef;
   // Whether the last EFLAGS def was an INC/DEC, and shouldn't update CF.
   bool LastEFLAGSDefWasPartialINCDEC;
+  // The status flags of the last EFLAGS def that are read later.
+  unsigned LastEFLAGSDefLiveFlags;
+  // The status flags live on entry to the block, and to its successors.
+  unsigned LiveInFlags;
+  unsigned SuccLiveInFlags;
+  // Whether EFLAGS still holds its value on entry to the block, in which case
+  // the live-in status flags can be loaded from their allocas.
+  bool EFLAGSIsLiveIn;
   SmallVector<Value *, 16> SFVals;
   SmallVector<unsigned, 16> SFAssignments;
   SmallVector<Value *, 16> CCVals;
@@ -58,14 +54,19 @@ public:
   // ask for the next instruction?
   unsigned LastPrefix;
 
-  // Update EFLAGS with the result of comparing LHS to RHS.
+  // Update EFLAGS with the result of comparing LHS to RHS, at address Addr.
   // If they are float values, this is an unordered comparison (UCOMI).
-  Value *getEFLAGSforCMP(Value *LHS, Value *RHS);
+  Value *getEFLAGSforCMP(Value *LHS, Value *RHS, uint64_t Addr);
 
   Value *getSF(X86::StatusFlag SF);
   Value *getCC(X86::CondCode CC);
 
-  void updateEFLAGS(Value *Def, bool IsINCDEC = false);
+  // Lazily update EFLAGS with the result Def of the instruction at Addr.
+  void updateEFLAGS(Value *Def, uint64_t Addr, bool IsINCDEC = false);
+
+  // Forget the status flags, after EFLAGS was changed behind our back, by a
+  // call.
+  void clobberEFLAGS();
 
   void setSF(X86::StatusFlag SF, Value *Val);
   void setCC(X86::CondCode CC, Value *Val);
@@ -77,7 +78,8 @@ protected:
 private:
   void clearCCSF();
 
-  Value *computeEFLAGSForDef(Value *Def, bool DontUpdateCF = false);
+  Value *computeEFLAGSForDef(Value *Def, bool DontUpdateCF = false,
+                             unsigned LiveFlags = X86::AllStatusFlags);
   Value *createEFLAGSFromSFs();
 
   void materializeEFLAGS();
@@ -8,8 +8,282 @@
 //===----------------------------------------------------------------------===//
 
 #include "X86DCFunction.h"
+#include "MCTargetDesc/X86MCTargetDesc.h"
+#include "X86InstrInfo.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/DC/DCTranslator.h"
+#include "llvm/DC/RegisterValueUtils.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/MC/MCAnalysis/MCFunction.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <iterator>
 
 using namespace llvm;
 
+#define DEBUG_TYPE "x86-dc-flags"
+
+namespace llvm {
+extern cl::opt<bool> EnableMockIntrin;
+
+cl::opt<bool> EnableX86DCFlagsLiveness(
+    "dc-x86-flags-liveness",
+    cl::desc("Only compute the EFLAGS status flags that are read before being "
+             "redefined, and pass them between blocks as i1 values."));
+}
+
+StringRef X86::getStatusFlagName(X86::StatusFlag SF) {
+  switch (SF) {
+  case X86::SF:
+    return "SF";
+  case X86::CF:
+    return "CF";
+  case X86::PF:
+    return "PF";
+  case X86::AF:
+    return "AF";
+  case X86::ZF:
+    return "ZF";
+  case X86::OF:
+    return "OF";
+  }
+  llvm_unreachable("Unknown status flag.");
+}
+
 X86DCFunction::X86DCFunction(DCModule &DCM, const MCFunction &MCF)
-    : DCFunction(DCM, MCF) {}
+    : DCFunction(DCM, MCF), HasFlagsLiveness(false), StatusFlagAllocas() {
+  // The mock intrinsics don't go through the register allocas.
+  if (EnableX86DCFlagsLiveness && !EnableMockIntrin)
+    computeFlagsLiveness(MCF);
+}
+
+#define CONDCODE_OPCODES(CC)                                                   \
+  case X86::J##CC##_1:                                                         \
+  case X86::J##CC##_2:                                                         \
+  case X86::J##CC##_4:                                                         \
+  case X86::SET##CC##r:                                                        \
+  case X86::SET##CC##m:                                                        \
+  case X86::CMOV##CC##16rr:                                                    \
+  case X86::CMOV##CC##16rm:                                                    \
+  case X86::CMOV##CC##32rr:                                                    \
+  case X86::CMOV##CC##32rm:                                                    \
+  case X86::CMOV##CC##64rr:                                                    \
+  case X86::CMOV##CC##64rm:                                                    \
+    return X86::COND_##CC;
+
+static X86::CondCode getCondFromOpcode(unsigned Opcode) {
+  switch (Opcode) {
+  default:
+    return X86::COND_INVALID;
+  CONDCODE_OPCODES(A)
+  CONDCODE_OPCODES(AE)
+  CONDCODE_OPCODES(B)
+  CONDCODE_OPCODES(BE)
+  CONDCODE_OPCODES(E)
+  CONDCODE_OPCODES(G)
+  CONDCODE_OPCODES(GE)
+  CONDCODE_OPCODES(L)
+  CONDCODE_OPCODES(LE)
+  CONDCODE_OPCODES(NE)
+  CONDCODE_OPCODES(NO)
+  CONDCODE_OPCODES(NP)
+  CONDCODE_OPCODES(NS)
+  CONDCODE_OPCODES(O)
+  CONDCODE_OPCODES(P)
+  CONDCODE_OPCODES(S)
+  }
+}
+
+#undef CONDCODE_OPCODES
+
+/// Get the status flags read to evaluate condition code \p CC.
+/// This mirrors X86DCBasicBlock::getCC.
+static unsigned getCondCodeFlags(X86::CondCode CC) {
+  switch (CC) {
+  case X86::COND_O:
+  case X86::COND_NO:
+    return 1 << X86::OF;
+  case X86::COND_B:
+  case X86::COND_AE:
+    return 1 << X86::CF;
+  case X86::COND_E:
+  case X86::COND_NE:
+    return 1 << X86::ZF;
+  case X86::COND_S:
+  case X86::COND_NS:
+    return 1 << X86::SF;
+  case X86::COND_P:
+  case X86::COND_NP:
+    return 1 << X86::PF;
+  case X86::COND_BE:
+  case X86::COND_A:
+    return (1 << X86::CF) | (1 << X86::ZF);
+  case X86::COND_L:
+  case X86::COND_GE:
+    return (1 << X86::SF) | (1 << X86::OF);
+  case X86::COND_LE:
+  case X86::COND_G:
+    return (1 << X86::SF) | (1 << X86::OF) | (1 << X86::ZF);
+  default:
+    return X86::AllStatusFlags;
+  }
+}
+
+/// Compute the status flags read (\p Uses) and written (\p Defs) by \p Inst.
+/// This needs to match what the translation actually does, or err on the
+/// side of more uses and fewer defs.
+static void getStatusFlagsUsesDefs(const MCInstrInfo &MII, const MCInst &Inst,
+                                   unsigned &Uses, unsigned &Defs) {
+  const unsigned Opcode = Inst.getOpcode();
+  const MCInstrDesc &Desc = MII.get(Opcode);
+  Uses = Defs = 0;
+
+  if (Desc.hasImplicitUseOfPhysReg(X86::EFLAGS))
+    Uses = getCondCodeFlags(getCondFromOpcode(Opcode));
+
+  // The callee sees, and can change, the whole register set.
+  if (Desc.isCall()) {
+    Uses = Defs = X86::AllStatusFlags;
+    return;
+  }
+
+  if (!Desc.hasImplicitDefOfPhysReg(X86::EFLAGS))
+    return;
+  Defs = X86::AllStatusFlags;
+
+  // Bit tests and scans only update some flags, and copy the others from the
+  // previous EFLAGS value.
+  if ((Opcode >= X86::BT16mi8 && Opcode <= X86::BTS64rr) ||
+      (Opcode >= X86::BSF16rm && Opcode <= X86::BSR64rr))
+    Uses = X86::AllStatusFlags;
+
+  // Locked INC/DEC preserve CF.
+  switch (Opcode) {
+  case X86::INC8m:
+  case X86::INC16m:
+  case X86::INC32m:
+  case X86::INC64m:
+  case X86::DEC8m:
+  case X86::DEC16m:
+  case X86::DEC32m:
+  case X86::DEC64m:
+    Defs &= ~(1 << X86::CF);
+    break;
+  }
+}
+
+void X86DCFunction::computeFlagsLiveness(const MCFunction &MCF) {
+  const MCInstrInfo &MII = getTranslator().getMII();
+
+  struct BlockInfo {
+    unsigned Gen = 0, Kill = 0, ExitUses = 0;
+    unsigned LiveIn = 0, SuccLiveIn = 0;
+  };
+  DenseMap<const MCBasicBlock *, BlockInfo> Infos;
+
+  // First, compute the flags read before being written in each block, and the
+  // flags written.
+  for (const MCBasicBlock *MCBB : MCF) {
+    BlockInfo &BI = Infos[MCBB];
+    for (const MCDecodedInst &I : *MCBB) {
+      unsigned Uses, Defs;
+      getStatusFlagsUsesDefs(MII, I.Inst, Uses, Defs);
+      BI.Gen |= Uses & ~BI.Kill;
+      BI.Kill |= Defs;
+    }
+
+    // Also consider all the flags live when leaving the function, because the
+    // caller (or the tail callee) sees the register set.  That's also the
+    // case when some successors aren't known.
+    const MCInstrDesc &LastDesc = MII.get(MCBB->back().Inst.getOpcode());
+    unsigned NumSuccs = std::distance(MCBB->succ_begin(), MCBB->succ_end());
+    if (LastDesc.isReturn() || LastDesc.isIndirectBranch() ||
+        NumSuccs < (LastDesc.isConditionalBranch() ? 2u : 1u))
+      BI.ExitUses = X86::AllStatusFlags;
+  }
+
+  // Then, propagate the liveness backwards, until nothing changes.
+  bool Changed;
+  do {
+    Changed = false;
+    for (const MCBasicBlock *MCBB : MCF) {
+      unsigned SuccLiveIn = 0;
+      for (auto SI = MCBB->succ_begin(), SE = MCBB->succ_end(); SI != SE;
+           ++SI) {
+        auto It = Infos.find(*SI);
+        SuccLiveIn |=
+            It == Infos.end() ? X86::AllStatusFlags : It->second.LiveIn;
+      }
+      BlockInfo &BI = Infos[MCBB];
+      unsigned LiveIn = BI.Gen | ((SuccLiveIn | BI.ExitUses) & ~BI.Kill);
+      Changed |= LiveIn != BI.LiveIn || SuccLiveIn != BI.SuccLiveIn;
+      BI.LiveIn = LiveIn;
+      BI.SuccLiveIn = SuccLiveIn;
+    }
+  } while (Changed);
+
+  // Finally, walk each block backwards to find the flags live after each
+  // definition.
+  for (const MCBasicBlock *MCBB : MCF) {
+    const BlockInfo &BI = Infos[MCBB];
+    LiveInFlags[MCBB->getStartAddr()] = BI.LiveIn;
+    SuccLiveInFlags[MCBB->getStartAddr()] = BI.SuccLiveIn;
+
+    unsigned Live = BI.SuccLiveIn | BI.ExitUses;
+    for (auto II = MCBB->end(), IB = MCBB->begin(); II != IB;) {
+      --II;
+      unsigned Uses, Defs;
+      getStatusFlagsUsesDefs(MII, II->Inst, Uses, Defs);
+      if (Defs)
+        LiveFlagsAfterDef[II->Address] = Live;
+      Live = Uses | (Live & ~Defs);
+    }
+    DEBUG(dbgs() << "Status flags at " << utohexstr(MCBB->getStartAddr())
+                 << ": live-in 0x" << utohexstr(BI.LiveIn)
+                 << ", successors live-in 0x" << utohexstr(BI.SuccLiveIn)
+                 << "\n");
+  }
+  HasFlagsLiveness = true;
+}
+
+unsigned X86DCFunction::getLiveFlagsAfterDef(uint64_t Addr) const {
+  if (!HasFlagsLiveness)
+    return X86::AllStatusFlags;
+  auto It = LiveFlagsAfterDef.find(Addr);
+  if (It == LiveFlagsAfterDef.end())
+    return X86::AllStatusFlags;
+  return It->second;
+}
+
+unsigned X86DCFunction::getLiveInFlags(const MCBasicBlock &MCB) const {
+  if (!HasFlagsLiveness)
+    return 0;
+  return LiveInFlags.lookup(MCB.getStartAddr());
+}
+
+unsigned X86DCFunction::getSuccLiveInFlags(const MCBasicBlock &MCB) const {
+  if (!HasFlagsLiveness)
+    return 0;
+  return SuccLiveInFlags.lookup(MCB.getStartAddr());
+}
+
+AllocaInst *X86DCFunction::getOrCreateStatusFlagAlloca(X86::StatusFlag SF) {
+  AllocaInst *&SFA = StatusFlagAllocas[SF];
+  if (SFA)
+    return SFA;
+
+  // Initialize it from the incoming EFLAGS, like the register allocas.
+  AllocaInst *EFLAGSAlloca = getOrCreateRegAlloca(X86::EFLAGS);
+  BasicBlock *EntryBB = &getFunction()->getEntryBlock();
+  IRBuilder<> Builder(EntryBB, EntryBB->getTerminator()->getIterator());
+  SFA = Builder.CreateAlloca(Builder.getInt1Ty(), nullptr,
+                             X86::getStatusFlagName(SF));
+  Value *SFInit = llvm::extractBitsFromValue(Builder.saveIP(), SF, 1,
+                                             Builder.CreateLoad(EFLAGSAlloca));
+  SFInit->setName((X86::getStatusFlagName(SF) + "_init").str());
+  Builder.CreateStore(SFInit, SFA);
+  return SFA;
+}
@@ -11,17 +11,80 @@
 #define LLVM_LIB_TARGET_X86_DC_X86DCFUNCTION_H
 
 #include "X86DCModule.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/DC/DCFunction.h"
 
 namespace llvm {
 
+namespace X86 {
+enum StatusFlag {
+  CF = 0,
+  PF = 2,
+  AF = 4,
+  ZF = 6,
+  SF = 7,
+  OF = 11,
+  MAX_FLAGS = OF
+};
+
+/// The mask of all the status flags in EFLAGS.
+const unsigned AllStatusFlags =
+    (1 << CF) | (1 << PF) | (1 << AF) | (1 << ZF) | (1 << SF) | (1 << OF);
+
+StringRef getStatusFlagName(StatusFlag SF);
+} // end namespace X86
+
+class AllocaInst;
+class MCBasicBlock;
+
 class X86DCFunction final : public DCFunction {
+  /// Status flags liveness, computed over the MC CFG when enabled.
+  /// All the sets are masks of the status flags bits in EFLAGS.
+  /// @{
+  bool HasFlagsLiveness;
+  /// The flags live after each EFLAGS-defining instruction, by address.
+  DenseMap<uint64_t, unsigned> LiveFlagsAfterDef;
+  /// The flags live on entry to each basic block, by start address.
+  DenseMap<uint64_t, unsigned> LiveInFlags;
+  /// The flags live on entry to any successor of each basic block in the
+  /// function, by start address.
+  DenseMap<uint64_t, unsigned> SuccLiveInFlags;
+  /// @}
+
+  /// The i1 allocas holding the cross-block value of the status flags.
+  AllocaInst *StatusFlagAllocas[X86::MAX_FLAGS + 1];
+
+  void computeFlagsLiveness(const MCFunction &MCF);
+
 public:
   X86DCFunction(DCModule &DCM, const MCFunction &MCF);
 
   X86DCModule &getParent() {
     return static_cast<X86DCModule &>(DCFunction::getParent());
   }
+
+  /// Get the status flags that might be read after the EFLAGS-defining
+  /// instruction at \p Addr, before being redefined.  The others don't need
+  /// to be computed.
+  unsigned getLiveFlagsAfterDef(uint64_t Addr) const;
+
+  /// Get the status flags that are read in \p MCB, or one of its successors,
+  /// before being redefined.  The incoming value of these flags is available
+  /// in their status flag alloca.
+  unsigned getLiveInFlags(const MCBasicBlock &MCB) const;
+
+  /// Get the status flags that need to be stored to their status flag alloca
+  /// at the end of \p MCB, for its successors.
+  unsigned getSuccLiveInFlags(const MCBasicBlock &MCB) const;
+
+  /// Get the alloca, created in the entry block, that holds the cross-block
+  /// value of status flag \p SF, as an i1.  If there is none, create it.
+  ///
+  /// This mirrors the \p SF bit of the EFLAGS alloca, but only on entry to
+  /// the basic blocks where \p SF is live-in, letting flag values computed
+  /// in a block, often as icmps, be used directly in its successors.
+  AllocaInst *getOrCreateStatusFlagAlloca(X86::StatusFlag SF);
 };
 
 } // end namespace llvm
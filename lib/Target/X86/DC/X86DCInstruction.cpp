@@ -32,9 +32,11 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/TypeBuilder.h"
+#include "llvm/Support/MD5.h"
 #include <algorithm>
 
 #define GET_INSTR_SEMA
+#define GET_COMPILED_SEMA
 #include "X86GenSema.inc"
 using namespace llvm;
 
@@ -46,7 +48,23 @@ static MVT getSimpleVTForType(Type *Ty) {
 
 X86DCInstruction::X86DCInstruction(DCBasicBlock &DCB, const MCDecodedInst &MCI)
     : DCInstruction(DCB, MCI, X86::OpcodeToSemaIdx, X86::InstSemantics,
-                    X86::ConstantArray) {}
+                    X86::ConstantArray, X86::CompiledSemantics) {}
+
+uint64_t X86DCInstruction::getSemanticsHash() {
+  MD5 Hash;
+  Hash.update(makeArrayRef(
+      reinterpret_cast<const uint8_t *>(X86::InstSemantics),
+      sizeof(X86::InstSemantics)));
+  Hash.update(makeArrayRef(
+      reinterpret_cast<const uint8_t *>(X86::OpcodeToSemaIdx),
+      sizeof(X86::OpcodeToSemaIdx)));
+  Hash.update(makeArrayRef(
+      reinterpret_cast<const uint8_t *>(X86::ConstantArray),
+      sizeof(X86::ConstantArray)));
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  return Result.low();
+}
 
 bool X86DCInstruction::doesSubRegIndexClearSuper(unsigned SubRegIdx) {
   if (SubRegIdx == X86::sub_32bit)
@@ -235,7 +253,8 @@ bool X86DCInstruction::translateTargetInst() {
       // Finally, update EFLAGS.
       // FIXME: add support to X86DRS::updateEFLAGS for atomicrmw.
       Result = Builder.CreateBinOp(Opc, Old, Operand2);
-      getParent().updateEFLAGS(Result, /*DontUpdateCF=*/isINCDEC);
+      getParent().updateEFLAGS(Result, TheMCInst.Address,
+                               /*DontUpdateCF=*/isINCDEC);
       return true;
     } else if (Prefix == X86::REP_PREFIX) {
       unsigned SizeInBits = 0;
@@ -322,6 +341,8 @@ bool X86DCInstruction::translateTargetInst() {
   case X86::NOOP:
   case X86::NOOPW:
   case X86::NOOPL:
+  case X86::ENDBR32:
+  case X86::ENDBR64:
     return true;
 
   case X86::HLT:
@@ -386,7 +407,7 @@ bool X86DCInstruction::translateTargetOpcode(unsigned Opcode) {
   }
   case X86ISD::CMP: {
     Value *Op0 = getOperand(0), *Op1 = getOperand(1);
-    addResult(getParent().getEFLAGSforCMP(Op0, Op1));
+    addResult(getParent().getEFLAGSforCMP(Op0, Op1, TheMCInst.Address));
     break;
   }
   case X86ISD::BRCOND: {
@@ -405,6 +426,7 @@ bool X86DCInstruction::translateTargetOpcode(unsigned Opcode) {
     Value *Op0 = getOperand(0);
     translatePush(Builder.getInt64(TheMCInst.Address + TheMCInst.Size));
     insertCall(Op0);
+    getParent().clobberEFLAGS();
     break;
   }
   case X86ISD::SETCC: {
@@ -916,7 +938,7 @@ bool X86DCInstruction::translateImplicit(unsigned RegNo) {
   // FIXME: We need to understand instructions that define multiple values.
   Value *Def = getLastDef();
   assert(Def && "Nothing was defined in an instruction with implicit EFLAGS?");
-  getParent().updateEFLAGS(Def);
+  getParent().updateEFLAGS(Def, TheMCInst.Address);
   return true;
 }
 
@@ -1135,5 +1157,5 @@ void X86DCInstruction::translateCMPXCHG(unsigned MemOpType, unsigned CmpReg) {
   // Finally, update EFLAGS.
   // FIXME: add support to X86DRS::updateEFLAGS for cmpxchg.
   Value *Result = Builder.CreateBinOp(Instruction::Sub, CmpVal, OldVal);
-  getParent().updateEFLAGS(Result);
+  getParent().updateEFLAGS(Result, TheMCInst.Address);
 }
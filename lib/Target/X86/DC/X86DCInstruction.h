@@ -30,6 +30,9 @@ class X86DCInstruction final : public DCInstruction {
 public:
   X86DCInstruction(DCBasicBlock &DCB, const MCDecodedInst &MCI);
 
+  /// Get a hash of the X86 semantics tables.
+  static uint64_t getSemanticsHash();
+
   X86DCBasicBlock &getParent() {
     return static_cast<X86DCBasicBlock &>(DCInstruction::getParent());
   }
@@ -9,13 +9,17 @@
 
 #include "X86DCModule.h"
 #include "MCTargetDesc/X86MCTargetDesc.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/DC/DCRegisterSetDesc.h"
 #include "llvm/DC/DCTranslator.h"
+#include "llvm/DC/RegisterValueUtils.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Support/raw_ostream.h"
+#include <iterator>
 
 using namespace llvm;
 
@@ -150,3 +154,142 @@ void X86DCModule::insertExternalWrapperAsm(BasicBlock *InsertAtEnd,
 
   Builder.CreateCall(IA, {RegSet, ExternalFunc});
 }
+
+/// Get the SysV register that passes or returns a value of type \p Ty, out of
+/// the integer and SSE registers \p GPRs and \p XMMs, the first \p NumGPRs
+/// and \p NumXMMs of which are already used.  Returns 0 if the type isn't
+/// passed in a single register, or if there are no registers left.
+static unsigned getSysVRegFor(Type *Ty, ArrayRef<unsigned> GPRs,
+                              ArrayRef<unsigned> XMMs, unsigned &NumGPRs,
+                              unsigned &NumXMMs) {
+  if (Ty->isPointerTy() ||
+      (Ty->isIntegerTy() && Ty->getIntegerBitWidth() <= 64))
+    return NumGPRs < GPRs.size() ? GPRs[NumGPRs++] : 0;
+  if (Ty->isFloatTy() || Ty->isDoubleTy())
+    return NumXMMs < XMMs.size() ? XMMs[NumXMMs++] : 0;
+  return 0;
+}
+
+// FIXME: This only supports the prototypes where everything is passed and
+// returned in a single register: anything else goes through the trampoline.
+bool X86DCModule::insertExternalWrapperCall(BasicBlock *InsertAtEnd,
+                                            Value *ExternalFunc,
+                                            FunctionType *ExternalFuncTy,
+                                            Value *RegSet) {
+  static const unsigned ArgGPRs[] = {X86::RDI, X86::RSI, X86::RDX,
+                                     X86::RCX, X86::R8,  X86::R9};
+  static const unsigned ArgXMMs[] = {X86::XMM0, X86::XMM1, X86::XMM2,
+                                     X86::XMM3, X86::XMM4, X86::XMM5,
+                                     X86::XMM6, X86::XMM7};
+  static const unsigned RetGPRs[] = {X86::RAX};
+  static const unsigned RetXMMs[] = {X86::XMM0};
+
+  // Varargs functions also expect the number of SSE registers used in AL,
+  // and can read any argument register: leave them to the trampoline.
+  if (ExternalFuncTy->isVarArg())
+    return false;
+
+  SmallVector<unsigned, 8> ArgRegs;
+  unsigned NumGPRs = 0, NumXMMs = 0;
+  for (Type *ParamTy : ExternalFuncTy->params()) {
+    unsigned Reg = getSysVRegFor(ParamTy, ArgGPRs, ArgXMMs, NumGPRs, NumXMMs);
+    if (!Reg)
+      return false;
+    ArgRegs.push_back(Reg);
+  }
+
+  Type *RetTy = ExternalFuncTy->getReturnType();
+  unsigned RetReg = 0;
+  if (!RetTy->isVoidTy()) {
+    NumGPRs = NumXMMs = 0;
+    RetReg = getSysVRegFor(RetTy, RetGPRs, RetXMMs, NumGPRs, NumXMMs);
+    if (!RetReg)
+      return false;
+  }
+
+  IRBuilder<> Builder(InsertAtEnd);
+  auto &DCT = getTranslator();
+  auto &RSD = DCT.getRegSetDesc();
+
+  // Access the registers through their largest super-register in the regset.
+  auto getRegPtr = [&](unsigned Reg) {
+    Value *Idx[] = {Builder.getInt32(0), Builder.getInt32(RSD.RegOffsetsInSet
+                                             [RSD.RegLargestSupers[Reg]])};
+    return Builder.CreateInBoundsGEP(RegSet, Idx);
+  };
+  auto getReg = [&](unsigned Reg) -> Value * {
+    unsigned Super = RSD.RegLargestSupers[Reg];
+    Value *SuperVal = Builder.CreateLoad(getRegPtr(Reg));
+    if (Super == Reg)
+      return Builder.CreateBitCast(
+          SuperVal, Builder.getIntNTy(RSD.RegSizes[Reg]));
+    return extractSubRegFromSuper(Builder.saveIP(), DCT.getMRI(), Super, Reg,
+                                  SuperVal);
+  };
+  auto setReg = [&](unsigned Reg, Value *Val) {
+    unsigned Super = RSD.RegLargestSupers[Reg];
+    Value *Ptr = getRegPtr(Reg);
+    Type *SuperTy = cast<PointerType>(Ptr->getType())->getElementType();
+    if (Super != Reg) {
+      Value *SuperVal = Builder.CreateBitCast(
+          Builder.CreateLoad(Ptr), Builder.getIntNTy(RSD.RegSizes[Super]));
+      Val = recreateSuperRegFromSub(Builder.saveIP(), DCT.getMRI(), Super, Reg,
+                                    SuperVal, Val);
+    }
+    Builder.CreateStore(Builder.CreateBitCast(Val, SuperTy), Ptr);
+  };
+
+  // "Pop" the return address, like the trampoline does.
+  Value *RSP = getReg(X86::RSP);
+  setReg(X86::RIP, Builder.CreateLoad(Builder.CreateIntToPtr(
+                       RSP, Builder.getInt64Ty()->getPointerTo())));
+  setReg(X86::RSP, Builder.CreateAdd(RSP, Builder.getInt64(8)));
+
+  SmallVector<Value *, 8> Args;
+  for (unsigned i = 0, e = ArgRegs.size(); i != e; ++i) {
+    Type *ParamTy = ExternalFuncTy->getParamType(i);
+    Value *RegVal = getReg(ArgRegs[i]);
+    if (ParamTy->isPointerTy()) {
+      Args.push_back(Builder.CreateIntToPtr(RegVal, ParamTy));
+    } else if (ParamTy->isIntegerTy()) {
+      Args.push_back(Builder.CreateTrunc(RegVal, ParamTy));
+    } else {
+      unsigned Bits = ParamTy->getPrimitiveSizeInBits();
+      Args.push_back(Builder.CreateBitCast(
+          Builder.CreateTrunc(RegVal, Builder.getIntNTy(Bits)), ParamTy));
+    }
+  }
+
+  Value *Callee = Builder.CreateBitCast(ExternalFunc,
+                                        ExternalFuncTy->getPointerTo());
+  Value *Ret = Builder.CreateCall(ExternalFuncTy, Callee, Args);
+
+  // The upper bits of the return register are undefined: clear them.
+  if (RetReg) {
+    if (RetTy->isPointerTy())
+      Ret = Builder.CreatePtrToInt(Ret, Builder.getInt64Ty());
+    else if (!RetTy->isIntegerTy())
+      Ret = Builder.CreateBitCast(
+          Ret, Builder.getIntNTy(RetTy->getPrimitiveSizeInBits()));
+    setReg(RetReg,
+           Builder.CreateZExt(Ret, Builder.getIntNTy(RSD.RegSizes[RetReg])));
+  }
+  return true;
+}
+
+bool X86DCModule::getExternalWrapperRegs(
+    SmallVectorImpl<unsigned> &ReadRegs,
+    SmallVectorImpl<unsigned> &WrittenRegs) {
+  // This needs to match insertExternalWrapperAsm: the wrapper pops the return
+  // address, passes the SysV argument registers, and saves the return values.
+  static const unsigned ArgRegs[] = {
+      X86::RSP,  X86::RDI,  X86::RSI,  X86::RDX,  X86::RCX,  X86::R8,
+      X86::R9,   X86::XMM0, X86::XMM1, X86::XMM2, X86::XMM3, X86::XMM4,
+      X86::XMM5, X86::XMM6, X86::XMM7, X86::RAX};
+  static const unsigned RetRegs[] = {
+      X86::RIP,  X86::RSP,  X86::RAX,  X86::RDX,  X86::XMM0, X86::XMM1,
+      X86::XMM2, X86::XMM3, X86::XMM4, X86::XMM5, X86::XMM6, X86::XMM7};
+  ReadRegs.append(std::begin(ArgRegs), std::end(ArgRegs));
+  WrittenRegs.append(std::begin(RetRegs), std::end(RetRegs));
+  return true;
+}
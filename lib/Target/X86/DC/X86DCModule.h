@@ -18,6 +18,9 @@ class X86DCModule final : public DCModule {
 public:
   X86DCModule(DCTranslator &DCT, Module &M);
 
+  bool getExternalWrapperRegs(SmallVectorImpl<unsigned> &ReadRegs,
+                              SmallVectorImpl<unsigned> &WrittenRegs) override;
+
 protected:
   void insertCodeForInitRegSet(BasicBlock *InsertAtEnd, Value *RegSet,
                                Value *StackPtr, Value *StackSize, Value *ArgC,
@@ -28,6 +31,10 @@ protected:
 
   void insertExternalWrapperAsm(BasicBlock *InsertAtEnd, Value *ExternalFunc,
                                 Value *RegSet) override;
+
+  bool insertExternalWrapperCall(BasicBlock *InsertAtEnd, Value *ExternalFunc,
+                                 FunctionType *ExternalFuncTy,
+                                 Value *RegSet) override;
 };
 
 } // end namespace llvm
@@ -8,16 +8,22 @@
 //===----------------------------------------------------------------------===//
 
 #include "X86DCTranslator.h"
+#include "MCTargetDesc/X86MCTargetDesc.h"
 #include "X86DCBasicBlock.h"
 #include "X86DCFunction.h"
 #include "X86DCInstruction.h"
 #include "X86DCModule.h"
+#include "llvm/Support/CommandLine.h"
 
 #define GET_REGISTER_SEMA
 #include "X86GenSema.inc"
 
 using namespace llvm;
 
+namespace llvm {
+extern cl::opt<bool> EnableX86DCFlagsLiveness;
+}
+
 X86DCTranslator::X86DCTranslator(LLVMContext &Ctx, const DataLayout &DL,
                                  unsigned OptLevel, const MCInstrInfo &MII,
                                  const MCRegisterInfo &MRI,
@@ -29,6 +35,21 @@ X86DCTranslator::X86DCTranslator(LLVMContext &Ctx, const DataLayout &DL,
 
 X86DCTranslator::~X86DCTranslator() {}
 
+uint64_t X86DCTranslator::getSemanticsVersion() const {
+  static const uint64_t SemanticsHash = X86DCInstruction::getSemanticsHash();
+  // The flags liveness changes the translation as much as the tables do.
+  return EnableX86DCFlagsLiveness ? ~SemanticsHash : SemanticsHash;
+}
+
+unsigned X86DCTranslator::getStackPointerRegister() const { return X86::RSP; }
+
+unsigned X86DCTranslator::getEntryStackAlignment(unsigned &Offset) const {
+  // The SysV ABI aligns the stack to 16 bytes before the call, which then
+  // pushes the return address.
+  Offset = 8;
+  return 16;
+}
+
 std::unique_ptr<DCModule> X86DCTranslator::createDCModule(Module &M) {
   return make_unique<X86DCModule>(*this, M);
 }
@@ -22,6 +22,10 @@ public:
 
   virtual ~X86DCTranslator();
 
+  uint64_t getSemanticsVersion() const override;
+  unsigned getStackPointerRegister() const override;
+  unsigned getEntryStackAlignment(unsigned &Offset) const override;
+
 private:
   std::unique_ptr<DCModule> createDCModule(Module &M) override;
 
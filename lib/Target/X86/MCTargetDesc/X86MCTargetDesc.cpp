@@ -14,6 +14,7 @@
 #include "X86MCTargetDesc.h"
 #include "InstPrinter/X86ATTInstPrinter.h"
 #include "InstPrinter/X86IntelInstPrinter.h"
+#include "X86BaseInfo.h"
 #include "X86MCAsmInfo.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/MC/MCInstrAnalysis.h"
@@ -232,8 +233,212 @@ static MCRelocationInfo *createX86MCRelocationInfo(const Triple &TheTriple,
   return llvm::createMCRelocationInfo(TheTriple, Ctx);
 }
 
+namespace {
+class X86MCInstrAnalysis : public MCInstrAnalysis {
+public:
+  X86MCInstrAnalysis(const MCInstrInfo *Info) : MCInstrAnalysis(Info) {}
+
+  bool evaluateJumpTable(ArrayRef<MCInst> Insts, ArrayRef<uint64_t> Addrs,
+                         JumpTable &JT) const override;
+
+private:
+  bool definesReg(const MCInst &Inst, unsigned Reg) const;
+  int findDef(ArrayRef<MCInst> Insts, int Before, unsigned Reg) const;
+  bool evaluateJumpTableBound(ArrayRef<MCInst> Insts, int LoadIdx,
+                              unsigned IdxReg, JumpTable &JT) const;
+};
+} // end anonymous namespace
+
+/// The maximum number of entries of a recovered jump table.  Larger bounds
+/// are more likely to come from a misidentified check than from a switch.
+static const uint64_t MaxJumpTableEntries = 4096;
+
+static unsigned getX86Reg64(unsigned Reg) {
+  return Reg ? getX86SubSuperRegisterOrZero(Reg, 64) : 0;
+}
+
+/// Return true if \p Inst might modify the 64-bit register \p Reg.
+bool X86MCInstrAnalysis::definesReg(const MCInst &Inst, unsigned Reg) const {
+  const MCInstrDesc &Desc = Info->get(Inst.getOpcode());
+  if (Desc.isCall())
+    return true;
+  for (unsigned i = 0, e = Desc.getNumDefs(); i != e; ++i)
+    if (Inst.getOperand(i).isReg() &&
+        getX86Reg64(Inst.getOperand(i).getReg()) == Reg)
+      return true;
+  if (const MCPhysReg *ImpDefs = Desc.getImplicitDefs())
+    for (; *ImpDefs; ++ImpDefs)
+      if (getX86Reg64(*ImpDefs) == Reg)
+        return true;
+  return false;
+}
+
+/// Find the last instruction before index \p Before that defines \p Reg.
+/// Return its index, or -1 if there is none.
+int X86MCInstrAnalysis::findDef(ArrayRef<MCInst> Insts, int Before,
+                                unsigned Reg) const {
+  Reg = getX86Reg64(Reg);
+  if (!Reg)
+    return -1;
+  for (int i = Before - 1; i >= 0; --i)
+    if (definesReg(Insts[i], Reg))
+      return i;
+  return -1;
+}
+
+bool X86MCInstrAnalysis::evaluateJumpTable(ArrayRef<MCInst> Insts,
+                                           ArrayRef<uint64_t> Addrs,
+                                           JumpTable &JT) const {
+  if (Insts.empty() || Addrs.size() != Insts.size() + 1)
+    return false;
+  const int BrIdx = Insts.size() - 1;
+  const MCInst &Br = Insts[BrIdx];
+
+  switch (Br.getOpcode()) {
+  default:
+    return false;
+
+  // Absolute tables:
+  //   jmp *Table(,%Idx,8)
+  case X86::JMP64m:
+  case X86::JMP32m: {
+    const unsigned EntrySize = Br.getOpcode() == X86::JMP64m ? 8 : 4;
+    const MCOperand &Disp = Br.getOperand(X86::AddrDisp);
+    if (Br.getOperand(X86::AddrBaseReg).getReg() ||
+        Br.getOperand(X86::AddrSegmentReg).getReg() ||
+        Br.getOperand(X86::AddrScaleAmt).getImm() != EntrySize ||
+        !Disp.isImm())
+      return false;
+    JT.Addr = EntrySize == 8 ? uint64_t(Disp.getImm())
+                             : uint64_t(uint32_t(Disp.getImm()));
+    JT.EntrySize = EntrySize;
+    JT.IsRelative = false;
+    return evaluateJumpTableBound(Insts, BrIdx,
+                                  Br.getOperand(X86::AddrIndexReg).getReg(),
+                                  JT);
+  }
+
+  // PIC tables, with entries relative to the table:
+  //   leaq Table(%rip), %Base
+  //   movslq (%Base,%Idx,4), %Entry
+  //   addq %Base, %Entry
+  //   jmpq *%Entry
+  case X86::JMP64r: {
+    int AddIdx = findDef(Insts, BrIdx, Br.getOperand(0).getReg());
+    if (AddIdx < 0 || Insts[AddIdx].getOpcode() != X86::ADD64rr)
+      return false;
+    const MCInst &Add = Insts[AddIdx];
+
+    // The add is commutative: try both operand orders.
+    for (unsigned EntryOp : {1, 2}) {
+      unsigned EntryReg = Add.getOperand(EntryOp).getReg();
+      unsigned BaseReg = Add.getOperand(3 - EntryOp).getReg();
+
+      int LoadIdx = findDef(Insts, AddIdx, EntryReg);
+      int LeaIdx = findDef(Insts, AddIdx, BaseReg);
+      if (LoadIdx < 0 || LeaIdx < 0 || LeaIdx > LoadIdx)
+        continue;
+
+      const MCInst &Load = Insts[LoadIdx];
+      if (Load.getOpcode() != X86::MOVSX64rm32 ||
+          Load.getOperand(0).getReg() != EntryReg ||
+          Load.getOperand(1 + X86::AddrBaseReg).getReg() != BaseReg ||
+          Load.getOperand(1 + X86::AddrScaleAmt).getImm() != 4 ||
+          !Load.getOperand(1 + X86::AddrDisp).isImm() ||
+          Load.getOperand(1 + X86::AddrDisp).getImm() != 0 ||
+          Load.getOperand(1 + X86::AddrSegmentReg).getReg())
+        continue;
+
+      const MCInst &Lea = Insts[LeaIdx];
+      if (Lea.getOpcode() != X86::LEA64r ||
+          Lea.getOperand(0).getReg() != BaseReg ||
+          Lea.getOperand(1 + X86::AddrBaseReg).getReg() != X86::RIP ||
+          Lea.getOperand(1 + X86::AddrIndexReg).getReg() ||
+          !Lea.getOperand(1 + X86::AddrDisp).isImm() ||
+          Lea.getOperand(1 + X86::AddrSegmentReg).getReg())
+        continue;
+
+      JT.Addr = Addrs[LeaIdx + 1] + Lea.getOperand(1 + X86::AddrDisp).getImm();
+      JT.EntrySize = 4;
+      JT.IsRelative = true;
+      return evaluateJumpTableBound(
+          Insts, LoadIdx, Load.getOperand(1 + X86::AddrIndexReg).getReg(), JT);
+    }
+    return false;
+  }
+  }
+}
+
+/// Find the check bounding \p IdxReg, used by the table load at \p LoadIdx:
+///   cmp $Max, %Idx
+///   ja Default
+/// possibly followed by copies of the index, and set the number of entries.
+bool X86MCInstrAnalysis::evaluateJumpTableBound(ArrayRef<MCInst> Insts,
+                                                int LoadIdx, unsigned IdxReg,
+                                                JumpTable &JT) const {
+  unsigned Idx = getX86Reg64(IdxReg);
+  if (!Idx)
+    return false;
+  // Whether the index used by the load is 64-bit wide, and needs a 64-bit
+  // check, unless it was zero-extended from the checked register.
+  const bool IdxIs64 = Idx == IdxReg;
+  bool IdxIsZExt = false;
+
+  for (int i = LoadIdx - 1; i >= 0; --i) {
+    const MCInst &Inst = Insts[i];
+    switch (Inst.getOpcode()) {
+    case X86::MOV32rr:
+    case X86::MOV64rr:
+      if (getX86Reg64(Inst.getOperand(0).getReg()) != Idx)
+        continue;
+      Idx = getX86Reg64(Inst.getOperand(1).getReg());
+      IdxIsZExt |= Inst.getOpcode() == X86::MOV32rr;
+      continue;
+
+    case X86::JA_1:
+    case X86::JA_4:
+    case X86::JAE_1:
+    case X86::JAE_4: {
+      if (i == 0)
+        return false;
+      const MCInst &Cmp = Insts[i - 1];
+      bool CmpIs64;
+      switch (Cmp.getOpcode()) {
+      default:
+        return false;
+      case X86::CMP32ri8:
+      case X86::CMP32ri:
+        CmpIs64 = false;
+        break;
+      case X86::CMP64ri8:
+      case X86::CMP64ri32:
+        CmpIs64 = true;
+        break;
+      }
+      if (getX86Reg64(Cmp.getOperand(0).getReg()) != Idx ||
+          !Cmp.getOperand(1).isImm())
+        return false;
+      if (IdxIs64 && !CmpIs64 && !IdxIsZExt)
+        return false;
+      int64_t Max = Cmp.getOperand(1).getImm();
+      if (Max < 0)
+        return false;
+      bool IsJA = Inst.getOpcode() == X86::JA_1 || Inst.getOpcode() == X86::JA_4;
+      JT.NumEntries = IsJA ? Max + 1 : Max;
+      return JT.NumEntries != 0 && JT.NumEntries <= MaxJumpTableEntries;
+    }
+
+    default:
+      if (definesReg(Inst, Idx))
+        return false;
+      continue;
+    }
+  }
+  return false;
+}
+
 static MCInstrAnalysis *createX86MCInstrAnalysis(const MCInstrInfo *Info) {
-  return new MCInstrAnalysis(Info);
+  return new X86MCInstrAnalysis(Info);
 }
 
 // Force static initialization.
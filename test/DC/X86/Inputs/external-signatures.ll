@@ -0,0 +1,3 @@
+; The prototypes of the external functions called by the test inputs.
+
+declare i32 @external_func(i8*, i32, double)
@@ -170,7 +170,7 @@ movl	%r15d, 2(%r11,%rbx,2)
 # CHECK-NEXT: call void @llvm.dc.setreg{{.*}} !"RIP")
 # CHECK-NEXT: [[EAX_0:%.+]] = call i32 @llvm.dc.getreg.i32(metadata !"EAX")
 # CHECK-NEXT: [[V1:%.+]] = inttoptr i64 2 to i32*
-# CHECK-NEXT: store i32 [[EAX_0]], i32* [[V1]], align 1
+# CHECK-NEXT: store i32 [[EAX_0]], i32* [[V1]], align 2
 movabsl	%eax, 2
 
 ## MOV32ri
@@ -14,7 +14,7 @@
 # CHECK-NEXT: [[V4:%.+]] = add i64 [[V3]], 2
 # CHECK-NEXT: [[V5:%.+]] = add i64 [[R11_0]], [[V4]]
 # CHECK-NEXT: [[V6:%.+]] = inttoptr i64 [[V5]] to <4 x float>*
-# CHECK-NEXT: store <4 x float> [[V2]], <4 x float>* [[V6]], align 1
+# CHECK-NEXT: store <4 x float> [[V2]], <4 x float>* [[V6]], align 16
 movaps	%xmm13, 2(%r11,%rbx,2)
 
 ## MOVAPSrm
@@ -28,7 +28,7 @@ movaps	%xmm13, 2(%r11,%rbx,2)
 # CHECK-NEXT: [[V2:%.+]] = add i64 [[V1]], 2
 # CHECK-NEXT: [[V3:%.+]] = add i64 [[RBX_0]], [[V2]]
 # CHECK-NEXT: [[V4:%.+]] = inttoptr i64 [[V3]] to <4 x float>*
-# CHECK-NEXT: [[V5:%.+]] = load <4 x float>, <4 x float>* [[V4]], align 1
+# CHECK-NEXT: [[V5:%.+]] = load <4 x float>, <4 x float>* [[V4]], align 16
 # CHECK-NEXT: [[V6:%.+]] = bitcast <4 x float> [[V5]] to i128
 # CHECK-NEXT: call void @llvm.dc.setreg.i128(i128 [[V6]], metadata !"XMM8")
 movaps	2(%rbx,%r14,2), %xmm8
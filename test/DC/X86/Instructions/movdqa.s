@@ -14,7 +14,7 @@
 # CHECK-NEXT: [[V4:%.+]] = add i64 [[V3]], 2
 # CHECK-NEXT: [[V5:%.+]] = add i64 [[R11_0]], [[V4]]
 # CHECK-NEXT: [[V6:%.+]] = inttoptr i64 [[V5]] to <2 x i64>*
-# CHECK-NEXT: store <2 x i64> [[V2]], <2 x i64>* [[V6]], align 1
+# CHECK-NEXT: store <2 x i64> [[V2]], <2 x i64>* [[V6]], align 16
 movdqa	%xmm13, 2(%r11,%rbx,2)
 
 ## MOVDQArm
@@ -28,7 +28,7 @@ movdqa	%xmm13, 2(%r11,%rbx,2)
 # CHECK-NEXT: [[V2:%.+]] = add i64 [[V1]], 2
 # CHECK-NEXT: [[V3:%.+]] = add i64 [[RBX_0]], [[V2]]
 # CHECK-NEXT: [[V4:%.+]] = inttoptr i64 [[V3]] to <2 x i64>*
-# CHECK-NEXT: [[V5:%.+]] = load <2 x i64>, <2 x i64>* [[V4]], align 1
+# CHECK-NEXT: [[V5:%.+]] = load <2 x i64>, <2 x i64>* [[V4]], align 16
 # CHECK-NEXT: [[V6:%.+]] = bitcast <2 x i64> [[V5]] to i128
 # CHECK-NEXT: call void @llvm.dc.setreg.i128(i128 [[V6]], metadata !"XMM8")
 movdqa	2(%rbx,%r14,2), %xmm8
@@ -12,7 +12,7 @@
 # CHECK-NEXT: [[V2:%.+]] = add i64 [[V1]], 2
 # CHECK-NEXT: [[V3:%.+]] = add i64 [[R11_0]], [[V2]]
 # CHECK-NEXT: [[V4:%.+]] = inttoptr i64 [[V3]] to i64*
-# CHECK-NEXT: store i64 [[R13_0]], i64* [[V4]], align 1
+# CHECK-NEXT: store i64 [[R13_0]], i64* [[V4]], align 1, !nontemporal !{{[0-9]+}}
 movntiq	%r13, 2(%r11,%rbx,2)
 
 ## MOVNTImr
@@ -27,7 +27,7 @@ movntiq	%r13, 2(%r11,%rbx,2)
 # CHECK-NEXT: [[V2:%.+]] = add i64 [[V1]], 2
 # CHECK-NEXT: [[V3:%.+]] = add i64 [[R11_0]], [[V2]]
 # CHECK-NEXT: [[V4:%.+]] = inttoptr i64 [[V3]] to i32*
-# CHECK-NEXT: store i32 [[R15D_0]], i32* [[V4]], align 1
+# CHECK-NEXT: store i32 [[R15D_0]], i32* [[V4]], align 1, !nontemporal !{{[0-9]+}}
 movntil	%r15d, 2(%r11,%rbx,2)
 
 retq
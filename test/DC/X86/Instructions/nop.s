@@ -21,4 +21,11 @@ nopl	2(%r11,%rbx,2)
 # CHECK-NEXT: call void @llvm.dc.setreg{{.*}} !"RIP")
 nopw	2(%r11,%rbx,2)
 
+## ENDBR64
+# CHECK-LABEL: call void @llvm.dc.startinst
+# CHECK-NEXT: [[RIP_0:%.+]] = call i64 @llvm.dc.getreg.i64(metadata !"RIP")
+# CHECK-NEXT: [[V0:%.+]] = add i64 [[RIP_0]], 4
+# CHECK-NEXT: call void @llvm.dc.setreg{{.*}} !"RIP")
+endbr64
+
 retq
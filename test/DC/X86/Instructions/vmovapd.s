@@ -14,7 +14,7 @@
 # CHECK-NEXT: [[V4:%.+]] = add i64 [[V3]], 2
 # CHECK-NEXT: [[V5:%.+]] = add i64 [[R11_0]], [[V4]]
 # CHECK-NEXT: [[V6:%.+]] = inttoptr i64 [[V5]] to <4 x double>*
-# CHECK-NEXT: store <4 x double> [[V2]], <4 x double>* [[V6]], align 1
+# CHECK-NEXT: store <4 x double> [[V2]], <4 x double>* [[V6]], align 32
 vmovapd	%ymm13, 2(%r11,%rbx,2)
 
 ## VMOVAPDYrm
@@ -28,7 +28,7 @@ vmovapd	%ymm13, 2(%r11,%rbx,2)
 # CHECK-NEXT: [[V2:%.+]] = add i64 [[V1]], 2
 # CHECK-NEXT: [[V3:%.+]] = add i64 [[RBX_0]], [[V2]]
 # CHECK-NEXT: [[V4:%.+]] = inttoptr i64 [[V3]] to <4 x double>*
-# CHECK-NEXT: [[V5:%.+]] = load <4 x double>, <4 x double>* [[V4]], align 1
+# CHECK-NEXT: [[V5:%.+]] = load <4 x double>, <4 x double>* [[V4]], align 32
 # CHECK-NEXT: [[V6:%.+]] = bitcast <4 x double> [[V5]] to i256
 # CHECK-NEXT: call void @llvm.dc.setreg.i256(i256 [[V6]], metadata !"YMM8")
 vmovapd	2(%rbx,%r14,2), %ymm8
@@ -63,7 +63,7 @@ vmovapd	%ymm9, %ymm8
 # CHECK-NEXT: [[V4:%.+]] = add i64 [[V3]], 2
 # CHECK-NEXT: [[V5:%.+]] = add i64 [[R11_0]], [[V4]]
 # CHECK-NEXT: [[V6:%.+]] = inttoptr i64 [[V5]] to <2 x double>*
-# CHECK-NEXT: store <2 x double> [[V2]], <2 x double>* [[V6]], align 1
+# CHECK-NEXT: store <2 x double> [[V2]], <2 x double>* [[V6]], align 16
 vmovapd	%xmm13, 2(%r11,%rbx,2)
 
 ## VMOVAPDrm
@@ -77,7 +77,7 @@ vmovapd	%xmm13, 2(%r11,%rbx,2)
 # CHECK-NEXT: [[V2:%.+]] = add i64 [[V1]], 2
 # CHECK-NEXT: [[V3:%.+]] = add i64 [[RBX_0]], [[V2]]
 # CHECK-NEXT: [[V4:%.+]] = inttoptr i64 [[V3]] to <2 x double>*
-# CHECK-NEXT: [[V5:%.+]] = load <2 x double>, <2 x double>* [[V4]], align 1
+# CHECK-NEXT: [[V5:%.+]] = load <2 x double>, <2 x double>* [[V4]], align 16
 # CHECK-NEXT: [[V6:%.+]] = bitcast <2 x double> [[V5]] to i128
 # CHECK-NEXT: call void @llvm.dc.setreg.i128(i128 [[V6]], metadata !"XMM8")
 vmovapd	2(%rbx,%r14,2), %xmm8
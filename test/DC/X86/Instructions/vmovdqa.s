@@ -14,7 +14,7 @@
 # CHECK-NEXT: [[V4:%.+]] = add i64 [[V3]], 2
 # CHECK-NEXT: [[V5:%.+]] = add i64 [[R11_0]], [[V4]]
 # CHECK-NEXT: [[V6:%.+]] = inttoptr i64 [[V5]] to <4 x i64>*
-# CHECK-NEXT: store <4 x i64> [[V2]], <4 x i64>* [[V6]], align 1
+# CHECK-NEXT: store <4 x i64> [[V2]], <4 x i64>* [[V6]], align 32
 vmovdqa	%ymm13, 2(%r11,%rbx,2)
 
 ## VMOVDQAYrm
@@ -28,7 +28,7 @@ vmovdqa	%ymm13, 2(%r11,%rbx,2)
 # CHECK-NEXT: [[V2:%.+]] = add i64 [[V1]], 2
 # CHECK-NEXT: [[V3:%.+]] = add i64 [[RBX_0]], [[V2]]
 # CHECK-NEXT: [[V4:%.+]] = inttoptr i64 [[V3]] to <4 x i64>*
-# CHECK-NEXT: [[V5:%.+]] = load <4 x i64>, <4 x i64>* [[V4]], align 1
+# CHECK-NEXT: [[V5:%.+]] = load <4 x i64>, <4 x i64>* [[V4]], align 32
 # CHECK-NEXT: [[V6:%.+]] = bitcast <4 x i64> [[V5]] to i256
 # CHECK-NEXT: call void @llvm.dc.setreg.i256(i256 [[V6]], metadata !"YMM8")
 vmovdqa	2(%rbx,%r14,2), %ymm8
@@ -63,7 +63,7 @@ vmovdqa	%ymm9, %ymm8
 # CHECK-NEXT: [[V4:%.+]] = add i64 [[V3]], 2
 # CHECK-NEXT: [[V5:%.+]] = add i64 [[R11_0]], [[V4]]
 # CHECK-NEXT: [[V6:%.+]] = inttoptr i64 [[V5]] to <2 x i64>*
-# CHECK-NEXT: store <2 x i64> [[V2]], <2 x i64>* [[V6]], align 1
+# CHECK-NEXT: store <2 x i64> [[V2]], <2 x i64>* [[V6]], align 16
 vmovdqa	%xmm13, 2(%r11,%rbx,2)
 
 ## VMOVDQArm
@@ -77,7 +77,7 @@ vmovdqa	%xmm13, 2(%r11,%rbx,2)
 # CHECK-NEXT: [[V2:%.+]] = add i64 [[V1]], 2
 # CHECK-NEXT: [[V3:%.+]] = add i64 [[RBX_0]], [[V2]]
 # CHECK-NEXT: [[V4:%.+]] = inttoptr i64 [[V3]] to <2 x i64>*
-# CHECK-NEXT: [[V5:%.+]] = load <2 x i64>, <2 x i64>* [[V4]], align 1
+# CHECK-NEXT: [[V5:%.+]] = load <2 x i64>, <2 x i64>* [[V4]], align 16
 # CHECK-NEXT: [[V6:%.+]] = bitcast <2 x i64> [[V5]] to i128
 # CHECK-NEXT: call void @llvm.dc.setreg.i128(i128 [[V6]], metadata !"XMM8")
 vmovdqa	2(%rbx,%r14,2), %xmm8
@@ -14,7 +14,7 @@
 # CHECK-NEXT: [[V4:%.+]] = add i64 [[V3]], 2
 # CHECK-NEXT: [[V5:%.+]] = add i64 [[R11_0]], [[V4]]
 # CHECK-NEXT: [[V6:%.+]] = inttoptr i64 [[V5]] to <8 x float>*
-# CHECK-NEXT: store <8 x float> [[V2]], <8 x float>* [[V6]], align 1
+# CHECK-NEXT: store <8 x float> [[V2]], <8 x float>* [[V6]], align 32, !nontemporal !{{[0-9]+}}
 vmovntps	%ymm13, 2(%r11,%rbx,2)
 
 ## VMOVNTPSmr
@@ -31,7 +31,7 @@ vmovntps	%ymm13, 2(%r11,%rbx,2)
 # CHECK-NEXT: [[V4:%.+]] = add i64 [[V3]], 2
 # CHECK-NEXT: [[V5:%.+]] = add i64 [[R11_0]], [[V4]]
 # CHECK-NEXT: [[V6:%.+]] = inttoptr i64 [[V5]] to <4 x float>*
-# CHECK-NEXT: store <4 x float> [[V2]], <4 x float>* [[V6]], align 1
+# CHECK-NEXT: store <4 x float> [[V2]], <4 x float>* [[V6]], align 16, !nontemporal !{{[0-9]+}}
 vmovntps	%xmm13, 2(%r11,%rbx,2)
 
 retq
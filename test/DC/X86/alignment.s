@@ -0,0 +1,34 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec -O1 -dc-assume-abi-stack-alignment %t.o | FileCheck %s
+#RUN: llvm-dec -O1 %t.o | FileCheck %s --check-prefix=NOASSUME
+#RUN: llvm-dec -O1 -dc-assume-abi-stack-alignment %t.o | opt -verify -disable-output
+#RUN: llvm-dec -dc-assume-abi-stack-alignment %t.o | opt -verify -disable-output
+
+# Test that the alignment of the memory accesses is inferred from the
+# address computation, and from the ABI alignment of the incoming stack
+# pointer, when it's assumed.
+
+f:
+mov qword ptr [rsp - 8], rdi
+mov rax, qword ptr [rsp]
+and rdi, -32
+mov rax, qword ptr [rdi]
+ret
+
+# CHECK-LABEL: define void @fn_0(
+# CHECK: [[AND:%[0-9]+]] = and i64 %RSP_init, 15
+# CHECK: [[CMP:%[0-9]+]] = icmp eq i64 [[AND]], 8
+# CHECK: call void @llvm.assume(i1 [[CMP]])
+# CHECK-LABEL: bb_0:
+# CHECK: store i64 %RDI_init, i64* {{%[0-9]+}}, align 16
+# CHECK: load i64, i64* {{%[0-9]+}}, align 8
+# CHECK: load i64, i64* {{%[0-9]+}}, align 32
+# CHECK: br label %exit_fn_0
+
+# NOASSUME-LABEL: define void @fn_0(
+# NOASSUME-NOT: @llvm.assume
+# NOASSUME-LABEL: bb_0:
+# NOASSUME: store i64 %RDI_init, i64* {{%[0-9]+}}, align 1
+# NOASSUME: load i64, i64* {{%[0-9]+}}, align 1
+# NOASSUME: load i64, i64* {{%[0-9]+}}, align 32
+# NOASSUME: br label %exit_fn_0
@@ -0,0 +1,30 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec %t.o > %t.compiled.ll
+#RUN: llvm-dec -dc-interpret-semantics %t.o > %t.interpreted.ll
+#RUN: diff %t.compiled.ll %t.interpreted.ll
+#RUN: FileCheck %s < %t.compiled.ll
+
+# Test that the compiled semantics translate instructions exactly like the
+# semantics tables interpreter: register classes, immediates, constants,
+# complex patterns (addressing modes), and implicit defs (EFLAGS).
+
+.global _main
+_main:
+mov rax, rdi
+add rax, 42
+sub rax, qword ptr [rsi + 8*rdx + 16]
+lea rcx, [rax + rax*4]
+shl rcx, 3
+and ecx, 255
+cmp rcx, rdi
+cmovl rax, rcx
+pshufd xmm0, xmm1, 27
+ret
+
+# CHECK-LABEL: define void @fn_0(
+# CHECK: add i64 {{.*}}, 42
+# CHECK: sub i64
+# CHECK: shl i64 {{.*}}, 3
+# CHECK: and i32 {{.*}}, 255
+# CHECK: select i1
+# CHECK: shufflevector <4 x i32>
@@ -0,0 +1,37 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec -dc-x86-flags-liveness %t.o | FileCheck %s
+#RUN: llvm-dec -dc-x86-flags-liveness %t.o | opt -verify -disable-output
+#RUN: llvm-dec -O1 -dc-x86-flags-liveness %t.o | opt -verify -disable-output
+
+# Test that the status flags that are redefined before being read aren't
+# computed, and that the live ones are passed to the successors as i1 values.
+
+_main:
+add rax, rdi
+cmp rdi, 42
+jmp Lnext
+Lnext:
+sete al
+cmp rdi, 0
+ret
+
+# CHECK-LABEL: entry_fn_0:
+# CHECK: %ZF = alloca i1
+
+# CHECK-LABEL: bb_0:
+# CHECK-NOT: with.overflow
+# CHECK-NOT: ctpop
+# CHECK: [[ZF:%ZF_[0-9]+]] = icmp eq i64 {{%[0-9]+}}, 0
+# CHECK-NOT: with.overflow
+# CHECK-NOT: ctpop
+# CHECK: store i1 [[ZF]], i1* %ZF
+# CHECK: br label %bb_9
+
+# CHECK-LABEL: bb_9:
+# CHECK: [[ZFIN:%ZF_[0-9]+]] = load i1, i1* %ZF
+# CHECK: zext i1 [[ZFIN]] to i8
+## EFLAGS is live out of the function: all the flags are computed.
+# CHECK: @llvm.ssub.with.overflow.i64
+# CHECK: @llvm.usub.with.overflow.i64
+# CHECK: @llvm.ctpop.i8
+# CHECK: br label %exit_fn_0
@@ -0,0 +1,46 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec %t.o | FileCheck %s
+#RUN: llvm-dec %t.o | opt -verify -disable-output
+
+# Test that an indirect branch through a bounded jump table is lowered to a
+# switch over the table targets, falling back to the dispatcher.
+
+_main:
+  cmp edi, 2
+  ja LBB_default
+  mov eax, edi
+  lea rcx, [rip + LJTI0_0]
+  movsxd rax, dword ptr [rcx + 4*rax]
+  add rax, rcx
+  jmp rax
+LBB_0:
+  mov eax, 10
+  ret
+LBB_1:
+  mov eax, 11
+  ret
+LBB_2:
+  mov eax, 12
+  ret
+LBB_default:
+  xor eax, eax
+  ret
+  .p2align 2
+LJTI0_0:
+  .long LBB_0-LJTI0_0
+  .long LBB_1-LJTI0_0
+  .long LBB_2-LJTI0_0
+
+# CHECK-LABEL: define void @fn_0(
+# CHECK-LABEL: bb_5:
+# CHECK: switch i64 %{{[0-9A-Za-z_]+}}, label %dispatch_15 [
+# CHECK-NEXT: i64 23, label %bb_17
+# CHECK-NEXT: i64 29, label %bb_1D
+# CHECK-NEXT: i64 35, label %bb_23
+# CHECK-NEXT: ]
+# CHECK-DAG: bb_17:
+# CHECK-DAG: bb_1D:
+# CHECK-DAG: bb_23:
+# CHECK: dispatch_15:
+# CHECK: call i8* @llvm.dc.translate.at(
+# CHECK: br label %exit_fn_0
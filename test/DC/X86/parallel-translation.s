@@ -0,0 +1,46 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec -threads=1 %t.o > %t.1.ll
+#RUN: llvm-dec -threads=3 %t.o > %t.3.ll
+#RUN: diff %t.1.ll %t.3.ll
+#RUN: FileCheck %s < %t.3.ll
+
+# Test that translating functions on several threads links all of them back,
+# in an order that doesn't depend on the number of threads.
+
+.global _main
+_main:
+call Lf1
+call Lf2
+ret
+
+Lf1:
+mov rax, 1
+call Lf3
+ret
+
+Lf2:
+mov rax, 2
+call Lf3
+ret
+
+Lf3:
+add rax, 3
+ret
+
+# CHECK-LABEL: define void @fn_0(%regset* noalias nocapture) {
+# CHECK: call void @fn_B(%regset* %0)
+# CHECK: call void @fn_18(%regset* %0)
+
+# CHECK-LABEL: define void @fn_B(%regset* noalias nocapture) {
+# CHECK: store i64 1, i64* %RAX
+# CHECK: call void @fn_25(%regset* %0)
+
+# CHECK-LABEL: define void @fn_18(%regset* noalias nocapture) {
+# CHECK: store i64 2, i64* %RAX
+# CHECK: call void @fn_25(%regset* %0)
+
+# CHECK-LABEL: define void @fn_25(%regset* noalias nocapture) {
+# CHECK: add i64
+
+# CHECK-LABEL: define i32 @main(i32, i8**) {
+# CHECK: call void @fn_0(%regset* %3)
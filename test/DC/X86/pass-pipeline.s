@@ -0,0 +1,30 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec -O1 %t.o | FileCheck %s --check-prefix=NOCSE
+#RUN: llvm-dec -O1 -dc-passes=early-cse %t.o | FileCheck %s --check-prefix=CSE
+#RUN: llvm-dec -O1 -dc-module-passes='function(early-cse)' %t.o | FileCheck %s --check-prefix=CSE
+#RUN: llvm-dec -O3 -dc-passes= %t.o | FileCheck %s --check-prefix=NOCSE
+#RUN: not llvm-dec -dc-passes=foo %t.o 2>&1 | FileCheck %s --check-prefix=ERROR
+#RUN: not llvm-dec -dc-module-passes='function(foo)' %t.o 2>&1 | FileCheck %s --check-prefix=MODULE-ERROR
+#RUN: llvm-dec -O2 %t.o | opt -verify -disable-output
+#RUN: llvm-dec -O3 %t.o | opt -verify -disable-output
+#RUN: llvm-dec -O3 -dc-promote-regset %t.o | opt -verify -disable-output
+
+# Test that -dc-passes and -dc-module-passes replace the default optimization
+# pipelines, and that the default pipelines are valid.
+
+f:
+push rax
+ret
+
+# NOCSE-LABEL: bb_0:
+# NOCSE: sub i64 %RSP_init, 8
+# NOCSE: sub i64 %RSP_init, 8
+# NOCSE: br label %exit_fn_0
+
+# CSE-LABEL: bb_0:
+# CSE: sub i64 %RSP_init, 8
+# CSE-NOT: sub i64 %RSP_init, 8
+# CSE: br label %exit_fn_0
+
+# ERROR: Unable to parse function pass pipeline 'foo'
+# MODULE-ERROR: Unable to parse module pass pipeline 'function(foo)'
@@ -0,0 +1,39 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec -O1 -dc-promote-regset %t.o | FileCheck %s
+#RUN: llvm-dec -O1 -dc-promote-regset %t.o | opt -verify -disable-output
+#RUN: llvm-dec -dc-promote-regset %t.o | opt -verify -disable-output
+
+# Test that translated functions calling each other directly pass the
+# registers as values, and keep the regset ABI in a wrapper.
+
+.global _main
+_main:
+mov rdi, 42
+call Lcallee
+add rax, 10
+ret
+
+Lcallee:
+mov rax, rdi
+ret
+
+# CHECK-LABEL: define void @fn_0(%regset* noalias nocapture) {
+# CHECK: [[RET:%[0-9]+]] = call { {{.*}} } @fn_0_promoted(
+# CHECK: extractvalue { {{.*}} } [[RET]]
+# CHECK: ret void
+
+# CHECK-LABEL: define internal { {{.*}} } @fn_0_promoted(
+# CHECK-NOT: alloca
+# CHECK-NOT: %regset
+# CHECK: ret { {{.*}} }
+# CHECK-NOT: %regset
+# CHECK: call { {{.*}} } @fn_11_promoted({{.*}}, i64 42,
+# CHECK-NOT: %regset
+
+# CHECK-LABEL: define void @fn_11(%regset* noalias nocapture) {
+# CHECK: call { {{.*}} } @fn_11_promoted(
+# CHECK: ret void
+
+# CHECK-LABEL: define internal { {{.*}} } @fn_11_promoted(
+# CHECK-NOT: %regset
+# CHECK: ret { {{.*}} }
@@ -0,0 +1,31 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec -O1 -dc-elide-regset-saves %t.o | FileCheck %s
+#RUN: llvm-dec -O1 -dc-elide-regset-saves %t.o | opt -verify -disable-output
+#RUN: llvm-dec -dc-elide-regset-saves %t.o | opt -verify -disable-output
+
+# Test that only the registers accessed by the callee are saved before a call,
+# and that only the ones it modifies are restored after it.
+
+.global _main
+_main:
+mov rdi, 42
+call Lcallee
+add rax, 10
+ret
+
+Lcallee:
+mov rax, rdi
+ret
+
+# CHECK-LABEL: define void @fn_0(
+# CHECK-LABEL: bb_0:
+# CHECK-NOT: %EFLAGS_ptr
+# CHECK: store i64 42, i64* %RDI_ptr, !dc.regset.save
+# CHECK-NOT: %EFLAGS_ptr
+# CHECK: call void @fn_11(%regset* %0)
+# CHECK-NOT: %RDI_ptr
+# CHECK-NOT: %EFLAGS_ptr
+# CHECK: load i64, i64* %RAX_ptr, !dc.regset.restore
+# CHECK-NOT: %RDI_ptr
+# CHECK-NOT: %EFLAGS_ptr
+# CHECK: br label %exit_fn_0
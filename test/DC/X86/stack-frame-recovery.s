@@ -0,0 +1,35 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec -O1 -dc-recover-stack-frame %t.o | FileCheck %s
+#RUN: llvm-dec -O1 -dc-recover-stack-frame %t.o | FileCheck %s --check-prefix=ESCAPE
+#RUN: llvm-dec -O1 -dc-recover-stack-frame %t.o | opt -verify -disable-output
+
+# Test that the stack slots of a function whose frame doesn't escape are
+# promoted, and that the return address is still read from the guest stack.
+
+f:
+push rbp
+mov rbp, rsp
+mov qword ptr [rbp - 8], rdi
+mov rax, qword ptr [rbp - 8]
+pop rbp
+ret
+
+# Test that the stack isn't promoted when its address escapes.
+escape:
+lea rax, [rsp - 8]
+mov qword ptr [rsp - 8], rdi
+ret
+
+# CHECK-LABEL: define void @fn_0(
+# CHECK-LABEL: exit_fn_0:
+# CHECK-DAG: store i64 %RDI_init, i64* %RAX_ptr
+# CHECK-DAG: store i64 %RBP_init, i64* %RBP_ptr
+# CHECK: ret void
+# CHECK-LABEL: bb_0:
+# CHECK-NOT: store
+# CHECK: [[RETPTR:%[0-9]+]] = inttoptr i64 {{%.*}} to i64*
+# CHECK: load i64, i64* [[RETPTR]], align 1
+# CHECK-NOT: inttoptr
+# CHECK: br label %exit_fn_0
+
+# ESCAPE: store i64 %RDI_init, i64* {{%[0-9]+}}, align 1
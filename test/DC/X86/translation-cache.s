@@ -0,0 +1,31 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: rm -rf %t.cache
+#RUN: llvm-dec -dc-translation-cache-dir=%t.cache %t.o > %t.cold.ll
+#RUN: ls %t.cache | count 2
+#RUN: llvm-dec -dc-translation-cache-dir=%t.cache %t.o > %t.warm.ll
+#RUN: ls %t.cache | count 2
+#RUN: diff %t.cold.ll %t.warm.ll
+#RUN: FileCheck %s < %t.warm.ll
+#RUN: llvm-dec -dc-translation-cache-dir=%t.cache %t.o \
+#RUN:   -dc-external-signatures=%p/Inputs/external-signatures.ll > /dev/null
+#RUN: ls %t.cache | count 4
+
+# Test that translated functions are cached across runs, and that a warm run
+# produces the same module as a cold one.  The functions are translated again
+# when the external function signatures are given.
+
+.global _main
+_main:
+mov rdi, 42
+call Lcallee
+add rax, 10
+ret
+
+Lcallee:
+mov rax, rdi
+ret
+
+# CHECK-LABEL: define void @fn_0(%regset* noalias nocapture) {
+# CHECK: store i64 42, i64* %RDI
+# CHECK: call void @fn_{{[0-9A-F]+}}(%regset* %0)
+# CHECK-LABEL: define i32 @main(i32, i8**) {
@@ -0,0 +1,45 @@
+#RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-unknown-darwin < %s -filetype=obj -o %t.o
+#RUN: llvm-dec -O1 -dc-stats=%t.json -dc-stats-slowest=2 %t.o > %t.ll
+#RUN: FileCheck %s < %t.json
+#RUN: llvm-dec -O1 -threads=2 -dc-stats=%t.parallel.json %t.o > %t.parallel.ll
+#RUN: FileCheck %s --check-prefix=PARALLEL < %t.parallel.json
+#RUN: not llvm-dec -dc-stats=%t.nonexistent/stats.json %t.o > /dev/null 2> %t.err
+#RUN: FileCheck %s --check-prefix=ERROR < %t.err
+
+# Test that -dc-stats writes the time spent in each stage, and counts for the
+# translated functions, as JSON.
+
+.global _main
+_main:
+call Lf1
+call Lf2
+ret
+
+Lf1:
+mov rax, 1
+add rax, rdi
+ret
+
+Lf2:
+mov rax, 2
+ret
+
+# CHECK: "stages": {
+# CHECK-NEXT: "object-load": { "wall": {{[0-9.]+}}, "user": {{[0-9.]+}}, "system": {{[0-9.]+}}, "cpu": {{[0-9.]+}} },
+# CHECK-NEXT: "symbolizer": {
+# CHECK-NEXT: "cfg-recovery": {
+# CHECK-NEXT: "translation": {
+# CHECK-NEXT: "optimization": {
+# CHECK-NEXT: "codegen": {
+# CHECK-NEXT: "printing": {
+# CHECK-NEXT: },
+# CHECK-NEXT: "functions": { "count": 3, "cached": 0, "insts": 8,
+# CHECK-NEXT: "slowest-functions": [
+# CHECK-NEXT: { "name": "fn_{{[0-9A-F]+}}", "address": {{[0-9]+}}, "insts": {{[2-3]}},
+# CHECK-NEXT: { "name": "fn_{{[0-9A-F]+}}", "address": {{[0-9]+}}, "insts": {{[2-3]}},
+# CHECK-NEXT: ]
+# CHECK-NEXT: }
+
+# PARALLEL: "functions": { "count": 3, "cached": 0, "insts": 8,
+
+# ERROR: stats.json': {{.*}}
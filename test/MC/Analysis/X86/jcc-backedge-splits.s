@@ -0,0 +1,57 @@
+# RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-apple-darwin -filetype=obj %s -o - | llvm-mccfg - | FileCheck %s
+
+# Test that a block is correctly split several times, by branches into it
+# discovered in decreasing address order.
+
+_main:
+  xor eax, eax
+L1:
+  inc eax
+L2:
+  inc eax
+L3:
+  inc eax
+  cmp eax, 10
+  jb L3
+  cmp eax, 20
+  jb L2
+  cmp eax, 30
+  jb L1
+  ret
+
+# CHECK-LABEL: - Name:            fn_0
+# CHECK:       - Address:         0x0000000000000000
+# CHECK-NEXT:    Preds:           [  ]
+# CHECK-NEXT:    Succs:           [ 0x0000000000000002 ]
+# CHECK-NEXT:    SizeInBytes:     2
+# CHECK-NEXT:    InstCount:       1
+# CHECK:       - Address:         0x000000000000000D
+# CHECK-NEXT:    Preds:           [ 0x0000000000000006 ]
+# CHECK-NEXT:    Succs:           [ 0x0000000000000004, 0x0000000000000012 ]
+# CHECK-NEXT:    SizeInBytes:     5
+# CHECK-NEXT:    InstCount:       2
+# CHECK:       - Address:         0x0000000000000006
+# CHECK-NEXT:    Preds:           [ 0x0000000000000004, 0x0000000000000006 ]
+# CHECK-NEXT:    Succs:           [ 0x0000000000000006, 0x000000000000000D ]
+# CHECK-NEXT:    SizeInBytes:     7
+# CHECK-NEXT:    InstCount:       3
+# CHECK:       - Address:         0x0000000000000012
+# CHECK-NEXT:    Preds:           [ 0x000000000000000D ]
+# CHECK-NEXT:    Succs:           [ 0x0000000000000002, 0x0000000000000017 ]
+# CHECK-NEXT:    SizeInBytes:     5
+# CHECK-NEXT:    InstCount:       2
+# CHECK:       - Address:         0x0000000000000004
+# CHECK-NEXT:    Preds:           [ 0x0000000000000002, 0x000000000000000D ]
+# CHECK-NEXT:    Succs:           [ 0x0000000000000006 ]
+# CHECK-NEXT:    SizeInBytes:     2
+# CHECK-NEXT:    InstCount:       1
+# CHECK:       - Address:         0x0000000000000017
+# CHECK-NEXT:    Preds:           [ 0x0000000000000012 ]
+# CHECK-NEXT:    Succs:           [  ]
+# CHECK-NEXT:    SizeInBytes:     1
+# CHECK-NEXT:    InstCount:       1
+# CHECK:       - Address:         0x0000000000000002
+# CHECK-NEXT:    Preds:           [ 0x0000000000000000, 0x0000000000000012 ]
+# CHECK-NEXT:    Succs:           [ 0x0000000000000004 ]
+# CHECK-NEXT:    SizeInBytes:     2
+# CHECK-NEXT:    InstCount:       1
@@ -0,0 +1,38 @@
+# RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-apple-darwin -filetype=obj %s -o %t.o
+# RUN: llvm-mccfg %t.o > %t.default
+# RUN: llvm-mccfg -max-resident=4096 -stats %t.o > %t.limited 2> %t.stats
+# RUN: diff %t.default %t.limited
+# RUN: FileCheck %s < %t.stats
+# REQUIRES: asserts
+
+# Check that releasing the disassembled code of an input large enough to be
+# memory-mapped doesn't change the CFG, and that the pages of the functions
+# disassembled first are released.
+
+# CHECK-NOT: isn't memory-mapped
+# CHECK: {{[1-9][0-9]*}} mccfg {{.*}} Number of disassembled bytes released
+
+.globl _main
+_main:
+  call _f1
+  call _f2
+  call _f3
+  ret
+
+_f1:
+.rept 2048
+  add rax, 1
+.endr
+  ret
+
+_f2:
+.rept 2048
+  add rcx, 2
+.endr
+  ret
+
+_f3:
+.rept 2048
+  add rdx, 3
+.endr
+  ret
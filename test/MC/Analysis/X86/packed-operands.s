@@ -0,0 +1,25 @@
+# RUN: llvm-mc -x86-asm-syntax=intel -triple=x86_64-apple-darwin -filetype=obj %s -o - | llvm-mccfg - | FileCheck %s
+
+# Test that immediates too wide to be packed with their tag in an operand word
+# survive the compact instruction storage.
+
+_main:
+  movabs rax, 0x7fffffffffffffff
+  movabs rcx, -0x7fffffffffffffff
+  movabs rdx, 0x0fffffffffffffff
+  mov rsi, -1
+  ret
+
+# CHECK:      - Inst:            MOV64ri
+# CHECK-NEXT:   Size:            10
+# CHECK-NEXT:   Ops:             [ RRAX, I9223372036854775807 ]
+# CHECK-NEXT: - Inst:            MOV64ri
+# CHECK-NEXT:   Size:            10
+# CHECK-NEXT:   Ops:             [ RRCX, I-9223372036854775807 ]
+# CHECK-NEXT: - Inst:            MOV64ri
+# CHECK-NEXT:   Size:            10
+# CHECK-NEXT:   Ops:             [ RRDX, I1152921504606846975 ]
+# CHECK-NEXT: - Inst:            MOV64ri32
+# CHECK-NEXT:   Size:            7
+# CHECK-NEXT:   Ops:             [ RRSI, I-1 ]
+# CHECK-NEXT: - Inst:            RETQ
@@ -1374,6 +1374,14 @@ clac
 // CHECK: encoding: [0x0f,0x01,0xcb]
 stac
 
+// CHECK: endbr64
+// CHECK: encoding: [0xf3,0x0f,0x1e,0xfa]
+endbr64
+
+// CHECK: endbr32
+// CHECK: encoding: [0xf3,0x0f,0x1e,0xfb]
+endbr32
+
 // CHECK: faddp %st(1)
 // CHECK: fmulp %st(1)
 // CHECK: fsubp %st(1)
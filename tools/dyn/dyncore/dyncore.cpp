@@ -1,13 +1,21 @@
 #define DEBUG_TYPE "dyn"
 #include "dyncore.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/DC/DCFunction.h"
+#include "llvm/DC/DCTranslationStats.h"
 #include "llvm/DC/DCTranslator.h"
 #include "llvm/DC/DCTranslatorUtils.h"
 #include "llvm/DC/LowerDCTranslateAt.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
@@ -15,7 +23,10 @@
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/MC/MCAnalysis/MCFunction.h"
 #include "llvm/MC/MCAnalysis/MCModule.h"
 #include "llvm/MC/MCAnalysis/MCObjectDisassembler.h"
@@ -31,24 +42,44 @@
 #include "llvm/MC/MCObjectFileInfo.h"
 #include "llvm/MC/MCRegisterInfo.h"
 #include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/MachO.h"
 #include "llvm/Object/MachOUniversal.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CachePruning.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
 #include <dlfcn.h>
-#include <mach-o/dyld.h>
 #include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#elif defined(__linux__)
+#include <link.h>
+#else
+#error "DYN only supports Mach-O and ELF/glibc hosts"
+#endif
 
 // See dyncore.h, this makes sure the DYNCore library is loaded.
 extern "C" void LLVMLinkInDYNCore() {}
@@ -57,6 +88,87 @@ using namespace llvm;
 using namespace object;
 using namespace orc;
 
+STATISTIC(NumTranslationTableHits,
+          "Number of translation table hits outside translated code");
+STATISTIC(NumTranslationTableMisses,
+          "Number of translation table misses outside translated code");
+
+STATISTIC(NumTier0Functions, "Number of functions compiled at tier 0");
+STATISTIC(NumTier1Functions, "Number of functions recompiled at tier 1");
+STATISTIC(NumSpeculativeFunctions,
+          "Number of functions compiled ahead of time in the background");
+STATISTIC(NumObjectCacheHits, "Number of modules loaded from the object cache");
+STATISTIC(NumObjectCacheMisses, "Number of modules compiled and cached");
+STATISTIC(NumRedirectedCalls,
+          "Number of calls redirected through the translation table");
+STATISTIC(NumInlineCacheMisses,
+          "Number of indirect call inline cache misses handled by the runtime");
+STATISTIC(NumMegamorphicCallSites,
+          "Number of indirect call sites whose inline cache was given up on");
+
+static cl::opt<unsigned>
+OptLevel("dyn-opt-level",
+         cl::desc("Optimization level of the translated code, or, with "
+                  "tiered compilation, of tier 1 (0-3) (default = 2)"),
+         cl::init(2));
+
+static cl::opt<bool> EnableTiering(
+    "dyn-tiered-compilation",
+    cl::desc("First translate and compile functions without optimizations "
+             "(tier 0), and only recompile them with optimizations (tier 1) "
+             "once they get hot"));
+
+static cl::opt<unsigned> TierUpThreshold(
+    "dyn-tier-up-threshold",
+    cl::desc("Number of calls to a tier 0 function after which it is "
+             "recompiled at tier 1 (default = 1000)"),
+    cl::init(1000));
+
+static cl::opt<bool> EnableBackgroundCompilation(
+    "dyn-background-compilation",
+    cl::desc("Only translate and compile the functions the program reaches, "
+             "and speculatively compile their callees on a background "
+             "thread"));
+
+static cl::opt<std::string> ObjectCacheDir(
+    "dyn-object-cache-dir",
+    cl::desc("Cache the compiled translations in this directory, and reuse "
+             "them in later runs of the same program"),
+    cl::value_desc("dir"));
+
+static cl::opt<std::string> ObjectCachePolicy(
+    "dyn-object-cache-policy",
+    cl::desc("Pruning policy of the object cache, e.g., "
+             "'prune_interval=30s:prune_after=24h:cache_size=50%'"),
+    cl::value_desc("policy"));
+
+static cl::opt<bool> EnableTiming(
+    "dyn-time",
+    cl::desc("Report the time spent starting up, translating, compiling, and "
+             "running the program"));
+
+static CodeGenOpt::Level getCodeGenOptLevel(unsigned OptLevel) {
+  switch (OptLevel) {
+  case 0: return CodeGenOpt::None;
+  case 1: return CodeGenOpt::Less;
+  case 2: return CodeGenOpt::Default;
+  default: return CodeGenOpt::Aggressive;
+  }
+}
+
+static cl::opt<unsigned> TranslationTableBits(
+    "dyn-translation-table-bits",
+    cl::desc("Log2 of the number of entries in the guest to host code address "
+             "table probed by translated indirect branches (default = 16)"),
+    cl::init(16));
+
+static cl::opt<unsigned> InlineCacheSize(
+    "dyn-inline-cache-size",
+    cl::desc("Number of guest targets cached inline at each translated "
+             "indirect call site, probed before the translation table "
+             "(0-4) (default = 0)"),
+    cl::init(0));
+
 static std::string TripleName;
 
 static StringRef ToolName;
@@ -87,7 +199,7 @@ static const Target *getTarget(const ObjectFile &Obj) {
   return TheTarget;
 }
 
-static OwningBinary<MachOObjectFile> openObjectFileAtPath(StringRef Path) {
+static OwningBinary<ObjectFile> openObjectFileAtPath(StringRef Path) {
   Expected<OwningBinary<Binary>> BinaryOrErr = createBinary(Path);
   if (auto E = BinaryOrErr.takeError()) {
     logAllUnhandledErrors(std::move(E), errs(),
@@ -100,7 +212,7 @@ static OwningBinary<MachOObjectFile> openObjectFileAtPath(StringRef Path) {
   std::tie(Bin, Buf) = BinaryOrErr.get().takeBinary();
 
   auto *BinPtr = Bin.release();
-  std::unique_ptr<MachOObjectFile> MOOF;
+  std::unique_ptr<ObjectFile> OF;
 
   if (auto *FatBinPtr = dyn_cast<MachOUniversalBinary>(BinPtr)) {
     for (auto &Obj : FatBinPtr->objects()) {
@@ -114,23 +226,266 @@ static OwningBinary<MachOObjectFile> openObjectFileAtPath(StringRef Path) {
                               (ToolName + ": '" + Path + "': ").str());
         exit(1);
       }
-      MOOF = std::move(SliceOrErr.get());
+      OF = std::move(SliceOrErr.get());
       break;
     }
   } else if (auto *MOOFPtr = dyn_cast<MachOObjectFile>(BinPtr)) {
-    MOOF.reset(MOOFPtr);
+    OF.reset(MOOFPtr);
+  } else if (auto *ELFOFPtr = dyn_cast<ELFObjectFileBase>(BinPtr)) {
+    OF.reset(ELFOFPtr);
   }
 
-  if (!MOOF) {
+  if (!OF) {
     errs() << ToolName << ": '" << Path << "': "
            << "Unrecognized file type.\n";
     exit(1);
   }
 
-  return OwningBinary<MachOObjectFile>(std::move(MOOF), std::move(Buf));
+  return OwningBinary<ObjectFile>(std::move(OF), std::move(Buf));
 }
 
+/// Get a string identifying the contents of \p Obj: its Mach-O UUID, or its
+/// ELF build ID.  If it has neither, fall back to hashing the whole file.
+static std::string getBinaryID(const ObjectFile &Obj) {
+  if (auto *MOOF = dyn_cast<MachOObjectFile>(&Obj)) {
+    ArrayRef<uint8_t> UUID = MOOF->getUuid();
+    if (!UUID.empty())
+      return toHex(toStringRef(UUID));
+  } else {
+    for (const SectionRef &Sec : Obj.sections()) {
+      StringRef Name, Contents;
+      if (!Sec.getName(Name) && Name == ".note.gnu.build-id" &&
+          !Sec.getContents(Contents))
+        return toHex(Contents);
+    }
+  }
+
+  MD5 Hash;
+  Hash.update(Obj.getData());
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  return Result.digest().str();
+}
+
+// FIXME: We need to handle shared libraries. For now everything we do is only
+// in the main executable, we don't look at anything beyond object boundaries.
+
+#if defined(__APPLE__)
+static const char *const PreloadEnvVar = "DYLD_INSERT_LIBRARIES";
+
+static MCObjectSymbolizer *
+createHostObjectSymbolizer(MCContext &Ctx,
+                           std::unique_ptr<MCRelocationInfo> RelInfo,
+                           const ObjectFile &Obj) {
+  auto *MOOF = dyn_cast<MachOObjectFile>(&Obj);
+  if (!MOOF)
+    return nullptr;
+  // The first image is the main executable.
+  uint64_t VMAddrSlide = _dyld_get_image_vmaddr_slide(0);
+  // Explicitly use a Mach-O-specific symbolizer to give it dyld info.
+  return new MCMachObjectSymbolizer(Ctx, std::move(RelInfo), *MOOF,
+                                    VMAddrSlide);
+}
+#elif defined(__linux__)
+static const char *const PreloadEnvVar = "LD_PRELOAD";
+
+static int findMainExecutableLoadBias(struct dl_phdr_info *Info, size_t Size,
+                                      void *LoadBias) {
+  // The main executable is always the first object visited.
+  *static_cast<uint64_t *>(LoadBias) = Info->dlpi_addr;
+  return 1;
+}
+
+static MCObjectSymbolizer *
+createHostObjectSymbolizer(MCContext &Ctx,
+                           std::unique_ptr<MCRelocationInfo> RelInfo,
+                           const ObjectFile &Obj) {
+  auto *ELFOF = dyn_cast<ELFObjectFileBase>(&Obj);
+  if (!ELFOF)
+    return nullptr;
+  // For PIEs, this is the address the executable was loaded at; for
+  // non-PIEs, it's 0.
+  uint64_t LoadBias = 0;
+  dl_iterate_phdr(findMainExecutableLoadBias, &LoadBias);
+  return new MCELFObjectSymbolizer(Ctx, std::move(RelInfo), *ELFOF, LoadBias);
+}
+#endif
+
 static void *__llvm_dc_translate_at(void *addr);
+static void *__llvm_dc_translate_at_ic_miss(void *addr, void *IC);
+
+/// A direct-mapped table from guest function addresses to the host address of
+/// their JITted translation.
+/// Translated code probes it inline on indirect branches and calls (see
+/// LowerDCTranslateAt), so that already-compiled targets are reached directly,
+/// without leaving JITted code.  The dispatch loop and the translate.at
+/// callback also use it to skip the translator and JIT symbol lookup.
+/// Colliding entries are simply replaced: the translator is the fallback.
+///
+/// Entries are inserted while the guest probes the table (e.g., by the
+/// background compiler).  They are published like a sequence lock: the key is
+/// invalidated while the host address is updated, and readers check that the
+/// key didn't change after loading the host address, so that they never pair
+/// a key with the host address of another.
+class DYNTranslationTable {
+  /// A DCTranslateAtCacheEntry, with atomic fields.  The JITted code accesses
+  /// it with the same layout (with acquire loads, see LowerDCTranslateAt).
+  struct Entry {
+    std::atomic<uint64_t> GuestAddr;
+    std::atomic<uint64_t> HostAddr;
+  };
+  static_assert(sizeof(Entry) == sizeof(DCTranslateAtCacheEntry) &&
+                    sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+                "The JITted code expects DCTranslateAtCacheEntry's layout!");
+
+public:
+  explicit DYNTranslationTable(unsigned Bits)
+      : Bits(Bits), Entries(new Entry[1ULL << Bits]) {
+    for (uint64_t i = 0, e = 1ULL << Bits; i != e; ++i) {
+      Entries[i].GuestAddr.store(DCTranslateAtCacheEntry::EmptyKey,
+                                 std::memory_order_relaxed);
+      Entries[i].HostAddr.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void *lookup(uint64_t GuestAddr) const {
+    const Entry &E = Entries[getDCTranslateAtCacheIndex(GuestAddr, Bits)];
+    if (E.GuestAddr.load(std::memory_order_acquire) != GuestAddr)
+      return nullptr;
+    uint64_t HostAddr = E.HostAddr.load(std::memory_order_acquire);
+    // The entry was replaced since we loaded the key.
+    if (E.GuestAddr.load(std::memory_order_relaxed) != GuestAddr)
+      return nullptr;
+    return reinterpret_cast<void *>(HostAddr);
+  }
+
+  /// Publish \p HostAddr for \p GuestAddr.  The release store of the host
+  /// address orders it after the invalidation of the key, and the release
+  /// store of the key orders it after the host address.
+  void insert(uint64_t GuestAddr, void *HostAddr) {
+    Entry &E = Entries[getDCTranslateAtCacheIndex(GuestAddr, Bits)];
+    E.GuestAddr.store(DCTranslateAtCacheEntry::EmptyKey,
+                      std::memory_order_relaxed);
+    E.HostAddr.store(reinterpret_cast<uint64_t>(HostAddr),
+                     std::memory_order_release);
+    E.GuestAddr.store(GuestAddr, std::memory_order_release);
+  }
+
+  unsigned getBits() const { return Bits; }
+  const void *getEntries() const { return Entries.get(); }
+
+private:
+  const unsigned Bits;
+  std::unique_ptr<Entry[]> Entries;
+};
+
+/// An on-disk cache of the objects compiled from the translation modules, so
+/// that later runs of the same program can skip codegen.
+///
+/// Objects are keyed by the ID of the translated binary, the configuration of
+/// the target machine compiling them, and a hash of the (final) IR of the
+/// module, which includes the guest addresses of the functions.
+/// Runtime addresses (of the translation table and the runtime functions) are
+/// referenced by name, and resolved when linking, so that they don't leak
+/// into the objects.  The guest addresses do, however: with ASLR, a
+/// position-independent program only hits in the cache when it is loaded at
+/// the same address.
+///
+/// The codegen IR passes modify the module between the lookup and the
+/// notification of the compiled object, so the entry path is computed once,
+/// when looking up the module, and reused to store its object.
+class DYNObjectCache : public ObjectCache {
+public:
+  DYNObjectCache(StringRef CacheDir, StringRef BinaryID,
+                 const TargetMachine &TM)
+      : CacheDir(CacheDir) {
+    // Hash everything the objects depend on, besides the IR.
+    MD5 Hash;
+    Hash.update(BinaryID);
+    Hash.update(TM.getTargetTriple().str());
+    Hash.update(TM.getTargetCPU());
+    Hash.update(TM.getTargetFeatureString());
+    Hash.update(utostr(TM.getOptLevel()));
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    Salt = Result.digest().str();
+  }
+
+  void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override {
+    ++NumObjectCacheMisses;
+
+    auto PathIt = PendingEntryPaths.find(M);
+    assert(PathIt != PendingEntryPaths.end() &&
+           "Compiled a module that wasn't looked up!");
+    const std::string EntryPath = std::move(PathIt->second);
+    PendingEntryPaths.erase(PathIt);
+
+    // Write the entry atomically, so that concurrent runs never see a partial
+    // entry.
+    SmallString<128> TempPath;
+    int FD;
+    if (auto EC = sys::fs::createUniqueFile(EntryPath + ".tmp-%%%%%%", FD,
+                                            TempPath)) {
+      DEBUG(dbgs() << "Failed to create object cache entry: " << EC.message()
+                   << "\n");
+      (void)EC;
+      return;
+    }
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      OS << Obj.getBuffer();
+    }
+    if (sys::fs::rename(TempPath, EntryPath))
+      sys::fs::remove(TempPath);
+  }
+
+  std::unique_ptr<MemoryBuffer> getObject(const Module *M) override {
+    std::string EntryPath = getEntryPath(*M);
+    auto BufferOrErr = MemoryBuffer::getFile(EntryPath);
+    if (!BufferOrErr) {
+      // It's compiled next; remember where to store it.
+      PendingEntryPaths[M] = std::move(EntryPath);
+      return nullptr;
+    }
+    ++NumObjectCacheHits;
+    DEBUG(dbgs() << "Loaded " << M->getModuleIdentifier()
+                 << " from the object cache\n");
+    return std::move(*BufferOrErr);
+  }
+
+private:
+  std::string getEntryPath(const Module &M) const {
+    // Don't hash the module identifier: it only depends on the order in which
+    // the modules were created, which changes with, e.g., background
+    // compilation.
+    std::string IR;
+    raw_string_ostream OS(IR);
+    OS << M.getDataLayoutStr() << M.getTargetTriple();
+    for (const GlobalVariable &GV : M.globals())
+      GV.print(OS);
+    for (const Function &F : M)
+      F.print(OS);
+    OS.flush();
+
+    MD5 Hash;
+    Hash.update(Salt);
+    Hash.update(IR);
+    MD5::MD5Result Result;
+    Hash.final(Result);
+
+    // pruneCache only considers files named like this.
+    SmallString<128> Path(CacheDir);
+    sys::path::append(Path, "llvmcache-dyn-" + Result.digest());
+    return Path.str();
+  }
+
+  std::string CacheDir;
+  std::string Salt;
+  /// The entry paths of the modules being compiled, computed from their IR
+  /// before codegen.  Modules are only ever compiled by one thread at a time
+  /// (see __dc_TranslationMutex), so this doesn't need a lock.
+  DenseMap<const Module *, std::string> PendingEntryPaths;
+};
 
 template <typename T>
 static std::vector<T> singletonSet(T t) {
@@ -139,6 +494,31 @@ static std::vector<T> singletonSet(T t) {
   return Vec;
 }
 
+/// The number of bytes of code and data emitted by the JIT, reported with
+/// -dc-stats.  Modules are only ever emitted by one thread at a time (see
+/// __dc_TranslationMutex), so these don't need to be atomic.
+static uint64_t __dc_JITCodeSize, __dc_JITDataSize;
+
+/// A SectionMemoryManager that keeps track of the size of the JITted code.
+class DYNMemoryManager : public SectionMemoryManager {
+public:
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               StringRef SectionName) override {
+    __dc_JITCodeSize += Size;
+    return SectionMemoryManager::allocateCodeSection(Size, Alignment, SectionID,
+                                                     SectionName);
+  }
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, StringRef SectionName,
+                               bool IsReadOnly) override {
+    __dc_JITDataSize += Size;
+    return SectionMemoryManager::allocateDataSection(Size, Alignment, SectionID,
+                                                     SectionName, IsReadOnly);
+  }
+};
+
 class DYNJIT {
 public:
   typedef RTDyldObjectLinkingLayer ObjLayerT;
@@ -147,10 +527,26 @@ public:
 
   typedef LazyEmitLayerT::ModuleSetHandleT ModuleHandleT;
 
-  DYNJIT(TargetMachine &TM)
+  /// \param Tier1TM If non-null, the target machine used to compile the tier 1
+  /// modules added with addTier1Module.
+  /// \param ObjCache, Tier1ObjCache If non-null, the object caches used with
+  /// \p TM and \p Tier1TM.
+  DYNJIT(TargetMachine &TM, TargetMachine *Tier1TM,
+         const DYNTranslationTable &TT, ObjectCache *ObjCache = nullptr,
+         ObjectCache *Tier1ObjCache = nullptr)
       : DL(TM.createDataLayout()),
-        CompileLayer(ObjectLayer, SimpleCompiler(TM)),
-        LazyEmitLayer(CompileLayer) {}
+        CompileLayer(ObjectLayer, SimpleCompiler(TM, ObjCache)),
+        LazyEmitLayer(CompileLayer), TT(TT) {
+    if (Tier1TM)
+      Tier1CompileLayer.reset(new CompileLayerT(
+          ObjectLayer, SimpleCompiler(*Tier1TM, Tier1ObjCache)));
+  }
+
+  /// Make the runtime object at \p Addr available to the translated code, as
+  /// the external symbol \p Name.
+  void addRuntimeSymbol(StringRef Name, void *Addr) {
+    RuntimeSymbols[mangle(Name)] = reinterpret_cast<uintptr_t>(Addr);
+  }
 
   std::string mangle(const std::string &Name) {
     std::string MangledName;
@@ -162,23 +558,29 @@ public:
   }
 
   void runPassesOnModule(Module &M) {
-    if (!LowerDCTranslateAtPass) {
-      auto *PI8Ty = Type::getInt8PtrTy(M.getContext());
-      auto *I64Ty = Type::getInt64Ty(M.getContext());
-
-      FunctionType *CallbackType =
-          FunctionType::get(PI8Ty, PI8Ty, /*isVarArg=*/false);
-
-      Value *TranslateAtFn = ConstantExpr::getIntToPtr(
-          ConstantInt::get(
-              I64Ty, reinterpret_cast<uintptr_t>(&__llvm_dc_translate_at)),
-          CallbackType->getPointerTo());
-
-      LowerDCTranslateAtPass.reset(createLowerDCTranslateAtPass(TranslateAtFn));
-
-      PM.add(LowerDCTranslateAtPass.get());
-    }
-
+    auto *I8Ty = Type::getInt8Ty(M.getContext());
+    auto *PI8Ty = Type::getInt8PtrTy(M.getContext());
+
+    FunctionType *CallbackType =
+        FunctionType::get(PI8Ty, PI8Ty, /*isVarArg=*/false);
+
+    FunctionType *ICMissCallbackType =
+        FunctionType::get(PI8Ty, {PI8Ty, PI8Ty}, /*isVarArg=*/false);
+
+    // These are resolved to the runtime symbols when linking.
+    Value *TranslateAtFn =
+        M.getOrInsertFunction("__llvm_dc_translate_at", CallbackType);
+    Value *TranslationTable =
+        M.getOrInsertGlobal("__llvm_dc_translation_table", I8Ty);
+    Value *ICMissFn = nullptr;
+    if (InlineCacheSize)
+      ICMissFn = M.getOrInsertFunction("__llvm_dc_translate_at_ic_miss",
+                                       ICMissCallbackType);
+
+    legacy::PassManager PM;
+    PM.add(createLowerDCTranslateAtPass(TranslateAtFn, TranslationTable,
+                                        TT.getBits(), ICMissFn,
+                                        InlineCacheSize));
     PM.run(M);
   }
 
@@ -188,23 +590,27 @@ public:
 
     runPassesOnModule(*M);
 
-    // We need a memory manager to allocate memory and resolve symbols for this
-    // new module. Create one that resolves symbols by looking back into the
-    // JIT.
-    auto Resolver = createLambdaResolver(
-        [&](const std::string &Name) {
-          if (auto Sym = findSymbol(Name))
-            return JITSymbol(Sym.getAddress(), Sym.getFlags());
-          else if (auto Addr =
-                       RTDyldMemoryManager::getSymbolAddressInProcess(Name))
-            return JITSymbol(Addr, JITSymbolFlags::Exported);
-          return JITSymbol(nullptr);
-        },
-        [](const std::string &S) { return nullptr; });
-
     return LazyEmitLayer.addModuleSet(singletonSet(std::move(M)),
-                                      make_unique<SectionMemoryManager>(),
-                                      std::move(Resolver));
+                                      make_unique<DYNMemoryManager>(),
+                                      createResolver());
+  }
+
+  /// Compile \p M right away, with the tier 1 target machine.
+  /// Its symbols can only be found using findTier1Symbol, so that they don't
+  /// shadow the tier 0 functions they replace.
+  void addTier1Module(Module *M) {
+    assert(Tier1CompileLayer && "Tiered compilation isn't enabled!");
+    DEBUG(M->dump());
+
+    runPassesOnModule(*M);
+
+    Tier1CompileLayer->addModuleSet(singletonSet(std::move(M)),
+                                    make_unique<DYNMemoryManager>(),
+                                    createResolver());
+  }
+
+  JITSymbol findTier1Symbol(const std::string &Name) {
+    return Tier1CompileLayer->findSymbol(mangle(Name), true);
   }
 
   void removeModule(ModuleHandleT H) { LazyEmitLayer.removeModuleSet(H); }
@@ -218,13 +624,31 @@ public:
   }
 
 private:
+  // We need a memory manager to allocate memory and resolve symbols for new
+  // modules. Create one that resolves symbols by looking back into the JIT.
+  std::unique_ptr<JITSymbolResolver> createResolver() {
+    return createLambdaResolver(
+        [&](const std::string &Name) {
+          auto RSI = RuntimeSymbols.find(Name);
+          if (RSI != RuntimeSymbols.end())
+            return JITSymbol(RSI->second, JITSymbolFlags::Exported);
+          if (auto Sym = findSymbol(Name))
+            return JITSymbol(Sym.getAddress(), Sym.getFlags());
+          else if (auto Addr =
+                       RTDyldMemoryManager::getSymbolAddressInProcess(Name))
+            return JITSymbol(Addr, JITSymbolFlags::Exported);
+          return JITSymbol(nullptr);
+        },
+        [](const std::string &S) { return nullptr; });
+  }
+
   const DataLayout DL;
   ObjLayerT ObjectLayer;
   CompileLayerT CompileLayer;
   LazyEmitLayerT LazyEmitLayer;
-
-  std::unique_ptr<Pass> LowerDCTranslateAtPass;
-  legacy::PassManager PM;
+  std::unique_ptr<CompileLayerT> Tier1CompileLayer;
+  const DYNTranslationTable &TT;
+  StringMap<uint64_t> RuntimeSymbols;
 };
 
 static uint64_t loadRegFromSet(uint8_t *RegSet, unsigned Offset, unsigned Size){
@@ -246,39 +670,392 @@ static MCModule *__dc_MCM;
 static MCObjectSymbolizer *__dc_MOS;
 static MCObjectDisassembler *__dc_MCOD;
 static DYNJIT *__dc_JIT;
+// FIXME: We need to handle invalidation when functions are freed.
+static DYNTranslationTable *__dc_TT;
+static DCTranslator *__dc_Tier1DT;
+
+/// The timers reported with -dyn-time.
+struct DYNTimers {
+  TimerGroup Group;
+  Timer Startup, Tier0, Tier1, Run;
+
+  DYNTimers()
+      : Group("dyn", "DYN Time Report"),
+        Startup("startup", "Startup (until main is executed)", Group),
+        Tier0("tier0", "Translation and compilation (tier 0)", Group),
+        Tier1("tier1", "Recompilation (tier 1)", Group),
+        Run("run", "Execution of main (including compilation)", Group) {}
+};
+static DYNTimers *__dc_Timers;
+
+static Timer *getTimer(Timer DYNTimers::*T) {
+  return __dc_Timers ? &(__dc_Timers->*T) : nullptr;
+}
+
+/// The statistics requested with -dc-stats, if any.
+static DCTranslationStats *__dc_Stats;
+
+/// The tiering state of a tier 0 function, used by its instrumented entry (see
+/// instrumentTier0Function).
+struct DYNTierInfo {
+  /// The host address of the tier 1 version, or 0 until it is compiled.
+  std::atomic<uint64_t> Tier1Addr;
+  /// The number of calls to the tier 0 version.
+  uint32_t CallCount;
+
+  DYNTierInfo() : Tier1Addr(0), CallCount(0) {}
+};
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "DYNTierInfo layout doesn't match the instrumentation");
+
+static DenseMap<uint64_t, std::unique_ptr<DYNTierInfo>> __dc_TierInfos;
+
+/// Guards all the translation state (the MC and DC modules, the translators,
+/// and the JIT), which is used from both the guest and the background
+/// compilation threads.  The translation table itself is only written with
+/// this held, but is read without it, by the guest.
+static std::mutex __dc_TranslationMutex;
+
+static void __llvm_dc_tier_up(uint64_t Addr);
+
+/// Instrument the tier 0 translation \p F of the guest function at \p Addr.
+/// Its entry first checks whether there is a tier 1 version and, if so, tail
+/// calls it; this redirects all callers, including the ones that were linked
+/// directly to the tier 0 version.  Otherwise, it counts the call, and calls
+/// into the runtime to compile the tier 1 version when the count reaches
+/// the threshold; that call then goes straight to the tier 1 version.
+static void instrumentTier0Function(Function &F, uint64_t Addr) {
+  auto &Info = __dc_TierInfos[Addr];
+  if (!Info)
+    Info.reset(new DYNTierInfo);
+
+  LLVMContext &Ctx = F.getContext();
+  BasicBlock *OldEntryBB = &F.getEntryBlock();
+  auto *EntryBB = BasicBlock::Create(Ctx, "tier_entry", &F, OldEntryBB);
+  auto *CheckBB = BasicBlock::Create(Ctx, "tier_check", &F, OldEntryBB);
+  auto *RedirectBB = BasicBlock::Create(Ctx, "tier1_redirect", &F, OldEntryBB);
+  auto *CountBB = BasicBlock::Create(Ctx, "tier0_count", &F, OldEntryBB);
+  auto *TierUpBB = BasicBlock::Create(Ctx, "tier_up", &F, OldEntryBB);
+
+  // Keep the static allocas in the entry block.  The check is in a block of
+  // its own, as it's done again after tiering up, and the entry block can't
+  // have predecessors.
+  for (auto I = OldEntryBB->begin(), E = OldEntryBB->end(); I != E;) {
+    Instruction &Inst = *I++;
+    if (isa<AllocaInst>(Inst))
+      Inst.moveBefore(*EntryBB, EntryBB->end());
+  }
+  BranchInst::Create(CheckBB, EntryBB);
+
+  IRBuilder<> Builder(CheckBB);
+  Type *I64Ty = Builder.getInt64Ty();
+  Type *I32Ty = Builder.getInt32Ty();
+  StructType *InfoTy = StructType::get(I64Ty, I32Ty);
+  const std::string InfoName = ("__llvm_dc_tier_info_" + F.getName()).str();
+  __dc_JIT->addRuntimeSymbol(InfoName, Info.get());
+  Value *InfoPtr = F.getParent()->getOrInsertGlobal(InfoName, InfoTy);
+
+  LoadInst *Tier1Addr =
+      Builder.CreateLoad(Builder.CreateStructGEP(InfoTy, InfoPtr, 0));
+  Tier1Addr->setAtomic(AtomicOrdering::Monotonic);
+  Tier1Addr->setAlignment(8);
+  Builder.CreateCondBr(Builder.CreateIsNotNull(Tier1Addr), RedirectBB,
+                       CountBB);
+
+  Builder.SetInsertPoint(RedirectBB);
+  Value *RegSetArg = &*F.arg_begin();
+  Builder.CreateCall(Builder.CreateIntToPtr(Tier1Addr, F.getType()),
+                     {RegSetArg})
+      ->setTailCall();
+  Builder.CreateRetVoid();
+
+  Builder.SetInsertPoint(CountBB);
+  Value *CountPtr = Builder.CreateStructGEP(InfoTy, InfoPtr, 1);
+  Value *Count = Builder.CreateAdd(Builder.CreateLoad(CountPtr),
+                                   ConstantInt::get(I32Ty, 1));
+  Builder.CreateStore(Count, CountPtr);
+  Builder.CreateCondBr(
+      Builder.CreateICmpEQ(Count, ConstantInt::get(I32Ty, TierUpThreshold)),
+      TierUpBB, OldEntryBB);
+
+  Builder.SetInsertPoint(TierUpBB);
+  FunctionType *TierUpFnTy = FunctionType::get(Builder.getVoidTy(), I64Ty,
+                                               /*isVarArg=*/false);
+  Value *TierUpFn =
+      F.getParent()->getOrInsertFunction("__llvm_dc_tier_up", TierUpFnTy);
+  Builder.CreateCall(TierUpFn, {ConstantInt::get(I64Ty, Addr)});
+  Builder.CreateBr(CheckBB);
+}
+
+/// If \p F is a function translated by \p DT, or a declaration of one, set
+/// \p Addr to the guest address it was translated from.
+static bool getTranslatedFunctionAddr(const Function &F, DCTranslator &DT,
+                                      uint64_t &Addr) {
+  return F.getFunctionType() == DT.getDCModule()->getFuncTy() &&
+         F.getName().startswith("fn_") &&
+         !F.getName().substr(3).getAsInteger(16, Addr);
+}
+
+/// With background compilation, functions are translated without their
+/// callees, which might not be compiled yet when \p M is linked.  Call those
+/// through the translation table instead, using dc.translate.at: the guest
+/// then only blocks in the runtime if the callee still isn't ready when it
+/// gets called.  \p M was translated by \p DT, which has its own register set
+/// type at tier 1.
+static void redirectUncompiledCalls(Module &M, DCTranslator &DT) {
+  if (!EnableBackgroundCompilation)
+    return;
+
+  for (Function &F : M) {
+    uint64_t Addr;
+    if (!F.isDeclaration() || !getTranslatedFunctionAddr(F, DT, Addr) ||
+        __dc_JIT->findUnmangledSymbol(F.getName()))
+      continue;
+
+    for (auto UI = F.user_begin(), UE = F.user_end(); UI != UE;) {
+      auto *CI = dyn_cast<CallInst>(*UI++);
+      if (!CI || CI->getCalledValue() != &F)
+        continue;
+      IRBuilder<> Builder(CI);
+      Value *HostFn = Builder.CreateCall(
+          Intrinsic::getDeclaration(&M, Intrinsic::dc_translate_at),
+          {Builder.CreateIntToPtr(Builder.getInt64(Addr),
+                                  Builder.getInt8PtrTy())});
+      CI->setCalledFunction(Builder.CreateBitCast(HostFn, F.getType()));
+      ++NumRedirectedCalls;
+    }
+  }
+}
+
+/// Finalize the current translation module, and add it to the JIT.
+static void addTranslationModule() {
+  Module *M = __dc_DT->finalizeTranslationModule();
+  redirectUncompiledCalls(*M, *__dc_DT);
+
+  for (Function &F : *M) {
+    // Only look at translated functions.
+    uint64_t Addr;
+    if (F.isDeclaration() || !getTranslatedFunctionAddr(F, *__dc_DT, Addr))
+      continue;
+    // External function wrappers aren't worth recompiling.
+    if (!__dc_MOS->isInObject(__dc_MOS->getOriginalLoadAddr(Addr)))
+      continue;
+    ++NumTier0Functions;
+    if (EnableTiering)
+      instrumentTier0Function(F, Addr);
+  }
+
+  DCTranslationStats::StageRegion TR(__dc_Stats, DCTranslationStats::CodeGen);
+  __dc_JIT->addModule(M);
+}
+
+/// Recompile the hot tier 0 function at \p Addr at tier 1, and redirect its
+/// callers to the new version.
+static void __llvm_dc_tier_up(uint64_t Addr) {
+  std::lock_guard<std::mutex> Lock(__dc_TranslationMutex);
+  TimeRegion TR(getTimer(&DYNTimers::Tier1));
+  const MCFunction *MCFN = __dc_MCM->findFunctionAt(Addr);
+  assert(MCFN && "Recompiling a function that was never disassembled!");
+
+  // Rename the tier 1 version, so that it doesn't shadow the tier 0 version
+  // (which redirects to it anyway) in the JIT.
+  Function *F = __dc_Tier1DT->translateFunction(*MCFN);
+  const std::string Tier1Name = (F->getName() + "_tier1").str();
+  F->setName(Tier1Name);
+  Module *M = __dc_Tier1DT->finalizeTranslationModule();
+  redirectUncompiledCalls(*M, *__dc_Tier1DT);
+  DCTranslationStats::StageRegion CodeGenTR(__dc_Stats,
+                                            DCTranslationStats::CodeGen);
+  __dc_JIT->addTier1Module(M);
+
+  uint64_t Tier1Addr = __dc_JIT->findTier1Symbol(Tier1Name).getAddress();
+  CodeGenTR.stop();
+  DEBUG(dbgs() << "Recompiled " << (void *)Tier1Addr << " for " << Tier1Name
+               << "\n");
+  ++NumTier1Functions;
+
+  __dc_TierInfos[Addr]->Tier1Addr.store(Tier1Addr);
+  __dc_TT->insert(Addr, (void *)Tier1Addr);
+}
 
-// FIXME: We need to handle cache invalidation when functions are freed.
-//static DenseMap<void *, void *> TranslationCache(128);
+class DYNBackgroundCompiler;
+static DYNBackgroundCompiler *__dc_BackgroundCompiler;
+
+static void enqueueCallees(uint64_t Addr);
+
+/// Translate and JIT the guest function at \p Addr, unless that was already
+/// done, and record it in the translation table.
+/// \p Speculative is true if the guest didn't ask for the function (yet).
+/// This must be called with __dc_TranslationMutex held.
+static void *translateAndCompileAt(uint64_t Addr, bool Speculative = false) {
+  const std::string Name = __dc_DT->getDCModule()->getFunctionName(Addr);
+  if (auto FnSymbol = __dc_JIT->findUnmangledSymbol(Name)) {
+    void *Ptr = (void *)FnSymbol.getAddress();
+    __dc_TT->insert(Addr, Ptr);
+    return Ptr;
+  }
+
+  if (Speculative) {
+    DEBUG(dbgs() << "Speculatively compiling " << utohexstr(Addr) << "\n");
+    ++NumSpeculativeFunctions;
+  }
+
+  TimeRegion TR(getTimer(&DYNTimers::Tier0));
+  Function *F;
+  if (__dc_MOS->isInObject(__dc_MOS->getOriginalLoadAddr(Addr))) {
+    if (EnableBackgroundCompilation)
+      translateAt(Addr, *__dc_DT, *__dc_MCM, __dc_MCOD, __dc_MOS);
+    else
+      translateRecursivelyAt(Addr, *__dc_DT, *__dc_MCM, __dc_MCOD, __dc_MOS);
+    F = __dc_DT->getDCModule()->getOrCreateFunction(Addr);
+  } else {
+    // We only translate the main executable: this is a shared library function
+    // reached through a function pointer (e.g., through the ELF PLT/GOT).
+    // Call it natively, directly if we know its prototype.
+    FunctionType *ExtFnTy = nullptr;
+    Dl_info DLI;
+    if (dladdr((void *)Addr, &DLI) && DLI.dli_sname &&
+        DLI.dli_saddr == (void *)Addr)
+      ExtFnTy = __dc_DT->getExternalFunctionType(DLI.dli_sname);
+    F = __dc_DT->getDCModule()->createExternalWrapperFunction(Addr, ExtFnTy);
+  }
+  addTranslationModule();
+  // The modules are only compiled when their symbols are first looked up.
+  DCTranslationStats::StageRegion CodeGenTR(__dc_Stats,
+                                            DCTranslationStats::CodeGen);
+  void *Ptr = (void *)__dc_JIT->findUnmangledSymbol(F->getName()).getAddress();
+  CodeGenTR.stop();
+  DEBUG(dbgs() << "Jitted " << Ptr << " for " << F->getName() << "\n");
+  __dc_TT->insert(Addr, Ptr);
+  enqueueCallees(Addr);
+  return Ptr;
+}
+
+/// The number of times the guest entered the runtime to find the translation
+/// of a guest address, reported with -dc-stats.  Unlike the statistics, this
+/// is also counted in release builds.  Only the guest thread enters the
+/// runtime, so this doesn't need to be atomic.
+static uint64_t __dc_NumDispatcherEntries;
+
+/// Get the host address of the translation of the guest function at \p Addr,
+/// translating and JITting it if needed, and record it in the translation
+/// table.
+static void *getOrTranslateHostAddr(uint64_t Addr) {
+  ++__dc_NumDispatcherEntries;
+  if (void *Ptr = __dc_TT->lookup(Addr)) {
+    ++NumTranslationTableHits;
+    return Ptr;
+  }
+  ++NumTranslationTableMisses;
+
+  // With background compilation, this blocks until the function being
+  // compiled speculatively (possibly the one we're looking for) is done.
+  std::lock_guard<std::mutex> Lock(__dc_TranslationMutex);
+  return translateAndCompileAt(Addr);
+}
+
+/// Compiles the callees of the functions reached by the guest, on a background
+/// thread, before the guest gets to call them.
+/// The guest thread only queues up work; the compilation itself happens with
+/// __dc_TranslationMutex held, one function at a time, so that the guest can
+/// take over as soon as it misses in the translation table.
+class DYNBackgroundCompiler {
+public:
+  DYNBackgroundCompiler() : Worker([this] { run(); }) {}
+  ~DYNBackgroundCompiler() { stop(); }
+
+  /// Queue up the guest functions at \p Addrs, unless they were already.
+  void enqueue(ArrayRef<uint64_t> Addrs) {
+    {
+      std::lock_guard<std::mutex> Lock(QueueMutex);
+      for (uint64_t Addr : Addrs)
+        if (Queued.insert(Addr).second)
+          Queue.push_back(Addr);
+    }
+    QueueCV.notify_one();
+  }
+
+  /// Drop the remaining work, and wait for the function being compiled.
+  void stop() {
+    {
+      std::lock_guard<std::mutex> Lock(QueueMutex);
+      Stopping = true;
+    }
+    QueueCV.notify_one();
+    if (Worker.joinable())
+      Worker.join();
+  }
+
+private:
+  void run() {
+    while (true) {
+      uint64_t Addr;
+      {
+        std::unique_lock<std::mutex> Lock(QueueMutex);
+        QueueCV.wait(Lock, [this] { return Stopping || !Queue.empty(); });
+        if (Stopping)
+          return;
+        Addr = Queue.front();
+        Queue.pop_front();
+      }
+
+      std::lock_guard<std::mutex> Lock(__dc_TranslationMutex);
+      if (!__dc_TT->lookup(Addr))
+        translateAndCompileAt(Addr, /*Speculative=*/true);
+    }
+  }
+
+  std::mutex QueueMutex;
+  std::condition_variable QueueCV;
+  std::deque<uint64_t> Queue;
+  DenseSet<uint64_t> Queued;
+  bool Stopping = false;
+
+  // This needs to be last, so that it starts after everything is initialized.
+  std::thread Worker;
+};
+
+static void enqueueCallees(uint64_t Addr) {
+  if (!__dc_BackgroundCompiler)
+    return;
+  if (const MCFunction *MCFN = __dc_MCM->findFunctionAt(Addr)) {
+    SmallVector<uint64_t, 8> Callees(MCFN->callee_begin(), MCFN->callee_end());
+    Callees.append(MCFN->tailcallee_begin(), MCFN->tailcallee_end());
+    __dc_BackgroundCompiler->enqueue(Callees);
+  }
+}
 
 static void *__llvm_dc_translate_at(void *addr) {
-  void *ptr = nullptr;
-  translateRecursivelyAt((uint64_t)addr, *__dc_DT, *__dc_MCM, __dc_MCOD, __dc_MOS);
-  Function *F = __dc_DT->getDCModule()->getOrCreateFunction((uint64_t)addr);
   DEBUG(dbgs() << "__llvm_dc_translate_at " << addr << "\n");
-  DEBUG(dbgs() << "Jumping to " << F->getName() << "\n");
-  ptr = (void*)__dc_JIT->findUnmangledSymbol(F->getName()).getAddress();
-  if (!ptr) {
-    __dc_JIT->addModule(__dc_DT->finalizeTranslationModule());
-    auto FnSymbol = __dc_JIT->findUnmangledSymbol(F->getName());
-    ptr = (void*)FnSymbol.getAddress();
-  }
-  return ptr;
+  return getOrTranslateHostAddr((uint64_t)addr);
 }
 
-// FIXME: This is all mach-o hacks to get this working.
-struct ProgramVars {
-  const void*   mh;
-  int*          NXArgcPtr;
-  const char*** NXArgvPtr;
-  const char*** environPtr;
-  const char**  __prognamePtr;
-};
-#include <iostream>
+/// Called by translated code when the inline cache \p IC of an indirect call
+/// site misses on \p addr.  Make \p addr the most recently used entry, and
+/// evict the least recently used one.
+/// The inline caches are only accessed by the guest thread, which is blocked
+/// here, so this doesn't need to invalidate the entries like the translation
+/// table.
+static void *__llvm_dc_translate_at_ic_miss(void *addr, void *IC) {
+  DEBUG(dbgs() << "__llvm_dc_translate_at_ic_miss " << addr << "\n");
+  ++NumInlineCacheMisses;
+  void *Ptr = getOrTranslateHostAddr((uint64_t)addr);
+
+  auto &Cache = *static_cast<DCInlineCache *>(IC);
+  if (++Cache.Misses == DCInlineCache::MegamorphicMisses)
+    ++NumMegamorphicCallSites;
+  std::copy_backward(Cache.Entries, Cache.Entries + InlineCacheSize - 1,
+                     Cache.Entries + InlineCacheSize);
+  Cache.Entries[0].GuestAddr = (uint64_t)addr;
+  Cache.Entries[0].HostAddr = (uint64_t)Ptr;
+  return Ptr;
+}
 
-void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
-               struct ProgramVars *pvars) __attribute__((constructor));
-void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
-               struct ProgramVars *pvars) {
+// Both dyld and glibc pass argc/argv/envp to the constructors (dyld passes
+// more, which we don't need).
+void dyn_entry(int argc, char **argv, const char **envp)
+    __attribute__((constructor));
+void dyn_entry(int argc, char **argv, const char **envp) {
 
   sys::PrintStackTraceOnErrorSignal(/*Filename=*/StringRef());
   PrettyStackTraceProgram X(argc, argv);
@@ -298,18 +1075,44 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
   // Translating the child as well should be done on purpose, but affecting the
   // environment is unacceptable anyway.
   // For now, it messes with stuff like ASAN's symbolizer, so just disable it.
-  unsetenv("DYLD_INSERT_LIBRARIES");
+  unsetenv(PreloadEnvVar);
 
   ToolName = "dyn";
   cl::ParseEnvironmentOptions(ToolName.str().c_str(), "DCDYN_OPTIONS");
 
-  std::string InputFilename = argv[0];
+  if (OptLevel > 3) {
+    errs() << ToolName << ": invalid optimization level " << OptLevel << "\n";
+    exit(1);
+  }
+
+  if (InlineCacheSize > DCInlineCache::MaxEntries) {
+    errs() << ToolName << ": invalid inline cache size " << InlineCacheSize
+           << "\n";
+    exit(1);
+  }
+
+  std::unique_ptr<DYNTimers> Timers;
+  if (EnableTiming) {
+    Timers.reset(new DYNTimers);
+    __dc_Timers = Timers.get();
+  }
+  Optional<TimeRegion> StartupTR;
+  StartupTR.emplace(getTimer(&DYNTimers::Startup));
+
+  std::unique_ptr<DCTranslationStats> Stats =
+      DCTranslationStats::createFromCommandLine();
+  __dc_Stats = Stats.get();
+
+  std::string InputFilename =
+      sys::fs::getMainExecutable(argv[0], (void *)(intptr_t)&dyn_entry);
 
-  OwningBinary<MachOObjectFile> MOOFAndBuffer =
-      openObjectFileAtPath(InputFilename);
-  MachOObjectFile &MOOF = *MOOFAndBuffer.getBinary();
+  Optional<DCTranslationStats::StageRegion> ObjectLoadTR;
+  ObjectLoadTR.emplace(Stats.get(), DCTranslationStats::ObjectLoad);
+  OwningBinary<ObjectFile> OFAndBuffer = openObjectFileAtPath(InputFilename);
+  ObjectFile &OF = *OFAndBuffer.getBinary();
+  ObjectLoadTR.reset();
 
-  const Target *TheTarget = getTarget(MOOF);
+  const Target *TheTarget = getTarget(OF);
 
   // FIXME: why are there unique_ptrs everywhere?
 
@@ -367,19 +1170,19 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
     exit(1);
   }
 
-  // FIXME: Mach-O specific
-
-  // FIXME: We need to handle shared libraries. For now everything we do is only
-  // in the main executable, we don't look at anything beyond object boundaries.
-  // The first image is the main executable.
-  uint64_t VMAddrSlide = _dyld_get_image_vmaddr_slide(0);
-
-  // Explicitly use a Mach-O-specific symbolizer to give it dyld info.
-  std::unique_ptr<MCMachObjectSymbolizer> MOS(
-      new MCMachObjectSymbolizer(MCCtx, std::move(RelInfo), MOOF, VMAddrSlide));
+  std::unique_ptr<MCObjectSymbolizer> MOS;
+  {
+    DCTranslationStats::StageRegion TR(Stats.get(),
+                                       DCTranslationStats::Symbolizer);
+    MOS.reset(createHostObjectSymbolizer(MCCtx, std::move(RelInfo), OF));
+  }
+  if (!MOS) {
+    errs() << "error: '" << InputFilename << "' isn't a host object file\n";
+    exit(1);
+  }
 
   std::unique_ptr<MCObjectDisassembler> OD(
-      new MCObjectDisassembler(MOOF, *DisAsm, *MIA, MOS.get()));
+      new MCObjectDisassembler(OF, *DisAsm, *MIA, MOS.get()));
 
   // FIXME: We need either:
   //  - a custom non-contiguous memory object, for every mapped region.
@@ -398,35 +1201,92 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
   if (!MCM)
     exit(1);
 
+  // With tiered compilation, tier 0 only runs mem2reg, and uses FastISel:
+  // most functions are only executed a few times, and only the hot ones are
+  // worth the cost of the optimizations.
+  const unsigned Tier0OptLevel = EnableTiering ? 1 : OptLevel;
+  const CodeGenOpt::Level Tier0CGOptLevel =
+      EnableTiering ? CodeGenOpt::None : getCodeGenOptLevel(OptLevel);
+
   EngineBuilder Builder;
-  Builder.setOptLevel(CodeGenOpt::Default);
+  Builder.setOptLevel(Tier0CGOptLevel);
   TargetMachine *TM = Builder.selectTarget();
   if (!TM)
     llvm_unreachable("Unable to select target machine for JIT!");
 
+  std::unique_ptr<TargetMachine> Tier1TM;
+  if (EnableTiering) {
+    Builder.setOptLevel(getCodeGenOptLevel(OptLevel));
+    Tier1TM.reset(Builder.selectTarget());
+    if (!Tier1TM)
+      llvm_unreachable("Unable to select target machine for JIT!");
+  }
+
   const DataLayout DL = TM->createDataLayout();
   LLVMContext Ctx;
 
   std::unique_ptr<DCTranslator> DT(TheTarget->createDCTranslator(
-      Triple(TripleName), Ctx, DL, /*OptLevel=*/2, *MII, *MRI, *STI, *MIP));
+      Triple(TripleName), Ctx, DL, Tier0OptLevel, *MII, *MRI, *STI, *MIP));
   if (!DT) {
     errs() << "error: no dc translator for target " << TripleName << "\n";
     exit(1);
   }
 
+  // The tier 1 translator has its own translation module, so that tiering up
+  // doesn't interfere with a tier 0 translation in progress.
+  std::unique_ptr<DCTranslator> Tier1DT;
+  if (EnableTiering)
+    Tier1DT.reset(TheTarget->createDCTranslator(
+        Triple(TripleName), Ctx, DL, OptLevel, *MII, *MRI, *STI, *MIP));
+
+  DT->setStats(Stats.get());
+  if (Tier1DT)
+    Tier1DT->setStats(Stats.get());
+
   // Add the program's symbols into the JIT's search space.
   if (sys::DynamicLibrary::LoadLibraryPermanently(nullptr)) {
     errs() << "error: unable to load program symbols.\n";
     exit(1);
   }
 
-  DYNJIT J(*TM);
+  std::unique_ptr<DYNObjectCache> ObjCache, Tier1ObjCache;
+  CachePruningPolicy ObjCachePolicy;
+  if (!ObjectCacheDir.empty()) {
+    auto PolicyOrErr = parseCachePruningPolicy(ObjectCachePolicy);
+    if (!PolicyOrErr) {
+      logAllUnhandledErrors(PolicyOrErr.takeError(), errs(),
+                            ToolName + ": invalid object cache policy: ");
+      exit(1);
+    }
+    ObjCachePolicy = *PolicyOrErr;
+    if (auto EC = sys::fs::create_directories(ObjectCacheDir)) {
+      errs() << ToolName << ": unable to create object cache directory '"
+             << ObjectCacheDir << "': " << EC.message() << "\n";
+      exit(1);
+    }
+    const std::string BinaryID = getBinaryID(OF);
+    ObjCache.reset(new DYNObjectCache(ObjectCacheDir, BinaryID, *TM));
+    if (Tier1TM)
+      Tier1ObjCache.reset(
+          new DYNObjectCache(ObjectCacheDir, BinaryID, *Tier1TM));
+  }
+
+  DYNTranslationTable TT(TranslationTableBits);
+  DYNJIT J(*TM, Tier1TM.get(), TT, ObjCache.get(), Tier1ObjCache.get());
+  J.addRuntimeSymbol("__llvm_dc_translate_at", (void *)&__llvm_dc_translate_at);
+  J.addRuntimeSymbol("__llvm_dc_translate_at_ic_miss",
+                     (void *)&__llvm_dc_translate_at_ic_miss);
+  J.addRuntimeSymbol("__llvm_dc_translation_table",
+                     (void *)TT.getEntries());
+  J.addRuntimeSymbol("__llvm_dc_tier_up", (void *)&__llvm_dc_tier_up);
 
   __dc_DT = DT.get();
+  __dc_Tier1DT = Tier1DT.get();
   __dc_MCM = MCM.get();
   __dc_MOS = MOS.get();
   __dc_MCOD = OD.get();
   __dc_JIT = &J;
+  __dc_TT = &TT;
 
   // Now run it !
 
@@ -457,6 +1317,8 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
   RunInitRegSet();
 
   auto GetIRFunction = [&](Function *Fn) {
+    DCTranslationStats::StageRegion TR(Stats.get(),
+                                       DCTranslationStats::CodeGen);
     auto FnSymbol = J.findUnmangledSymbol(Fn->getName());
     uint64_t Addr = FnSymbol.getAddress();
     DEBUG(dbgs() << "Jitted " << (void *)Addr << " for " << Fn->getName()
@@ -471,13 +1333,17 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
   };
 
   // Translate all static init functions.
-  auto TranslateAndRunStaticInitExit = [&](ArrayRef<uint64_t> Fns) {
-    translateRecursivelyAt(Fns, *DT, *MCM, OD.get(), MOS.get());
+  auto TranslateAndRunStaticInitExit = [&](ArrayRef<uint64_t> OrigFns) {
+    std::vector<uint64_t> Fns;
+    for (uint64_t OrigFn : OrigFns)
+      Fns.push_back(MOS->getEffectiveLoadAddr(OrigFn));
+    {
+      TimeRegion TR(getTimer(&DYNTimers::Tier0));
+      translateRecursivelyAt(Fns, *DT, *MCM, OD.get(), MOS.get());
 
-    // Add these to the JIT, and run them.
-    Module *M = DT->finalizeTranslationModule();
-    DEBUG(M->print(dbgs(), nullptr));
-    J.addModule(M);
+      // Add these to the JIT, and run them.
+      addTranslationModule();
+    }
     for (auto FnAddr : Fns) {
       auto *Fn = DT->getDCModule()->getOrCreateFunction(FnAddr);
       DEBUG(dbgs() << "Executing static init/fini function " << Fn->getName()
@@ -499,15 +1365,35 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
 
   // Now we can start running real code.
   uint64_t CurPC = MOS->getEffectiveLoadAddr(*MainEntrypoint);
+#if defined(__APPLE__)
   assert(dlsym(RTLD_MAIN_ONLY, "main") == (void *)CurPC);
+#endif
+  StartupTR.reset();
+  Optional<TimeRegion> RunTR;
+  RunTR.emplace(getTimer(&DYNTimers::Run));
+
+  std::unique_ptr<DYNBackgroundCompiler> BackgroundCompiler;
+  if (EnableBackgroundCompilation) {
+    BackgroundCompiler.reset(new DYNBackgroundCompiler);
+    __dc_BackgroundCompiler = BackgroundCompiler.get();
+  }
+
+  // Translated code chains to already-compiled code through the translation
+  // table, so we only get back here when the guest returns from main, or when
+  // a translated function exits to a PC it couldn't reach by itself.
   do {
-    translateRecursivelyAt(CurPC, *DT, *MCM, OD.get(), MOS.get());
-    auto *Fn = DT->getDCModule()->getOrCreateFunction(CurPC);
-    DEBUG(dbgs() << "Executing function " << Fn->getName() << "\n");
-    J.addModule(DT->finalizeTranslationModule());
-    RunIRFunction(Fn);
+    DEBUG(dbgs() << "Executing function at " << utohexstr(CurPC) << "\n");
+    auto FnPointer = (void (*)(uint8_t *))getOrTranslateHostAddr(CurPC);
+    FnPointer(RegSet.data());
     CurPC = loadRegFromSet(RegSet.data(), RegSetPCOffset, RegSetPCSize);
   } while (CurPC != ~0ULL);
+  RunTR.reset();
+
+  // The exit functions are translated on this thread, without the lock.
+  if (BackgroundCompiler) {
+    BackgroundCompiler->stop();
+    __dc_BackgroundCompiler = nullptr;
+  }
 
   auto FiniRegSetFnFP =
       (int (*)(uint8_t *))(intptr_t)J.findUnmangledSymbol(
@@ -518,5 +1404,27 @@ void dyn_entry(int argc, char **argv, const char **envp, const char **apple,
 
   TranslateAndRunStaticInitExit(MOS->getStaticExitFunctions());
 
+  if (ObjCache)
+    pruneCache(ObjectCacheDir, ObjCachePolicy);
+
+  // We never return to the guest program, so print the reports now, after the
+  // guest output still buffered in the C library we share with it.
+  fflush(nullptr);
+  if (Timers) {
+    __dc_Timers = nullptr;
+    Timers->Group.print(errs());
+  }
+  if (AreStatisticsEnabled())
+    PrintStatistics(errs());
+  if (Stats) {
+    __dc_Stats = nullptr;
+    Stats->setCounter("dispatcher-entries", __dc_NumDispatcherEntries);
+    Stats->setCounter("jit-code-size", __dc_JITCodeSize);
+    Stats->setCounter("jit-data-size", __dc_JITDataSize);
+    if (std::error_code EC = Stats->writeJSON())
+      errs() << ToolName << ": '" << Stats->getOutputFilename()
+             << "': " << EC.message() << "\n";
+  }
+
   exit(exitVal);
 }
@@ -0,0 +1,646 @@
+//===-- llvm-dc-bench.cpp - DC translation throughput benchmark -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program measures the throughput of the translation of object files:
+// disassembly and CFG recovery (MCObjectDisassembler), then translation of
+// all the recovered functions (DCTranslator), at several optimization levels.
+//
+// Each input is benchmarked -repetitions times at each level, and the median
+// times are reported, along with the number of heap allocations and the peak
+// resident set size.  The results can be saved as JSON, and later used as the
+// baseline of another run, to detect throughput regressions.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Config/config.h"
+#include "llvm/DC/DCModule.h"
+#include "llvm/DC/DCTranslator.h"
+#include "llvm/DC/DCTranslatorUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/MC/MCAnalysis/MCFunction.h"
+#include "llvm/MC/MCAnalysis/MCModule.h"
+#include "llvm/MC/MCAnalysis/MCObjectDisassembler.h"
+#include "llvm/MC/MCAnalysis/MCObjectSymbolizer.h"
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCDisassembler/MCDisassembler.h"
+#include "llvm/MC/MCDisassembler/MCRelocationInfo.h"
+#include "llvm/MC/MCInstPrinter.h"
+#include "llvm/MC/MCInstrAnalysis.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/YAMLParser.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <vector>
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+using namespace llvm;
+using namespace object;
+
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::desc("<input object files>"),
+               cl::OneOrMore);
+
+static cl::list<unsigned>
+OptLevels("opt-levels",
+          cl::desc("Comma-separated optimization levels to benchmark "
+                   "(default = 0,1,2,3)"),
+          cl::CommaSeparated);
+
+static cl::opt<unsigned>
+Repetitions("repetitions",
+            cl::desc("Number of times each input is translated at each "
+                     "optimization level (default = 5)"),
+            cl::init(5));
+
+static cl::opt<unsigned>
+TranslationThreads("threads",
+                   cl::desc("Number of threads to translate functions with "
+                            "(default = 0, use the main thread)"),
+                   cl::init(0u));
+
+enum OutputFormatTy { OF_Text, OF_JSON };
+static cl::opt<OutputFormatTy>
+OutputFormat("format", cl::desc("Output format"),
+             cl::values(clEnumValN(OF_Text, "text", "Human-readable tables"),
+                        clEnumValN(OF_JSON, "json",
+                                   "JSON, which can be used with -baseline")),
+             cl::init(OF_Text));
+
+static cl::opt<std::string>
+OutputFilename("o", cl::desc("Output file (default = '-')"),
+               cl::value_desc("filename"), cl::init("-"));
+
+static cl::opt<std::string>
+BaselineFilename("baseline",
+                 cl::desc("Compare the throughput against the results of a "
+                          "previous run, saved with -format=json, and fail "
+                          "if it regressed"),
+                 cl::value_desc("filename"));
+
+static cl::opt<double>
+RegressionThreshold("regression-threshold",
+                    cl::desc("Decrease of the throughput, in percent, over "
+                             "which a result is a regression (default = 5)"),
+                    cl::init(5.0));
+
+static StringRef ToolName;
+
+//===----------------------------------------------------------------------===//
+// Allocation counting
+//===----------------------------------------------------------------------===//
+
+// Count the heap allocations made by the whole tool, including the libraries.
+// The array forms of new, and the sized forms of delete, forward to these.
+static std::atomic<uint64_t> NumAllocations(0);
+
+void *operator new(size_t Size) {
+  NumAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *Ptr = std::malloc(Size ? Size : 1))
+    return Ptr;
+  report_fatal_error("Out of memory", /*GenCrashDiag=*/false);
+}
+
+void operator delete(void *Ptr) noexcept { std::free(Ptr); }
+
+/// Get the peak resident set size of the process, in bytes, or 0 if it isn't
+/// available.  It only ever grows.
+static uint64_t getPeakRSS() {
+#if defined(HAVE_GETRUSAGE)
+  struct rusage RU;
+  if (::getrusage(RUSAGE_SELF, &RU))
+    return 0;
+#if defined(__APPLE__)
+  return RU.ru_maxrss;
+#else
+  return uint64_t(RU.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+//===----------------------------------------------------------------------===//
+// Results
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// The results of the benchmark of one input at one optimization level.
+struct BenchResult {
+  std::string Input;
+  unsigned OptLevel;
+  uint64_t NumFunctions;
+  uint64_t NumInsts;
+  /// The median wall times, in seconds, of disassembly and CFG recovery, and
+  /// of the translation (including the optimizations).
+  double CFGTime;
+  double TranslationTime;
+  /// The throughput, over the sum of the median times.
+  double InstsPerSec;
+  double FunctionsPerSec;
+  /// The median number of allocations of a single repetition.
+  uint64_t NumAllocations;
+  /// The peak resident set size of the process, at the end of the benchmark.
+  uint64_t PeakRSS;
+};
+
+struct BenchReport {
+  /// The version of the JSON format.  Bump this when it changes.
+  static const unsigned CurrentVersion = 1;
+
+  unsigned Version;
+  unsigned Repetitions;
+  std::vector<BenchResult> Results;
+};
+} // end anonymous namespace
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(BenchResult)
+
+namespace llvm {
+namespace yaml {
+// The JSON output is read back as YAML, of which it is a subset.
+template <> struct MappingTraits<BenchResult> {
+  static void mapping(IO &IO, BenchResult &R) {
+    IO.mapRequired("input", R.Input);
+    IO.mapRequired("opt-level", R.OptLevel);
+    IO.mapRequired("functions", R.NumFunctions);
+    IO.mapRequired("insts", R.NumInsts);
+    IO.mapRequired("cfg-time", R.CFGTime);
+    IO.mapRequired("translation-time", R.TranslationTime);
+    IO.mapRequired("insts-per-sec", R.InstsPerSec);
+    IO.mapRequired("functions-per-sec", R.FunctionsPerSec);
+    IO.mapRequired("allocations", R.NumAllocations);
+    IO.mapRequired("peak-rss", R.PeakRSS);
+  }
+};
+
+template <> struct MappingTraits<BenchReport> {
+  static void mapping(IO &IO, BenchReport &R) {
+    IO.mapRequired("version", R.Version);
+    IO.mapRequired("repetitions", R.Repetitions);
+    IO.mapRequired("results", R.Results);
+  }
+};
+} // end namespace yaml
+} // end namespace llvm
+
+template <typename T> static T getMedian(std::vector<T> Values) {
+  assert(!Values.empty());
+  std::sort(Values.begin(), Values.end());
+  return Values[(Values.size() - 1) / 2];
+}
+
+//===----------------------------------------------------------------------===//
+// Benchmark
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// The target-specific MC objects needed to disassemble and translate an
+/// input, which don't change between repetitions.
+struct TargetInfo {
+  std::string TripleName;
+  const Target *TheTarget;
+  std::unique_ptr<const MCRegisterInfo> MRI;
+  std::unique_ptr<const MCAsmInfo> MAI;
+  std::unique_ptr<const MCSubtargetInfo> STI;
+  std::unique_ptr<const MCInstrInfo> MII;
+  std::unique_ptr<const MCInstrAnalysis> MIA;
+  std::unique_ptr<MCInstPrinter> MIP;
+  std::unique_ptr<const MCObjectFileInfo> MOFI;
+
+  /// Set up the target of \p Obj.  Returns false if that failed.
+  bool init(const ObjectFile &Obj);
+};
+
+/// The time spent in a single repetition, and what was translated.
+struct RepetitionResult {
+  double CFGTime;
+  double TranslationTime;
+  uint64_t NumFunctions;
+  uint64_t NumInsts;
+  uint64_t NumAllocations;
+};
+} // end anonymous namespace
+
+bool TargetInfo::init(const ObjectFile &Obj) {
+  Triple TheTriple("unknown-unknown-unknown");
+  TheTriple.setArch(Triple::ArchType(Obj.getArch()));
+  if (Obj.isMachO())
+    TheTriple.setObjectFormat(Triple::MachO);
+
+  std::string Error;
+  TheTarget = TargetRegistry::lookupTarget("", TheTriple, Error);
+  if (!TheTarget) {
+    errs() << ToolName << ": " << Error << "\n";
+    return false;
+  }
+  TripleName = TheTriple.getTriple();
+
+  MRI.reset(TheTarget->createMCRegInfo(TripleName));
+  MAI.reset(MRI ? TheTarget->createMCAsmInfo(*MRI, TripleName) : nullptr);
+  STI.reset(TheTarget->createMCSubtargetInfo(TripleName, "", ""));
+  MII.reset(TheTarget->createMCInstrInfo());
+  if (!MRI || !MAI || !STI || !MII) {
+    errs() << ToolName << ": no MC support for target " << TripleName << "\n";
+    return false;
+  }
+  MIA.reset(TheTarget->createMCInstrAnalysis(MII.get()));
+  MIP.reset(TheTarget->createMCInstPrinter(Triple(TripleName), 0, *MAI, *MII,
+                                           *MRI));
+  if (!MIA || !MIP) {
+    errs() << ToolName << ": no MC analysis support for target " << TripleName
+           << "\n";
+    return false;
+  }
+  MOFI.reset(new MCObjectFileInfo);
+  return true;
+}
+
+/// Disassemble, recover the CFG of, and translate \p Obj at \p OptLevel,
+/// from scratch.  Returns false if that failed.
+static bool runRepetition(const ObjectFile &Obj, const TargetInfo &TI,
+                          unsigned OptLevel, RepetitionResult &Result) {
+  const uint64_t StartAllocations = NumAllocations.load();
+  TimeRecord StartTime = TimeRecord::getCurrentTime(/*Start=*/true);
+
+  MCContext MCCtx(TI.MAI.get(), TI.MRI.get(), TI.MOFI.get());
+  std::unique_ptr<MCDisassembler> DisAsm(
+      TI.TheTarget->createMCDisassembler(*TI.STI, MCCtx));
+  std::unique_ptr<MCRelocationInfo> RelInfo(
+      TI.TheTarget->createMCRelocationInfo(TI.TripleName, MCCtx));
+  if (!DisAsm || !RelInfo) {
+    errs() << ToolName << ": no disassembler for target " << TI.TripleName
+           << "\n";
+    return false;
+  }
+  std::unique_ptr<MCObjectSymbolizer> MOS(
+      TI.TheTarget->createMCObjectSymbolizer(MCCtx, Obj, std::move(RelInfo)));
+  if (!MOS) {
+    errs() << ToolName << ": no object symbolizer for target " << TI.TripleName
+           << "\n";
+    return false;
+  }
+
+  std::unique_ptr<MCObjectDisassembler> OD(
+      new MCObjectDisassembler(Obj, *DisAsm, *TI.MIA, MOS.get()));
+  if (TranslationThreads)
+    OD->setNumThreads(TranslationThreads);
+  std::unique_ptr<MCModule> MCM(OD->buildModule());
+  if (!MCM)
+    return false;
+
+  TimeRecord CFGEndTime = TimeRecord::getCurrentTime(/*Start=*/false);
+
+  DataLayout DL("");
+  LLVMContext Ctx;
+  std::unique_ptr<DCTranslator> DT(TI.TheTarget->createDCTranslator(
+      Triple(TI.TripleName), Ctx, DL, OptLevel, *TI.MII, *TI.MRI, *TI.STI,
+      *TI.MIP));
+  if (!DT) {
+    errs() << ToolName << ": no dc translator for target " << TI.TripleName
+           << "\n";
+    return false;
+  }
+
+  // Translate like llvm-dec does: from the entrypoint, then everything else.
+  // MCInstPrinters aren't thread-safe: give each worker its own.
+  std::mutex WorkerMIPsMutex;
+  std::vector<std::unique_ptr<MCInstPrinter>> WorkerMIPs;
+  auto CreateWorkerTranslator = [&](LLVMContext &WorkerCtx) {
+    MCInstPrinter *WorkerMIP = TI.TheTarget->createMCInstPrinter(
+        Triple(TI.TripleName), 0, *TI.MAI, *TI.MII, *TI.MRI);
+    {
+      std::lock_guard<std::mutex> Lock(WorkerMIPsMutex);
+      WorkerMIPs.emplace_back(WorkerMIP);
+    }
+    return std::unique_ptr<DCTranslator>(TI.TheTarget->createDCTranslator(
+        Triple(TI.TripleName), WorkerCtx, DL, OptLevel, *TI.MII, *TI.MRI,
+        *TI.STI, *WorkerMIP));
+  };
+  auto TranslateAt = [&](ArrayRef<uint64_t> EntryAddrs) {
+    if (TranslationThreads)
+      translateRecursivelyAtInParallel(EntryAddrs, *DT, *MCM,
+                                       CreateWorkerTranslator,
+                                       TranslationThreads, OD.get(), MOS.get());
+    else
+      translateRecursivelyAt(EntryAddrs, *DT, *MCM, OD.get(), MOS.get());
+  };
+
+  // Objects without an entrypoint (e.g., the instruction tests) are
+  // translated from address 0, the start of their text section.
+  uint64_t Entrypoint = 0;
+  if (auto MainEntrypoint = MOS->getMainEntrypoint())
+    Entrypoint = *MainEntrypoint;
+  TranslateAt({Entrypoint});
+  DT->getDCModule()->getOrCreateMainFunction(
+      DT->getDCModule()->getOrCreateFunction(Entrypoint));
+
+  std::vector<uint64_t> FuncEntrypoints;
+  FuncEntrypoints.reserve(MCM->func_size());
+  for (auto &F : MCM->funcs())
+    FuncEntrypoints.push_back(F->getStartAddr());
+  TranslateAt(FuncEntrypoints);
+  DT->finalizeTranslationModule();
+
+  TimeRecord EndTime = TimeRecord::getCurrentTime(/*Start=*/false);
+
+  Result.CFGTime = CFGEndTime.getWallTime() - StartTime.getWallTime();
+  Result.TranslationTime = EndTime.getWallTime() - CFGEndTime.getWallTime();
+  Result.NumFunctions = MCM->func_size();
+  Result.NumInsts = 0;
+  for (auto &F : MCM->funcs())
+    for (const MCBasicBlock *BB : *F)
+      Result.NumInsts += BB->size();
+  Result.NumAllocations = NumAllocations.load() - StartAllocations;
+  return true;
+}
+
+/// Benchmark \p InputFilename at all the requested optimization levels, and
+/// add the results to \p Report.  Returns false if that failed.
+static bool benchmarkInput(StringRef InputFilename, BenchReport &Report) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFile(InputFilename, /*FileSize=*/-1,
+                            /*RequiresNullTerminator=*/false);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    errs() << ToolName << ": '" << InputFilename << "': " << EC.message()
+           << '\n';
+    return false;
+  }
+  std::unique_ptr<MemoryBuffer> Buffer = std::move(BufferOrErr.get());
+
+  auto ObjOrErr = ObjectFile::createObjectFile(Buffer->getMemBufferRef());
+  if (auto E = ObjOrErr.takeError()) {
+    logAllUnhandledErrors(std::move(E), errs(),
+                          (ToolName + ": '" + InputFilename + "': ").str());
+    return false;
+  }
+  const ObjectFile &Obj = **ObjOrErr;
+
+  TargetInfo TI;
+  if (!TI.init(Obj))
+    return false;
+
+  for (unsigned OptLevel : OptLevels) {
+    std::vector<RepetitionResult> Reps(Repetitions);
+    for (RepetitionResult &Rep : Reps)
+      if (!runRepetition(Obj, TI, OptLevel, Rep))
+        return false;
+
+    BenchResult R;
+    R.Input = InputFilename;
+    R.OptLevel = OptLevel;
+    R.NumFunctions = Reps[0].NumFunctions;
+    R.NumInsts = Reps[0].NumInsts;
+    std::vector<double> CFGTimes, TranslationTimes;
+    std::vector<uint64_t> Allocations;
+    for (const RepetitionResult &Rep : Reps) {
+      CFGTimes.push_back(Rep.CFGTime);
+      TranslationTimes.push_back(Rep.TranslationTime);
+      Allocations.push_back(Rep.NumAllocations);
+    }
+    R.CFGTime = getMedian(CFGTimes);
+    R.TranslationTime = getMedian(TranslationTimes);
+    R.NumAllocations = getMedian(Allocations);
+    const double TotalTime = R.CFGTime + R.TranslationTime;
+    R.InstsPerSec = TotalTime > 0 ? R.NumInsts / TotalTime : 0;
+    R.FunctionsPerSec = TotalTime > 0 ? R.NumFunctions / TotalTime : 0;
+    R.PeakRSS = getPeakRSS();
+    Report.Results.push_back(R);
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Comparison
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// The comparison of a result with the baseline for the same input and
+/// optimization level.
+struct BenchComparison {
+  const BenchResult *Baseline;
+  const BenchResult *Current;
+  /// The relative change of the throughput, in percent.
+  double Change;
+  bool IsRegression;
+};
+} // end anonymous namespace
+
+/// Get the key identifying the results for the same input and optimization
+/// level across runs.  Only the file name of inputs is used, so that
+/// baselines can be shared between checkouts.
+static std::string getResultKey(const BenchResult &R) {
+  return (sys::path::filename(R.Input) + ":O" + Twine(R.OptLevel)).str();
+}
+
+static std::vector<BenchComparison> compareReports(const BenchReport &Baseline,
+                                                   const BenchReport &Current) {
+  StringMap<const BenchResult *> BaselineResults;
+  for (const BenchResult &R : Baseline.Results)
+    BaselineResults[getResultKey(R)] = &R;
+
+  std::vector<BenchComparison> Comparisons;
+  for (const BenchResult &R : Current.Results) {
+    auto It = BaselineResults.find(getResultKey(R));
+    if (It == BaselineResults.end())
+      continue;
+    BenchComparison C;
+    C.Baseline = It->second;
+    C.Current = &R;
+    C.Change = C.Baseline->InstsPerSec > 0
+                   ? (R.InstsPerSec / C.Baseline->InstsPerSec - 1) * 100
+                   : 0;
+    C.IsRegression = C.Change < -RegressionThreshold;
+    Comparisons.push_back(C);
+  }
+  return Comparisons;
+}
+
+static bool readBaseline(StringRef Filename, BenchReport &Baseline) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFile(Filename);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    errs() << ToolName << ": '" << Filename << "': " << EC.message() << '\n';
+    return false;
+  }
+  yaml::Input YIn((*BufferOrErr)->getBuffer());
+  YIn >> Baseline;
+  if (YIn.error()) {
+    errs() << ToolName << ": '" << Filename << "': invalid baseline\n";
+    return false;
+  }
+  if (Baseline.Version != BenchReport::CurrentVersion) {
+    errs() << ToolName << ": '" << Filename << "': unsupported baseline "
+           << "version " << Baseline.Version << "\n";
+    return false;
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Output
+//===----------------------------------------------------------------------===//
+
+static void printText(raw_ostream &OS, const BenchReport &Report) {
+  // format() can't take string literals as arguments: the headers are
+  // aligned with the columns by hand.
+  OS << "Input                             O  Functions      Insts    CFG (s) "
+        "Transl (s)      Insts/s  Functions/s  Allocations PeakRSS (kB)\n";
+  for (const BenchResult &R : Report.Results)
+    OS << format("%-32s %2u %10llu %10llu %10.4f %10.4f %12.1f %12.1f %12llu "
+                 "%12llu\n",
+                 sys::path::filename(R.Input).str().c_str(), R.OptLevel,
+                 (unsigned long long)R.NumFunctions,
+                 (unsigned long long)R.NumInsts, R.CFGTime, R.TranslationTime,
+                 R.InstsPerSec, R.FunctionsPerSec,
+                 (unsigned long long)R.NumAllocations,
+                 (unsigned long long)(R.PeakRSS / 1024));
+}
+
+static void printComparisons(raw_ostream &OS,
+                             ArrayRef<BenchComparison> Comparisons) {
+  OS << "Input                             O   Base Insts/s      Insts/s   "
+        "Change    Base Allocs  Allocations\n";
+  unsigned NumRegressions = 0;
+  for (const BenchComparison &C : Comparisons) {
+    OS << format("%-32s %2u %14.1f %12.1f %+7.1f%% %14llu %12llu",
+                 sys::path::filename(C.Current->Input).str().c_str(),
+                 C.Current->OptLevel, C.Baseline->InstsPerSec,
+                 C.Current->InstsPerSec, C.Change,
+                 (unsigned long long)C.Baseline->NumAllocations,
+                 (unsigned long long)C.Current->NumAllocations);
+    if (C.IsRegression) {
+      OS << "  REGRESSION";
+      ++NumRegressions;
+    }
+    OS << "\n";
+  }
+  OS << NumRegressions << " regression(s) over "
+     << format("%.1f", (double)RegressionThreshold) << "%\n";
+}
+
+static void printJSONResult(raw_ostream &OS, const BenchResult &R) {
+  OS << "{ \"input\": \"" << yaml::escape(R.Input) << "\""
+     << ", \"opt-level\": " << R.OptLevel
+     << ", \"functions\": " << R.NumFunctions
+     << ", \"insts\": " << R.NumInsts
+     << ", \"cfg-time\": " << format("%.6f", R.CFGTime)
+     << ", \"translation-time\": " << format("%.6f", R.TranslationTime)
+     << ", \"insts-per-sec\": " << format("%.1f", R.InstsPerSec)
+     << ", \"functions-per-sec\": " << format("%.1f", R.FunctionsPerSec)
+     << ", \"allocations\": " << R.NumAllocations
+     << ", \"peak-rss\": " << R.PeakRSS << " }";
+}
+
+static void printJSON(raw_ostream &OS, const BenchReport &Report) {
+  OS << "{\n";
+  OS << "  \"version\": " << Report.Version << ",\n";
+  OS << "  \"repetitions\": " << Report.Repetitions << ",\n";
+  OS << "  \"results\": [";
+  for (unsigned i = 0, e = Report.Results.size(); i != e; ++i) {
+    OS << (i ? ",\n" : "\n") << "    ";
+    printJSONResult(OS, Report.Results[i]);
+  }
+  OS << (Report.Results.empty() ? "]" : "\n  ]") << "\n}\n";
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal(/*Filename=*/StringRef());
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+
+  InitializeAllTargetInfos();
+  InitializeAllTargetDCs();
+  InitializeAllTargetMCs();
+  InitializeAllAsmParsers();
+  InitializeAllDisassemblers();
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "DC translation throughput benchmark\n");
+
+  ToolName = argv[0];
+
+  if (OptLevels.empty())
+    for (unsigned OptLevel = 0; OptLevel <= 3; ++OptLevel)
+      OptLevels.push_back(OptLevel);
+  for (unsigned OptLevel : OptLevels) {
+    if (OptLevel > 3) {
+      errs() << ToolName << ": invalid optimization level " << OptLevel
+             << ".\n";
+      return 1;
+    }
+  }
+  if (!Repetitions) {
+    errs() << ToolName << ": -repetitions must be at least 1.\n";
+    return 1;
+  }
+
+  BenchReport Baseline;
+  if (!BaselineFilename.empty() && !readBaseline(BaselineFilename, Baseline))
+    return 1;
+
+  BenchReport Report;
+  Report.Version = BenchReport::CurrentVersion;
+  Report.Repetitions = Repetitions;
+  for (const std::string &InputFilename : InputFilenames)
+    if (!benchmarkInput(InputFilename, Report))
+      return 1;
+
+  std::error_code EC;
+  raw_fd_ostream OS(OutputFilename, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << ToolName << ": '" << OutputFilename << "': " << EC.message()
+           << '\n';
+    return 1;
+  }
+  if (OutputFormat == OF_JSON)
+    printJSON(OS, Report);
+  else
+    printText(OS, Report);
+
+  if (BaselineFilename.empty())
+    return 0;
+
+  // The comparison goes to stderr, so that the results can still be saved
+  // from stdout.  Fail if the throughput regressed, for use in scripts.
+  std::vector<BenchComparison> Comparisons = compareReports(Baseline, Report);
+  printComparisons(errs(), Comparisons);
+  for (const BenchComparison &C : Comparisons)
+    if (C.IsRegression)
+      return 1;
+  return 0;
+}
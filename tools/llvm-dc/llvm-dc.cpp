@@ -53,6 +53,12 @@ EnableDisassemblyCache("enable-mcod-disass-cache",
     cl::desc("Enable the MC Object disassembly instruction cache"),
     cl::init(false), cl::Hidden);
 
+static cl::opt<unsigned>
+DisassemblyCacheSize("mcod-disass-cache-size",
+    cl::desc("Maximum number of instructions in the MC Object disassembly "
+             "instruction cache"),
+    cl::init(MCCachingDisassembler::DefaultMaxEntries), cl::Hidden);
+
 static StringRef ToolName;
 
 static const Target *getTarget() {
@@ -130,7 +136,8 @@ int main(int argc, char **argv) {
   std::unique_ptr<MCDisassembler> DisAsmImpl;
   if (EnableDisassemblyCache) {
     DisAsmImpl = std::move(DisAsm);
-    DisAsm.reset(new MCCachingDisassembler(*DisAsmImpl, *STI));
+    DisAsm.reset(new MCCachingDisassembler(*DisAsmImpl, *STI,
+                                           DisassemblyCacheSize));
   }
 
   std::unique_ptr<MCInstPrinter> MIP(
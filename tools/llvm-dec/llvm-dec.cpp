@@ -1,7 +1,9 @@
 #define DEBUG_TYPE "llvm-dec"
+#include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/DC/DCModule.h"
+#include "llvm/DC/DCTranslationStats.h"
 #include "llvm/DC/DCTranslator.h"
 #include "llvm/DC/DCTranslatorUtils.h"
 #include "llvm/MC/MCAnalysis/MCCachingDisassembler.h"
@@ -24,11 +26,13 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
+#include <mutex>
 
 using namespace llvm;
 using namespace object;
@@ -58,6 +62,25 @@ EnableDisassemblyCache("enable-mcod-disass-cache",
     cl::desc("Enable the MC Object disassembly instruction cache"),
     cl::init(false), cl::Hidden);
 
+static cl::opt<unsigned>
+DisassemblyCacheSize("mcod-disass-cache-size",
+    cl::desc("Maximum number of instructions in the MC Object disassembly "
+             "instruction cache"),
+    cl::init(MCCachingDisassembler::DefaultMaxEntries), cl::Hidden);
+
+static cl::opt<unsigned>
+TranslationThreads("threads",
+                   cl::desc("Number of threads to disassemble and translate "
+                            "functions with (default = 0, use the main "
+                            "thread)"),
+                   cl::init(0u));
+
+static cl::opt<unsigned long long>
+MaxResident("max-resident",
+            cl::desc("Maximum number of bytes of already disassembled code "
+                     "to keep resident in memory (default = 0, no limit)"),
+            cl::value_desc("bytes"), cl::init(0));
+
 static StringRef ToolName;
 
 static const Target *getTarget(const ObjectFile *Obj) {
@@ -103,7 +126,24 @@ int main(int argc, char **argv) {
 
   ToolName = argv[0];
 
-  auto Binary = createBinary(InputFilename);
+  std::unique_ptr<DCTranslationStats> Stats =
+      DCTranslationStats::createFromCommandLine();
+  Optional<DCTranslationStats::StageRegion> ObjectLoadTR;
+  ObjectLoadTR.emplace(Stats.get(), DCTranslationStats::ObjectLoad);
+
+  // Map the input read-only, without requiring a null terminator, so that
+  // the section contents are never copied on their way to the disassembler.
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFileOrSTDIN(InputFilename, /*FileSize=*/-1,
+                                   /*RequiresNullTerminator=*/false);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    errs() << ToolName << ": '" << InputFilename << "': " << EC.message()
+           << '\n';
+    return 1;
+  }
+  std::unique_ptr<MemoryBuffer> Buffer = std::move(BufferOrErr.get());
+
+  auto Binary = createBinary(Buffer->getMemBufferRef());
   if (auto E = Binary.takeError()) {
     logAllUnhandledErrors(std::move(E), errs(),
                           (ToolName + ": '" + InputFilename + "': ").str());
@@ -111,9 +151,10 @@ int main(int argc, char **argv) {
   }
 
   ObjectFile *Obj;
-  if (!(Obj = dyn_cast<ObjectFile>((*Binary).getBinary())))
+  if (!(Obj = dyn_cast<ObjectFile>(Binary->get())))
     errs() << ToolName << ": '" << InputFilename << "': "
            << "Unrecognized file type.\n";
+  ObjectLoadTR.reset();
 
   const Target *TheTarget = getTarget(Obj);
 
@@ -158,7 +199,8 @@ int main(int argc, char **argv) {
   std::unique_ptr<MCDisassembler> DisAsmImpl;
   if (EnableDisassemblyCache) {
     DisAsmImpl = std::move(DisAsm);
-    DisAsm.reset(new MCCachingDisassembler(*DisAsmImpl, *STI));
+    DisAsm.reset(new MCCachingDisassembler(*DisAsmImpl, *STI,
+                                           DisassemblyCacheSize));
   }
 
   std::unique_ptr<MCInstPrinter> MIP(
@@ -174,8 +216,13 @@ int main(int argc, char **argv) {
     errs() << "error: no relocation info for target " << TripleName << "\n";
     return 1;
   }
-  std::unique_ptr<MCObjectSymbolizer> MOS(
-      TheTarget->createMCObjectSymbolizer(MCCtx, *Obj, std::move(RelInfo)));
+  std::unique_ptr<MCObjectSymbolizer> MOS;
+  {
+    DCTranslationStats::StageRegion TR(Stats.get(),
+                                       DCTranslationStats::Symbolizer);
+    MOS.reset(
+        TheTarget->createMCObjectSymbolizer(MCCtx, *Obj, std::move(RelInfo)));
+  }
   if (!MOS) {
     errs() << "error: no object symbolizer for target " << TripleName << "\n";
     return 1;
@@ -187,7 +234,21 @@ int main(int argc, char **argv) {
 
   std::unique_ptr<MCObjectDisassembler> OD(
       new MCObjectDisassembler(*Obj, *DisAsm, *MIA, MOS.get()));
-  std::unique_ptr<MCModule> MCM(OD->buildModule());
+  if (TranslationThreads)
+    OD->setNumThreads(TranslationThreads);
+  if (MaxResident) {
+    if (Buffer->getBufferKind() == MemoryBuffer::MemoryBuffer_MMap)
+      OD->setMaxResidentBytes(MaxResident);
+    else
+      errs() << ToolName << ": warning: '" << InputFilename
+             << "' isn't memory-mapped, ignoring -max-resident\n";
+  }
+  std::unique_ptr<MCModule> MCM;
+  {
+    DCTranslationStats::StageRegion TR(Stats.get(),
+                                       DCTranslationStats::CFGRecovery);
+    MCM.reset(OD->buildModule());
+  }
 
   if (!MCM)
     return 1;
@@ -209,13 +270,37 @@ int main(int argc, char **argv) {
     errs() << "error: no dc translator for target " << TripleName << "\n";
     return 1;
   }
+  DT->setStats(Stats.get());
 
   if (!TranslationEntrypoint) {
     if (auto MainEntrypoint = MOS->getMainEntrypoint())
       TranslationEntrypoint = *MainEntrypoint;
   }
 
-  translateRecursivelyAt({TranslationEntrypoint}, *DT, *MCM, OD.get(), MOS.get());
+  // MCInstPrinters aren't thread-safe: give each worker its own.
+  std::mutex WorkerMIPsMutex;
+  std::vector<std::unique_ptr<MCInstPrinter>> WorkerMIPs;
+  auto CreateWorkerTranslator = [&](LLVMContext &WorkerCtx) {
+    MCInstPrinter *WorkerMIP = TheTarget->createMCInstPrinter(
+        Triple(TripleName), 0, *MAI, *MII, *MRI);
+    {
+      std::lock_guard<std::mutex> Lock(WorkerMIPsMutex);
+      WorkerMIPs.emplace_back(WorkerMIP);
+    }
+    return std::unique_ptr<DCTranslator>(TheTarget->createDCTranslator(
+        Triple(TripleName), WorkerCtx, DL, TransOptLevel, *MII, *MRI, *STI,
+        *WorkerMIP));
+  };
+  auto TranslateAt = [&](ArrayRef<uint64_t> EntryAddrs) {
+    if (TranslationThreads)
+      translateRecursivelyAtInParallel(EntryAddrs, *DT, *MCM,
+                                       CreateWorkerTranslator,
+                                       TranslationThreads, OD.get(), MOS.get());
+    else
+      translateRecursivelyAt(EntryAddrs, *DT, *MCM, OD.get(), MOS.get());
+  };
+
+  TranslateAt({TranslationEntrypoint});
   DT->getDCModule()->getOrCreateMainFunction(
       DT->getDCModule()->getOrCreateFunction(TranslationEntrypoint));
 
@@ -223,10 +308,23 @@ int main(int argc, char **argv) {
   FuncEntrypoints.reserve(MCM->func_size());
   for (auto &F : MCM->funcs())
     FuncEntrypoints.push_back(F->getStartAddr());
-  translateRecursivelyAt(FuncEntrypoints, *DT, *MCM, OD.get(), MOS.get());
+  TranslateAt(FuncEntrypoints);
 
   Module *M = DT->finalizeTranslationModule();
-  M->print(outs(), /*AnnotWriter=*/nullptr);
+  {
+    DCTranslationStats::StageRegion TR(Stats.get(),
+                                       DCTranslationStats::Printing);
+    M->print(outs(), /*AnnotWriter=*/nullptr);
+    outs().flush();
+  }
+
+  if (Stats) {
+    if (std::error_code EC = Stats->writeJSON()) {
+      errs() << ToolName << ": '" << Stats->getOutputFilename()
+             << "': " << EC.message() << '\n';
+      return 1;
+    }
+  }
 
   return 0;
 }
@@ -86,11 +86,29 @@ static cl::opt<bool>
 EmitDOT("emit-dot", cl::desc("Write the CFG for every function found in the"
                              "object to a graphviz .dot file"));
 
+static cl::opt<unsigned>
+NumThreads("threads",
+           cl::desc("Number of threads used to disassemble functions"),
+           cl::init(1));
+
 static cl::opt<bool>
 EnableDisassemblyCache("enable-mcod-disass-cache",
     cl::desc("Enable the MC Object disassembly instruction cache"),
     cl::init(false), cl::Hidden);
 
+static cl::opt<unsigned>
+DisassemblyCacheSize("mcod-disass-cache-size",
+    cl::desc("Maximum number of instructions in the MC Object disassembly "
+             "instruction cache"),
+    cl::init(MCCachingDisassembler::DefaultMaxEntries), cl::Hidden);
+
+// cl::opt<uint64_t> isn't currently supported (PR19665).
+static cl::opt<unsigned long long>
+MaxResident("max-resident",
+            cl::desc("Maximum number of bytes of already disassembled code "
+                     "to keep resident in memory (default = 0, no limit)"),
+            cl::value_desc("bytes"), cl::init(0));
+
 static StringRef ToolName;
 
 static const Target *getTarget(const ObjectFile *Obj = nullptr) {
@@ -248,7 +266,7 @@ static void emitDOTFile(const char *FileName, const MCFunction &f,
 #endif
 }
 
-static void DumpObject(const ObjectFile *Obj) {
+static void DumpObject(const ObjectFile *Obj, const MemoryBuffer &Buffer) {
   outs() << '\n';
   outs() << "# " << Obj->getFileName()
          << ":\tfile format " << Obj->getFileFormatName() << "\n\n";
@@ -310,7 +328,8 @@ static void DumpObject(const ObjectFile *Obj) {
   std::unique_ptr<MCDisassembler> DisAsmImpl;
   if (EnableDisassemblyCache) {
     DisAsmImpl = std::move(DisAsm);
-    DisAsm.reset(new MCCachingDisassembler(*DisAsmImpl, *STI));
+    DisAsm.reset(new MCCachingDisassembler(*DisAsmImpl, *STI,
+                                           DisassemblyCacheSize));
   }
 
   std::unique_ptr<const MCInstrAnalysis> MIA(
@@ -341,6 +360,14 @@ static void DumpObject(const ObjectFile *Obj) {
 
   std::unique_ptr<MCObjectDisassembler> OD(
       new MCObjectDisassembler(*Obj, *DisAsm, *MIA, MOS.get()));
+  OD->setNumThreads(NumThreads);
+  if (MaxResident) {
+    if (Buffer.getBufferKind() == MemoryBuffer::MemoryBuffer_MMap)
+      OD->setMaxResidentBytes(MaxResident);
+    else
+      errs() << ToolName << ": warning: '" << Obj->getFileName()
+             << "' isn't memory-mapped, ignoring -max-resident\n";
+  }
   std::unique_ptr<MCModule> Mod(OD->buildModule());
   if (EmitDOT) {
     for (MCModule::const_func_iterator FI = Mod->func_begin(),
@@ -367,17 +394,29 @@ static void DumpInput(StringRef file) {
     return;
   }
 
+  // Map the input read-only, without requiring a null terminator, so that
+  // the section contents are never copied on their way to the disassembler.
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFileOrSTDIN(file, /*FileSize=*/-1,
+                                   /*RequiresNullTerminator=*/false);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    errs() << ToolName << ": '" << file << "': " << EC.message() << '\n';
+    return;
+  }
+  std::unique_ptr<MemoryBuffer> Buffer = std::move(BufferOrErr.get());
+
   // Attempt to open the binary.
-  Expected<OwningBinary<Binary>> BinaryOrErr = createBinary(file);
+  Expected<std::unique_ptr<Binary>> BinaryOrErr =
+      createBinary(Buffer->getMemBufferRef());
   if (auto E = BinaryOrErr.takeError()) {
     logAllUnhandledErrors(std::move(E), errs(),
                           (ToolName + ": '" + file + "': ").str());
     return;
   }
-  Binary &Binary = *BinaryOrErr.get().getBinary();
+  Binary &Binary = *BinaryOrErr.get();
 
   if (ObjectFile *o = dyn_cast<ObjectFile>(&Binary))
-    DumpObject(o);
+    DumpObject(o, *Buffer);
   else
     errs() << ToolName << ": '" << file << "': " << "Unrecognized file type.\n";
 }
@@ -510,6 +510,16 @@ class SemanticsEmitter {
                           const CodeGenInstruction &CGI,
                           const TreePattern &TP);
 
+  /// Get the body of a C++ function translating \p Sema directly, using the
+  /// DCInstruction sema* methods, or an empty string if it can't be compiled.
+  std::string compileInstSemantics(const InstSemantics &Sema,
+                                   ArrayRef<uint64_t> Constants);
+
+  /// Emit the compiled semantics functions, and the table mapping opcodes
+  /// to them, given the index in InstSemas of each opcode's semantics.
+  void emitCompiledSemantics(raw_ostream &OS, ArrayRef<unsigned> SemaIdx,
+                             ArrayRef<uint64_t> Constants);
+
 public:
   SemanticsEmitter(RecordKeeper &Records);
 
@@ -606,6 +616,133 @@ void SemanticsEmitter::ParseSemantics() {
   }
 }
 
+/// Print \p Types as an initializer list of MVT::SimpleValueTypes.
+static std::string
+getTypeListInitializer(ArrayRef<MVT::SimpleValueType> Types) {
+  if (Types.empty())
+    return "None";
+  std::string Str = "{";
+  for (unsigned i = 0, e = Types.size(); i != e; ++i) {
+    if (i)
+      Str += ", ";
+    Str += llvm::getEnumName(Types[i]);
+  }
+  return Str + "}";
+}
+
+/// Print \p Operands as an initializer list of value indices.
+static std::string
+getOperandListInitializer(ArrayRef<std::string> Operands) {
+  if (Operands.empty())
+    return "None";
+  return "{" + join(Operands.begin(), Operands.end(), ", ") + "}";
+}
+
+std::string
+SemanticsEmitter::compileInstSemantics(const InstSemantics &Sema,
+                                       ArrayRef<uint64_t> Constants) {
+  std::vector<std::string> Ops;
+  for (const LSNode &NS : Sema.Semantics) {
+    StringRef Opc = NS.Opcode;
+    ArrayRef<std::string> Operands = NS.Operands;
+    const bool HasOneResult = NS.Types.size() == 1;
+
+    // The DCINS operations with a single result and raw operands.
+    auto compileGetter = [&](StringRef Method) {
+      return ("DCI." + Method + "(" + llvm::getEnumName(NS.Types[0]) + ", " +
+              join(Operands.begin(), Operands.end(), ", ") + ")")
+          .str();
+    };
+
+    if (Opc == "DCINS::GET_RC" && HasOneResult) {
+      Ops.push_back(compileGetter("semaGetRC"));
+    } else if (Opc == "DCINS::GET_REG" && HasOneResult) {
+      Ops.push_back(compileGetter("semaGetReg"));
+    } else if (Opc == "DCINS::CUSTOM_OP" && HasOneResult) {
+      Ops.push_back(compileGetter("semaCustomOp"));
+    } else if (Opc == "DCINS::GET_IMMEDIATE" && HasOneResult) {
+      Ops.push_back(compileGetter("semaGetImmediate"));
+    } else if (Opc == "DCINS::GET_CONSTANT" && HasOneResult) {
+      unsigned Idx;
+      if (StringRef(Operands[0]).getAsInteger(10, Idx))
+        return std::string();
+      Ops.push_back(("DCI.semaGetConstant(" + llvm::getEnumName(NS.Types[0]) +
+                     ", " + utostr(Constants[Idx]) + "ULL)")
+                        .str());
+    } else if (Opc == "DCINS::PUT_RC" && NS.Types.empty()) {
+      Ops.push_back("DCI.semaPutRC(" + Operands[0] + ", " + Operands[1] + ")");
+    } else if (Opc == "DCINS::PUT_REG" && NS.Types.empty()) {
+      Ops.push_back("DCI.semaPutReg(" + Operands[0] + ", " + Operands[1] +
+                    ")");
+    } else if (Opc == "DCINS::COMPLEX_PATTERN" || Opc == "DCINS::PREDICATE") {
+      StringRef Method = Opc == "DCINS::PREDICATE" ? "semaPredicate"
+                                                   : "semaComplexPattern";
+      Ops.push_back(("DCI." + Method + "(" + getTypeListInitializer(NS.Types) +
+                     ", " + Operands[0] + ", " +
+                     getOperandListInitializer(Operands.drop_front()) + ")")
+                        .str());
+    } else if (!Opc.startswith("DCINS::")) {
+      Ops.push_back(("DCI.semaOperation(" + Opc + ", " +
+                     getTypeListInitializer(NS.Types) + ", " +
+                     getOperandListInitializer(Operands) + ")").str());
+    } else {
+      // Leave anything unexpected to the interpreter.
+      return std::string();
+    }
+  }
+
+  if (!Sema.ImplicitDefs.empty())
+    Ops.push_back(
+        ("DCI.semaImplicit(" + Target.getName() + "::" +
+         Target.getRegBank().getReg(Sema.ImplicitDefs[0])->getName() + ")")
+            .str());
+
+  if (Ops.empty())
+    return "  return true;\n";
+  return "  return " + join(Ops.begin(), Ops.end(), " &&\n         ") +
+         ";\n";
+}
+
+void SemanticsEmitter::emitCompiledSemantics(raw_ostream &OS,
+                                             ArrayRef<unsigned> SemaIdx,
+                                             ArrayRef<uint64_t> Constants) {
+  StringRef TGName = Target.getName();
+  const std::vector<const CodeGenInstruction *> &CGIByEnum =
+      Target.getInstructionsByEnumValue();
+
+  OS << "#ifdef GET_COMPILED_SEMA\n";
+  OS << "namespace " << TGName << " {\n";
+  OS << "namespace {\n\n";
+
+  // Many instructions have the same semantics (e.g., different encodings of
+  // the same operation): only emit one function for each.
+  std::map<std::string, std::string> FnByBody;
+  std::vector<std::string> FnByOpcode(CGIByEnum.size());
+  for (unsigned I = 0, E = CGIByEnum.size(); I != E; ++I) {
+    if (SemaIdx[I] == ~0U)
+      continue;
+    std::string Body = compileInstSemantics(InstSemas[SemaIdx[I]], Constants);
+    if (Body.empty())
+      continue;
+    std::string &Fn = FnByBody[Body];
+    if (Fn.empty()) {
+      Fn = "translateSema_" + CGIByEnum[I]->TheDef->getName().str();
+      OS << "bool " << Fn << "(DCInstruction &DCI) {\n" << Body << "}\n\n";
+    }
+    FnByOpcode[I] = Fn;
+  }
+
+  OS << "const DCInstruction::CompiledSemaFn CompiledSemantics[] = {\n";
+  for (unsigned I = 0, E = CGIByEnum.size(); I != E; ++I)
+    OS.indent(2) << (FnByOpcode[I].empty() ? "nullptr" : FnByOpcode[I])
+                 << ", \t// " << CGIByEnum[I]->TheDef->getName() << "\n";
+  OS << "};\n\n";
+
+  OS << "} // end anonymous namespace\n";
+  OS << "} // end namespace " << TGName << "\n";
+  OS << "#endif // GET_COMPILED_SEMA\n";
+}
+
 void SemanticsEmitter::run(raw_ostream &OS) {
   emitSourceFileHeader("Target Instruction Semantics", OS);
 
@@ -614,6 +751,10 @@ void SemanticsEmitter::run(raw_ostream &OS) {
       Target.getInstructionsByEnumValue();
   assert(CGIByEnum.size() == InstIdx.size());
 
+  // InstIdx is replaced by the offsets in the semantics array below: keep the
+  // indices of the semantics around for the compiled semantics.
+  const std::vector<unsigned> SemaIdx = InstIdx;
+
   CodeGenRegBank &RegBank = Target.getRegBank();
 
   OS << "namespace llvm {\n";
@@ -761,6 +902,8 @@ void SemanticsEmitter::run(raw_ostream &OS) {
   }
   OS << "#endif // GET_INSTR_SEMA\n";
 
+  emitCompiledSemantics(OS, SemaIdx, Constants);
+
   OS << "#ifdef GET_REGISTER_SEMA\n";
   OS << "namespace " << TGName << " {\n";
   OS << "namespace {\n\n";
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Build the llvm-dc-bench corpus: the prebuilt test binaries in
+# test/DC/X86/Inputs, and one object per instruction test in
+# test/DC/X86/Instructions (generated by dcgentests.py from
+# manual_inst_list.txt).
+#
+# Usage: build_bench_corpus.sh <llvm-obj-dir> <output-dir>
+#
+# Then, for instance:
+#   llvm-dc-bench -dc-translate-unknown-to-undef -format=json \
+#     <output-dir>/* -o baseline.json
+
+set -e
+
+if [ $# -ne 2 ]; then
+  echo "usage: $0 <llvm-obj-dir> <output-dir>" >&2
+  exit 1
+fi
+
+LLVM_OBJ=$1
+OUTPUT_DIR=$2
+SRC_DIR=$(cd "$(dirname "$0")/../.." && pwd)
+TEST_DIR=$SRC_DIR/test/DC/X86
+
+mkdir -p "$OUTPUT_DIR"
+
+for INPUT in "$TEST_DIR"/Inputs/*-x86_64; do
+  cp "$INPUT" "$OUTPUT_DIR"/
+done
+
+for TEST in "$TEST_DIR"/Instructions/*.s; do
+  NAME=$(basename "$TEST" .s)
+  "$LLVM_OBJ"/bin/llvm-mc -triple x86_64--darwin -filetype=obj \
+    -o "$OUTPUT_DIR/inst-$NAME.macho-x86_64" "$TEST"
+done
@@ -0,0 +1,51 @@
+// Indirect calls: a C version of virtual dispatch, with monomorphic and
+// polymorphic call sites.
+#include <stdio.h>
+#include <stdlib.h>
+
+struct shape;
+struct shape_vtable {
+  long (*area)(const struct shape *);
+  long (*perimeter)(const struct shape *);
+};
+struct shape {
+  const struct shape_vtable *vt;
+  long a, b;
+};
+
+static long square_area(const struct shape *s) { return s->a * s->a; }
+static long square_perimeter(const struct shape *s) { return 4 * s->a; }
+static long rect_area(const struct shape *s) { return s->a * s->b; }
+static long rect_perimeter(const struct shape *s) { return 2 * (s->a + s->b); }
+static long tri_area(const struct shape *s) { return s->a * s->b / 2; }
+static long tri_perimeter(const struct shape *s) { return 3 * s->a; }
+
+static const struct shape_vtable vtables[] = {
+  {square_area, square_perimeter},
+  {rect_area, rect_perimeter},
+  {tri_area, tri_perimeter},
+};
+
+#define NUM_SHAPES 1024
+
+int main(int argc, char **argv) {
+  unsigned long n = argc > 1 ? strtoul(argv[1], 0, 10) : 1;
+  static struct shape shapes[NUM_SHAPES];
+  for (int i = 0; i != NUM_SHAPES; ++i) {
+    shapes[i].vt = &vtables[(i * 7) % 3];
+    shapes[i].a = i % 13 + 1;
+    shapes[i].b = i % 17 + 1;
+  }
+
+  long sum = 0;
+  for (unsigned long r = 0; r != n * 50000; ++r) {
+    // Monomorphic: the same target every time.
+    for (int i = 0; i < NUM_SHAPES; i += 3)
+      sum += vtables[0].area(&shapes[i]);
+    // Polymorphic: the targets cycle through all the vtables.
+    for (int i = 0; i != NUM_SHAPES; ++i)
+      sum += shapes[i].vt->perimeter(&shapes[i]);
+  }
+  printf("%ld\n", sum);
+  return 0;
+}
@@ -0,0 +1,16 @@
+// Tight integer loops: arithmetic, shifts and flags in a single hot function.
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+  unsigned long n = argc > 1 ? strtoul(argv[1], 0, 10) : 1;
+  unsigned long x = 0x12345678, sum = 0;
+  for (unsigned long i = 0; i != n * 50000000; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    sum += (x & 0xff) < 0x80 ? x % 7 : x >> 3;
+  }
+  printf("%lu\n", sum);
+  return 0;
+}
@@ -0,0 +1,35 @@
+// Block copies and fills: calls to memcpy/memset, and inline 'rep movs'.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUF_SIZE (64 * 1024)
+
+static unsigned char src[BUF_SIZE], dst[BUF_SIZE];
+
+static void rep_movsb(void *d, const void *s, size_t n) {
+#if defined(__x86_64__)
+  __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+#else
+  memmove(d, s, n);
+#endif
+}
+
+int main(int argc, char **argv) {
+  unsigned long n = argc > 1 ? strtoul(argv[1], 0, 10) : 1;
+  for (int i = 0; i != BUF_SIZE; ++i)
+    src[i] = (unsigned char)(i * 31);
+
+  unsigned long sum = 0;
+  for (unsigned long r = 0; r != n * 20000; ++r) {
+    size_t len = BUF_SIZE - (r % 4096);
+    memcpy(dst, src + r % 4096, len);
+    sum += dst[r % len];
+    rep_movsb(dst + 1, src, len - 1);
+    sum += dst[(r * 7) % len];
+    memset(dst, (int)r, 256);
+    sum += dst[r % 256];
+  }
+  printf("%lu\n", sum);
+  return 0;
+}
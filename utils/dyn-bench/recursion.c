@@ -0,0 +1,25 @@
+// Call-heavy recursion: lots of short functions, calls and returns.
+#include <stdio.h>
+#include <stdlib.h>
+
+__attribute__((noinline)) static unsigned long fib(unsigned long n) {
+  return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+__attribute__((noinline)) static unsigned long ack(unsigned long m,
+                                                   unsigned long n) {
+  if (m == 0)
+    return n + 1;
+  if (n == 0)
+    return ack(m - 1, 1);
+  return ack(m - 1, ack(m, n - 1));
+}
+
+int main(int argc, char **argv) {
+  unsigned long n = argc > 1 ? strtoul(argv[1], 0, 10) : 1;
+  unsigned long sum = 0;
+  for (unsigned long i = 0; i != n; ++i)
+    sum += fib(32) + ack(2, 2000);
+  printf("%lu\n", sum);
+  return 0;
+}
@@ -0,0 +1,198 @@
+#!/usr/bin/env python
+"""Run the DYN guest-workload benchmarks.
+
+Each benchmark is a small C program in this directory, compiled with the host
+compiler, and run both natively and under DYN.  For each of them, this reports
+the slowdown of DYN compared to native execution, and, using -dc-stats, the
+time spent translating and compiling the guest code, the number of times the
+guest entered the runtime dispatcher, and the size of the JITted code.
+
+For instance:
+
+  $ ./utils/dyn-bench/run_dyn_bench.py --dyn=build/lib/libDYN.so
+  $ ./utils/dyn-bench/run_dyn_bench.py --dyn=build/lib/libDYN.so \\
+        --dyn-options="-dyn-tiered-compilation" --format=json -o tiered.json
+
+The programs print a checksum of their results, which must match between the
+native and DYN runs.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+BENCHMARKS = [
+    ('intloop', 'tight integer loops'),
+    ('recursion', 'call-heavy recursion'),
+    ('indirect', 'indirect calls (virtual dispatch)'),
+    ('memcpy', 'memcpy/memset and rep movs'),
+    ('sse', 'SSE math'),
+    ('stdio', 'libc-heavy I/O'),
+]
+
+# The -dc-stats stages that are part of translating and compiling guest code.
+TRANSLATION_STAGES = ['object-load', 'symbolizer', 'cfg-recovery',
+                      'translation', 'optimization', 'codegen']
+
+SRC_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def median(values):
+    values = sorted(values)
+    mid = len(values) // 2
+    if len(values) % 2:
+        return values[mid]
+    return (values[mid - 1] + values[mid]) / 2.0
+
+
+def compile_benchmark(args, name, build_dir):
+    exe = os.path.join(build_dir, name)
+    cmd = [args.cc] + args.cflags.split() + \
+          [os.path.join(SRC_DIR, name + '.c'), '-o', exe]
+    subprocess.check_call(cmd)
+    return exe
+
+
+def run_once(cmd, env):
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, env=env)
+    out, _ = proc.communicate()
+    return time.time() - start, proc.returncode, out
+
+
+def run_native(args, exe):
+    times = []
+    for _ in range(args.repetitions):
+        elapsed, status, out = run_once([exe, str(args.scale)], os.environ)
+        if status != 0:
+            sys.exit('error: %s exited with %d' % (exe, status))
+        times.append(elapsed)
+    return median(times), out
+
+
+def run_dyn(args, exe, expected_out, stats_file):
+    env = dict(os.environ)
+    if sys.platform == 'darwin':
+        env['DYLD_INSERT_LIBRARIES'] = args.dyn
+    else:
+        env['LD_PRELOAD'] = args.dyn
+    env['DCDYN_OPTIONS'] = ' '.join(
+        [args.dyn_options, '-dc-stats=' + stats_file]).strip()
+
+    times = []
+    for _ in range(args.repetitions):
+        elapsed, status, out = run_once([exe, str(args.scale)], env)
+        if status != 0:
+            sys.exit('error: %s exited with %d under DYN' % (exe, status))
+        if out != expected_out:
+            sys.exit('error: %s printed %r under DYN, expected %r' %
+                     (exe, out, expected_out))
+        times.append(elapsed)
+
+    # The translation work is the same for every run; report the last one.
+    with open(stats_file) as f:
+        stats = json.load(f)
+    return median(times), stats
+
+
+def run_benchmark(args, name, build_dir):
+    exe = compile_benchmark(args, name, build_dir)
+    native_time, out = run_native(args, exe)
+    dyn_time, stats = run_dyn(args, exe, out,
+                              os.path.join(build_dir, name + '.stats.json'))
+    counters = stats.get('counters', {})
+    return {
+        'name': name,
+        'native-time': native_time,
+        'dyn-time': dyn_time,
+        'slowdown': dyn_time / native_time if native_time else 0.0,
+        'translation-time': sum(stats['stages'][s]['wall']
+                                for s in TRANSLATION_STAGES),
+        'functions': stats['functions']['count'],
+        'dispatcher-entries': counters.get('dispatcher-entries', 0),
+        'jit-code-size': counters.get('jit-code-size', 0),
+    }
+
+
+def print_text(results, out):
+    header = ('benchmark', 'native (s)', 'DYN (s)', 'slowdown',
+              'transl. (s)', 'functions', 'dispatches', 'JIT code (B)')
+    rows = [header]
+    for r in results:
+        rows.append((r['name'], '%.3f' % r['native-time'],
+                     '%.3f' % r['dyn-time'], '%.2fx' % r['slowdown'],
+                     '%.3f' % r['translation-time'], str(r['functions']),
+                     str(r['dispatcher-entries']), str(r['jit-code-size'])))
+    widths = [max(len(row[i]) for row in rows) for i in range(len(header))]
+    for row in rows:
+        out.write(row[0].ljust(widths[0]) + '  ' +
+                  '  '.join(c.rjust(w) for c, w in zip(row[1:], widths[1:])) +
+                  '\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run the DYN guest-workload benchmarks.',
+        epilog='benchmarks: ' +
+               ', '.join('%s (%s)' % b for b in BENCHMARKS))
+    parser.add_argument('--dyn', required=True,
+                        help='path to the DYN library (libDYN.so/.dylib)')
+    parser.add_argument('--dyn-options', default='',
+                        help='extra DCDYN_OPTIONS for the DYN runs')
+    parser.add_argument('--cc', default=os.environ.get('CC', 'cc'),
+                        help='host C compiler (default: $CC, or cc)')
+    parser.add_argument('--cflags', default='-O2',
+                        help='flags to compile the benchmarks with')
+    parser.add_argument('--scale', type=int, default=1,
+                        help='amount of work done by each benchmark')
+    parser.add_argument('--repetitions', type=int, default=3,
+                        help='number of runs to take the median time of')
+    parser.add_argument('--format', choices=['text', 'json'], default='text')
+    parser.add_argument('-o', dest='output', help='output file')
+    parser.add_argument('--build-dir',
+                        help='directory to build the benchmarks in '
+                             '(default: a temporary directory)')
+    parser.add_argument('benchmarks', nargs='*',
+                        help='benchmarks to run (default: all)')
+    args = parser.parse_args()
+
+    names = [b[0] for b in BENCHMARKS]
+    for name in args.benchmarks:
+        if name not in names:
+            parser.error('unknown benchmark: ' + name)
+    if args.benchmarks:
+        names = args.benchmarks
+    if args.repetitions < 1:
+        parser.error('--repetitions must be at least 1')
+    args.dyn = os.path.abspath(args.dyn)
+
+    build_dir = args.build_dir or tempfile.mkdtemp(prefix='dyn-bench-')
+    if not os.path.isdir(build_dir):
+        os.makedirs(build_dir)
+    try:
+        results = [run_benchmark(args, name, build_dir) for name in names]
+    finally:
+        if not args.build_dir:
+            shutil.rmtree(build_dir)
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    if args.format == 'json':
+        json.dump({'dyn-options': args.dyn_options, 'cflags': args.cflags,
+                   'scale': args.scale, 'benchmarks': results},
+                  out, indent=2, sort_keys=True)
+        out.write('\n')
+    else:
+        print_text(results, out)
+    if args.output:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
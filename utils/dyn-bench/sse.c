@@ -0,0 +1,43 @@
+// SSE math: scalar and packed floating point, as in numeric kernels.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 1024
+
+static float a[N], b[N], c[N];
+static double m[64][64], v[64], w[64];
+
+int main(int argc, char **argv) {
+  unsigned long n = argc > 1 ? strtoul(argv[1], 0, 10) : 1;
+  for (int i = 0; i != N; ++i) {
+    a[i] = (float)i / N;
+    b[i] = (float)(N - i) / N;
+  }
+  for (int i = 0; i != 64; ++i) {
+    v[i] = 1.0 / (i + 1);
+    for (int j = 0; j != 64; ++j)
+      m[i][j] = (double)((i * j) % 7) / 7;
+  }
+
+  double sum = 0;
+  for (unsigned long r = 0; r != n * 300000; ++r) {
+    // Packed single-precision saxpy.
+    float k = (float)(r % 16) / 16;
+    for (int i = 0; i != N; ++i)
+      c[i] = k * a[i] + b[i];
+    sum += c[r % N];
+
+    // Scalar double-precision matrix-vector product, with a division.
+    if (r % 8 == 0) {
+      for (int i = 0; i != 64; ++i) {
+        double acc = 0;
+        for (int j = 0; j != 64; ++j)
+          acc += m[i][j] * v[j];
+        w[i] = acc / (1.0 + i);
+      }
+      sum += w[r % 64];
+    }
+  }
+  printf("%.6f\n", sum);
+  return 0;
+}
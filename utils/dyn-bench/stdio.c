@@ -0,0 +1,34 @@
+// libc-heavy I/O: formatted output and parsing, through stdio buffers.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  unsigned long n = argc > 1 ? strtoul(argv[1], 0, 10) : 1;
+  FILE *F = tmpfile();
+  if (!F) {
+    perror("tmpfile");
+    return 1;
+  }
+
+  unsigned long sum = 0;
+  char line[128];
+  for (unsigned long r = 0; r != n * 10; ++r) {
+    rewind(F);
+    for (int i = 0; i != 20000; ++i)
+      fprintf(F, "%d %x %s\n", i, i * 3, i % 2 ? "odd" : "even");
+    fflush(F);
+
+    rewind(F);
+    while (fgets(line, sizeof(line), F)) {
+      int d;
+      unsigned x;
+      char word[8];
+      if (sscanf(line, "%d %x %7s", &d, &x, word) == 3)
+        sum += d + x + strlen(word);
+    }
+  }
+  fclose(F);
+  printf("%lu\n", sum);
+  return 0;
+}